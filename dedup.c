@@ -0,0 +1,127 @@
+/**
+	@file
+	Content-addressed store of shared page copies
+    
+    Builds in the driver or, with MORE_PTHREADS defined, as a user-space
+    library: gcc -DMORE_PTHREADS -c dedup.c
+    
+	@date 10/19/2026
+***************************************************************/
+#ifdef MORE_PTHREADS
+#include <string.h>
+#else
+#include "ntddk.h"
+#endif
+#include "stdint.h"
+#include "dedup.h"
+
+/**
+    Returns the bucket of a frame and digest
+*/
+static uint32 dedupBucket(DedupStore *store, uint32 frame, uint32 digest)
+{
+    return ((frame * 0x9E3779B1) ^ digest) & store->BucketMask;
+}
+
+void dedupInit(DedupStore *store, DedupEntry *entries, uint32 maxEntries,
+               uint32 *buckets, uint32 numBuckets)
+{
+    uint32 i;
+    
+    memset(store, 0, sizeof(DedupStore));
+    memset(entries, 0, maxEntries * sizeof(DedupEntry));
+    memset(buckets, 0, numBuckets * sizeof(uint32));
+    store->Entries = entries;
+    store->MaxEntries = maxEntries;
+    store->Buckets = buckets;
+    store->BucketMask = numBuckets - 1;
+    
+    // Chain every entry into the free list, lowest index first
+    for (i = 0; i < maxEntries; i++)
+    {
+        entries[i].Next = (i + 1 < maxEntries) ? i + 2 : 0;
+    }
+    store->FreeList = (maxEntries > 0) ? 1 : 0;
+}
+
+uint32 dedupDigest(const uint8 *page)
+{
+    const uint32 *words = (const uint32 *) page;
+    uint32 i, a = 2166136261u, b = 0;
+    
+    // Two independent lanes, so the multiplies of one word overlap the next
+    for (i = 0; i < DEDUP_PAGE_SIZE / sizeof(uint32); i += 2)
+    {
+        a = (a ^ words[i]) * 16777619u;
+        b = (b ^ words[i + 1]) * 0x9E3779B1;
+    }
+    return a ^ ((b << 15) | (b >> 17));
+}
+
+DedupEntry * dedupAcquire(DedupStore *store, uint32 frame, const uint8 *page, uint32 digest)
+{
+    uint32 index = store->Buckets[dedupBucket(store, frame, digest)];
+    DedupEntry *entry;
+    
+    while (index != 0)
+    {
+        entry = &store->Entries[index - 1];
+        if (entry->Frame == frame && entry->Digest == digest)
+        {
+            if (memcmp(entry->Copy, page, DEDUP_PAGE_SIZE) == 0)
+            {
+                entry->Refs++;
+                store->Shared++;
+                return entry;
+            }
+            store->Stale++;
+        }
+        index = entry->Next;
+    }
+    return NULL;
+}
+
+DedupEntry * dedupInsert(DedupStore *store, uint32 frame, uint32 digest,
+                         uint8 *copy, uint32 copyPhys)
+{
+    uint32 bucket = dedupBucket(store, frame, digest), index = store->FreeList;
+    DedupEntry *entry;
+    
+    if (index == 0)
+        return NULL;
+    entry = &store->Entries[index - 1];
+    store->FreeList = entry->Next;
+    
+    entry->Frame = frame;
+    entry->Digest = digest;
+    entry->Refs = 1;
+    entry->Copy = copy;
+    entry->CopyPhys = copyPhys;
+    entry->Next = store->Buckets[bucket];
+    store->Buckets[bucket] = index;
+    store->NumEntries++;
+    return entry;
+}
+
+uint8 * dedupRelease(DedupStore *store, DedupEntry *entry)
+{
+    uint32 index = (uint32) (entry - store->Entries) + 1;
+    uint32 *link = &store->Buckets[dedupBucket(store, entry->Frame, entry->Digest)];
+    uint8 *copy = entry->Copy;
+    
+    if (entry->Refs == 0 || --entry->Refs != 0)
+        return NULL;
+    
+    // Unlink the entry from its bucket and put it on the free list
+    while (*link != 0 && *link != index)
+    {
+        link = &store->Entries[*link - 1].Next;
+    }
+    if (*link == index)
+        *link = entry->Next;
+    memset(entry, 0, sizeof(DedupEntry));
+    entry->Next = store->FreeList;
+    store->FreeList = index;
+    store->NumEntries--;
+    return copy;
+}
@@ -0,0 +1,108 @@
+/**
+	@file
+	Content-addressed store of shared page copies (header file)
+    
+    Indexes page copies by the frame they were made from and a digest of
+    their contents, and counts the references to each, so every user of an
+    unchanged frame can share one copy
+    
+	@date 10/19/2026
+***************************************************************/
+
+#ifndef _MORE_DEDUP_H_
+#define _MORE_DEDUP_H_
+
+#include "stdint.h"
+
+/** Size of a page */
+#define DEDUP_PAGE_SIZE 0x1000
+
+/**
+    One shared copy
+*/
+struct DedupEntry_s
+{
+    uint32 Frame; /**< Frame the copy was made from */
+    uint32 Digest; /**< Digest of the contents when the copy was made */
+    uint32 Refs; /**< Number of users, 0 while the entry is free */
+    uint32 CopyPhys; /**< Physical address of the copy */
+    uint8 *Copy; /**< Pointer to the copy */
+    uint32 Next; /**< Index + 1 of the next entry of the bucket or the free list */
+};
+
+typedef struct DedupEntry_s DedupEntry;
+
+/**
+    Store of shared copies, the caller supplies the storage and the pages
+*/
+struct DedupStore_s
+{
+    DedupEntry *Entries;
+    uint32 MaxEntries;
+    uint32 *Buckets; /**< Index + 1 of the first entry of each bucket, 0 if empty */
+    uint32 BucketMask; /**< Number of buckets - 1 */
+    uint32 FreeList; /**< Index + 1 of the first free entry, 0 if the store is full */
+    uint32 NumEntries; /**< Entries in use */
+    uint32 Shared; /**< Lookups answered with an existing copy */
+    uint32 Stale; /**< Entries of the frame and digest whose contents differed */
+};
+
+typedef struct DedupStore_s DedupStore;
+
+/**
+    Initializes an empty store
+    
+    @param store Pointer to the store
+    @param entries Array of maxEntries entries
+    @param maxEntries Number of entries
+    @param buckets Array of numBuckets bucket heads
+    @param numBuckets Number of buckets, a power of two
+*/
+void dedupInit(DedupStore *store, DedupEntry *entries, uint32 maxEntries,
+               uint32 *buckets, uint32 numBuckets);
+
+/**
+    Returns the digest of a page
+    
+    @param page Pointer to the DEDUP_PAGE_SIZE bytes of the page
+    @return 32-bit digest
+*/
+uint32 dedupDigest(const uint8 *page);
+
+/**
+    Finds a copy of a page and takes a reference to it
+    
+    @note The digest only narrows the search, a copy is only shared if its
+    contents equal the page
+    @param store Pointer to the store
+    @param frame Frame the page is in
+    @param page Pointer to the contents of the page
+    @param digest dedupDigest of the page
+    @return Pointer to the entry, or NULL if there is no copy of the page
+*/
+DedupEntry * dedupAcquire(DedupStore *store, uint32 frame, const uint8 *page, uint32 digest);
+
+/**
+    Adds a new copy holding one reference
+    
+    @param store Pointer to the store
+    @param frame Frame the copy was made from
+    @param digest dedupDigest of the copy
+    @param copy Pointer to the copy
+    @param copyPhys Physical address of the copy
+    @return Pointer to the entry, or NULL if the store is full
+*/
+DedupEntry * dedupInsert(DedupStore *store, uint32 frame, uint32 digest,
+                         uint8 *copy, uint32 copyPhys);
+
+/**
+    Drops a reference to a copy
+    
+    @param store Pointer to the store
+    @param entry Entry returned by dedupAcquire or dedupInsert
+    @return Pointer to the copy once its last reference was dropped, for the
+    caller to free, otherwise NULL
+*/
+uint8 * dedupRelease(DedupStore *store, DedupEntry *entry);
+
+#endif // _MORE_DEDUP_H_
@@ -0,0 +1,266 @@
+/**
+	@file
+	Guest memory accessor
+    
+    Builds in the driver or, with MORE_PTHREADS defined, as a user-space
+    library: gcc -DMORE_PTHREADS -c gmem.c
+    
+	@date 10/19/2026
+***************************************************************/
+#ifdef MORE_PTHREADS
+#include <string.h>
+#else
+#include "ntddk.h"
+#endif
+#include "stdint.h"
+#include "gmem.h"
+
+/** Slot the page directory (32-bit) or page directory pointer table (PAE) is kept in */
+#define GMEM_SLOT_TOP 0
+/** Slot the last used page directory is kept in (PAE) */
+#define GMEM_SLOT_DIRECTORY 1
+/** Slot the last used page table is kept in */
+#define GMEM_SLOT_TABLE 2
+/** First of the slots data pages rotate through */
+#define GMEM_SLOT_DATA 3
+
+/** Address bits of a PAE paging structure entry (51:12) */
+#define GMEM_PAE_ADDRESS (((uint64) 0x000FFFFF << 32) | 0xFFFFF000)
+/** Address bits of a PAE 2 MiB page (51:21) */
+#define GMEM_PAE_LARGE_ADDRESS (((uint64) 0x000FFFFF << 32) | 0xFFE00000)
+
+void gmemInit(GuestMemory *gm, uint32 cr3, uint32 flags, GmemMapFn mapFrame, 
+              GmemUnmapFn unmapFrame, void *context)
+{
+    memset(gm, 0, sizeof(GuestMemory));
+    gm->CR3 = cr3;
+    gm->Flags = flags;
+    gm->MapFrame = mapFrame;
+    gm->UnmapFrame = unmapFrame;
+    gm->Context = context;
+}
+
+void gmemSetCR3(GuestMemory *gm, uint32 cr3)
+{
+    gm->CR3 = cr3;
+    gmemFlush(gm);
+}
+
+void gmemFlush(GuestMemory *gm)
+{
+    memset(gm->TlbTag, 0, sizeof(gm->TlbTag));
+}
+
+void gmemRelease(GuestMemory *gm)
+{
+    uint32 i;
+    
+    for (i = 0; i < GMEM_MAP_SLOTS; i++)
+    {
+        if (gm->SlotPtr[i] != NULL && gm->UnmapFrame != NULL)
+            gm->UnmapFrame(gm->Context, gm->SlotPtr[i]);
+        gm->SlotPtr[i] = NULL;
+    }
+    gm->NextSlot = 0;
+}
+
+/**
+    Returns a mapping of a guest frame, valid until the next call
+    
+    @param slot Slot to map the frame into if it is not mapped yet, 
+    GMEM_SLOT_DATA to take the next data slot
+*/
+static uint8 * gmemMapFrame(GuestMemory *gm, uint64 phys, uint32 slot)
+{
+    uint32 i;
+    uint8 *ptr;
+    
+    phys &= ~((uint64) 0xFFF);
+    for (i = 0; i < GMEM_MAP_SLOTS; i++)
+    {
+        if (gm->SlotPtr[i] != NULL && gm->SlotFrame[i] == phys)
+            return gm->SlotPtr[i];
+    }
+    
+    ptr = gm->MapFrame(gm->Context, phys);
+    if (ptr == NULL)
+        return NULL;
+    gm->Maps++;
+    
+    // Data pages stream through their own slots so the directory and the 
+    // current table stay mapped
+    if (slot == GMEM_SLOT_DATA)
+    {
+        slot = GMEM_SLOT_DATA + gm->NextSlot;
+        gm->NextSlot = (gm->NextSlot + 1) % (GMEM_MAP_SLOTS - GMEM_SLOT_DATA);
+    }
+    if (gm->SlotPtr[slot] != NULL && gm->UnmapFrame != NULL)
+        gm->UnmapFrame(gm->Context, gm->SlotPtr[slot]);
+    gm->SlotPtr[slot] = ptr;
+    gm->SlotFrame[slot] = phys;
+    return ptr;
+}
+
+/**
+    Walks 32-bit page tables, returns the PTE (or an equivalent one for a 
+    4 MiB page) with bit 0 clear if va is not present
+*/
+static uint64 gmemWalk32(GuestMemory *gm, uint32 va)
+{
+    uint32 *table, pde;
+    
+    table = (uint32 *) gmemMapFrame(gm, gm->CR3, GMEM_SLOT_TOP);
+    if (table == NULL)
+        return 0;
+    pde = table[va >> 22];
+    if (!(pde & 1))
+        return 0;
+    // 4 MiB page
+    if (pde & 0x80)
+        return (pde & 0xFFC00000) | (va & 0x003FF000) | 1;
+    
+    table = (uint32 *) gmemMapFrame(gm, pde, GMEM_SLOT_TABLE);
+    if (table == NULL)
+        return 0;
+    return table[(va >> 12) & 0x3FF];
+}
+
+/**
+    Walks PAE page tables, returns the PTE (or an equivalent one for a 
+    2 MiB page) with bit 0 clear if va is not present
+*/
+static uint64 gmemWalkPae(GuestMemory *gm, uint32 va)
+{
+    uint64 *table, entry;
+    
+    // The four PDPTEs are 32 byte aligned anywhere in the frame CR3 points at
+    table = (uint64 *) gmemMapFrame(gm, gm->CR3, GMEM_SLOT_TOP);
+    if (table == NULL)
+        return 0;
+    entry = table[((gm->CR3 & 0xFE0) >> 3) + (va >> 30)];
+    if (!(entry & 1))
+        return 0;
+    
+    table = (uint64 *) gmemMapFrame(gm, entry & GMEM_PAE_ADDRESS, GMEM_SLOT_DIRECTORY);
+    if (table == NULL)
+        return 0;
+    entry = table[(va >> 21) & 0x1FF];
+    if (!(entry & 1))
+        return 0;
+    // 2 MiB page
+    if (entry & 0x80)
+        return (entry & GMEM_PAE_LARGE_ADDRESS) | (va & 0x001FF000) | 1;
+    
+    table = (uint64 *) gmemMapFrame(gm, entry & GMEM_PAE_ADDRESS, GMEM_SLOT_TABLE);
+    if (table == NULL)
+        return 0;
+    return table[(va >> 12) & 0x1FF];
+}
+
+uint8 gmemTranslate(GuestMemory *gm, uint32 va, uint64 *phys)
+{
+    uint32 tlb = (va >> 12) % GMEM_TLB_ENTRIES;
+    uint64 pte;
+    
+    if (gm->TlbTag[tlb] == ((va & 0xFFFFF000) | 1))
+    {
+        gm->TlbHits++;
+        *phys = gm->TlbFrame[tlb] | (va & 0xFFF);
+        return 1;
+    }
+    
+    gm->Walks++;
+    pte = (gm->Flags & GMEM_FLAG_PAE) ? gmemWalkPae(gm, va) : gmemWalk32(gm, va);
+    if (!(pte & 1))
+        return 0;
+    
+    gm->TlbTag[tlb] = (va & 0xFFFFF000) | 1;
+    gm->TlbFrame[tlb] = pte & GMEM_PAE_ADDRESS;
+    *phys = gm->TlbFrame[tlb] | (va & 0xFFF);
+    return 1;
+}
+
+/**
+    Maps the page holding va and returns how many of len bytes lie in it
+    
+    @return Number of bytes of the page, 0 with ptr NULL if it is not present
+*/
+static uint32 gmemMapVirtual(GuestMemory *gm, uint32 va, uint32 len, uint8 **ptr)
+{
+    uint64 phys;
+    uint32 n = GMEM_PAGE_SIZE - (va & 0xFFF);
+    
+    *ptr = NULL;
+    if (n > len)
+        n = len;
+    if (!gmemTranslate(gm, va, &phys))
+        return n;
+    *ptr = gmemMapFrame(gm, phys, GMEM_SLOT_DATA);
+    if (*ptr != NULL)
+        *ptr += (uint32) phys & 0xFFF;
+    return n;
+}
+
+uint32 gmemRead(GuestMemory *gm, uint32 va, uint8 *buf, uint32 len)
+{
+    uint32 done = 0, n;
+    uint8 *ptr;
+    
+    while (done < len)
+    {
+        n = gmemMapVirtual(gm, va + done, len - done, &ptr);
+        if (ptr == NULL)
+            break;
+        memcpy(buf + done, ptr, n);
+        done += n;
+    }
+    return done;
+}
+
+uint32 gmemHash(GuestMemory *gm, uint32 va, uint32 len, uint32 *sum)
+{
+    uint32 done = 0, hashed = 0, n, i, s = *sum;
+    uint8 *ptr;
+    
+    while (done < len)
+    {
+        n = gmemMapVirtual(gm, va + done, len - done, &ptr);
+        if (ptr != NULL)
+        {
+            for (i = 0; i < n; i++)
+            {
+                s += ptr[i];
+            }
+            hashed += n;
+        }
+        done += n;
+    }
+    *sum = s;
+    return hashed;
+}
+
+uint8 gmemCompare(GuestMemory *gm, uint32 va, const uint8 *buf, uint32 len, uint32 *offset)
+{
+    uint32 done = 0, n, i;
+    uint8 *ptr;
+    
+    while (done < len)
+    {
+        n = gmemMapVirtual(gm, va + done, len - done, &ptr);
+        if (ptr == NULL)
+        {
+            if (offset != NULL)
+                *offset = done;
+            return GMEM_FAULT;
+        }
+        if (memcmp(ptr, buf + done, n) != 0)
+        {
+            for (i = 0; ptr[i] == buf[done + i]; i++);
+            if (offset != NULL)
+                *offset = done + i;
+            return GMEM_MISMATCH;
+        }
+        done += n;
+    }
+    return GMEM_MATCH;
+}
@@ -0,0 +1,153 @@
+/**
+	@file
+	Guest memory accessor (header file)
+    
+    Reads guest virtual memory by walking the 32-bit or PAE guest page 
+    tables itself, through a small set of guest frames kept mapped between
+    accesses, so no guest OS functions are needed
+    
+	@date 10/19/2026
+***************************************************************/
+
+#ifndef _MORE_GMEM_H_
+#define _MORE_GMEM_H_
+
+#include "stdint.h"
+
+/** Size of a guest page */
+#define GMEM_PAGE_SIZE 0x1000
+/** Number of guest frames kept mapped */
+#define GMEM_MAP_SLOTS 8
+/** Number of cached virtual to physical translations */
+#define GMEM_TLB_ENTRIES 16
+/** The guest uses PAE paging (CR4.PAE) */
+#define GMEM_FLAG_PAE 0x1
+
+/** The guest memory matches the buffer */
+#define GMEM_MATCH 0
+/** The guest memory differs from the buffer */
+#define GMEM_MISMATCH 1
+/** Part of the guest memory is not present */
+#define GMEM_FAULT 2
+
+/**
+    Callback which maps a guest frame into the host
+    
+    @param context Caller supplied context
+    @param phys Physical address of the frame, may be above 4 GiB with PAE
+    @return Pointer to the GMEM_PAGE_SIZE bytes of the frame, or NULL
+*/
+typedef uint8 * (*GmemMapFn)(void *context, uint64 phys);
+
+/**
+    Callback which releases a frame returned by a GmemMapFn
+    
+    @param context Caller supplied context
+    @param ptr Pointer returned by the map callback
+*/
+typedef void (*GmemUnmapFn)(void *context, uint8 *ptr);
+
+/**
+    Accessor for the memory of one guest address space
+*/
+struct GuestMemory_s
+{
+    uint32 CR3;
+    uint32 Flags; /**< GMEM_FLAG_* */
+    GmemMapFn MapFrame;
+    GmemUnmapFn UnmapFrame; /**< May be NULL */
+    void *Context; /**< Passed to the callbacks */
+    uint64 SlotFrame[GMEM_MAP_SLOTS]; /**< Frame held by each slot */
+    uint8 *SlotPtr[GMEM_MAP_SLOTS]; /**< Mapping of each slot, NULL if free */
+    uint32 NextSlot; /**< Next data slot to be reused */
+    uint32 TlbTag[GMEM_TLB_ENTRIES]; /**< Virtual page | 1, 0 if empty */
+    uint64 TlbFrame[GMEM_TLB_ENTRIES];
+    uint32 Walks; /**< Page table walks done */
+    uint32 TlbHits;
+    uint32 Maps; /**< Frames mapped in */
+};
+
+typedef struct GuestMemory_s GuestMemory;
+
+/**
+    Initializes an accessor
+    
+    @param gm Pointer to the accessor
+    @param cr3 CR3 value of the guest address space
+    @param flags GMEM_FLAG_* values describing the guest's paging mode
+    @param mapFrame Callback to map a guest frame
+    @param unmapFrame Callback to release a frame, may be NULL
+    @param context Context passed to the callbacks
+*/
+void gmemInit(GuestMemory *gm, uint32 cr3, uint32 flags, GmemMapFn mapFrame, 
+              GmemUnmapFn unmapFrame, void *context);
+
+/**
+    Switches the accessor to another address space and forgets all translations
+    
+    @param gm Pointer to the accessor
+    @param cr3 CR3 value of the guest address space
+*/
+void gmemSetCR3(GuestMemory *gm, uint32 cr3);
+
+/**
+    Forgets all translations, e.g. after the guest changed its page tables
+    
+    @param gm Pointer to the accessor
+*/
+void gmemFlush(GuestMemory *gm);
+
+/**
+    Unmaps every frame held by the accessor
+    
+    @param gm Pointer to the accessor
+*/
+void gmemRelease(GuestMemory *gm);
+
+/**
+    Translates a guest virtual address
+    
+    @param gm Pointer to the accessor
+    @param va Guest virtual address
+    @param phys Receives the guest physical address
+    @return 1 if the address is present, 0 otherwise
+*/
+uint8 gmemTranslate(GuestMemory *gm, uint32 va, uint64 *phys);
+
+/**
+    Copies guest virtual memory into a buffer
+    
+    @param gm Pointer to the accessor
+    @param va Guest virtual address to read from
+    @param buf Buffer to copy to
+    @param len Number of bytes to copy
+    @return Number of bytes copied, less than len if a page is not present
+*/
+uint32 gmemRead(GuestMemory *gm, uint32 va, uint8 *buf, uint32 len);
+
+/**
+    Adds up the bytes of guest virtual memory, the same checksum the 
+    measurement engine computes
+    
+    @param gm Pointer to the accessor
+    @param va Guest virtual address to start at
+    @param len Number of bytes to add up
+    @param sum Checksum to add the bytes to
+    @return Number of bytes added, pages which are not present are skipped
+*/
+uint32 gmemHash(GuestMemory *gm, uint32 va, uint32 len, uint32 *sum);
+
+/**
+    Compares guest virtual memory to a buffer
+    
+    @param gm Pointer to the accessor
+    @param va Guest virtual address to start at
+    @param buf Buffer to compare with
+    @param len Number of bytes to compare
+    @param offset Receives the offset of the first difference or of the
+    first byte which is not present, may be NULL
+    @return GMEM_MATCH, GMEM_MISMATCH or GMEM_FAULT
+*/
+uint8 gmemCompare(GuestMemory *gm, uint32 va, const uint8 *buf, uint32 len, uint32 *offset);
+
+#endif // _MORE_GMEM_H_
@@ -0,0 +1,474 @@
+/**
+	@file
+	Chunked measurement engine
+    
+    Builds in the driver (system worker threads) or, with MORE_PTHREADS 
+    defined, as a user-space library on top of pthreads:
+    gcc -DMORE_PTHREADS -c measure.c -lpthread
+		
+	@date 10/19/2026
+***************************************************************/
+#ifdef MORE_PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#else
+#include "ntddk.h"
+#endif
+#include "stdint.h"
+#include "measure.h"
+
+/**
+    Structure shared by the workers of a single job
+*/
+struct MeasureShared_s
+{
+    MeasureJob *Job;
+    volatile long NextChunk; /**< Next chunk to be claimed by a worker */
+};
+
+typedef struct MeasureShared_s MeasureShared;
+
+#ifdef MORE_PTHREADS
+#define measureClaimChunk(shared) ((uint32) __sync_fetch_and_add(&(shared)->NextChunk, 1))
+#define measureCountUnmapped(job) __sync_fetch_and_add(&(job)->Unmapped, 1)
+#else
+#define measureClaimChunk(shared) ((uint32) InterlockedIncrement(&(shared)->NextChunk) - 1)
+#define measureCountUnmapped(job) InterlockedIncrement(&(job)->Unmapped)
+#endif
+
+static void measureLayoutChunks(MeasureJob *job)
+{
+    job->ChunkPages = (job->NumPages + MEASURE_MAX_CHUNKS - 1) / MEASURE_MAX_CHUNKS;
+    if (job->ChunkPages < MEASURE_MIN_CHUNK_PAGES)
+        job->ChunkPages = MEASURE_MIN_CHUNK_PAGES;
+    job->NumChunks = (job->NumPages + job->ChunkPages - 1) / job->ChunkPages;
+}
+
+void measureInitJob(MeasureJob *job, MeasureMapFn map, MeasureUnmapFn unmap, void *context)
+{
+    memset(job, 0, sizeof(MeasureJob));
+    job->MapPage = map;
+    job->UnmapPage = unmap;
+    job->Context = context;
+}
+
+uint8 measureAddSpan(MeasureJob *job, uint32 offset, uint32 size)
+{
+    uint32 numPages = (size + MEASURE_PAGE_SIZE - 1) / MEASURE_PAGE_SIZE;
+    
+    if (job->NumSpans == MEASURE_MAX_SPANS)
+        return 0;
+    
+    job->Spans[job->NumSpans].Offset = offset;
+    job->Spans[job->NumSpans].Size = size;
+    job->Spans[job->NumSpans].FirstPage = job->NumPages;
+    job->NumSpans++;
+    job->NumPages += numPages;
+    
+    measureLayoutChunks(job);
+    return 1;
+}
+
+uint32 measureLocatePage(MeasureJob *job, uint32 ordinal, uint32 *offset)
+{
+    uint32 i, pageOff;
+    
+    if (ordinal >= job->NumPages)
+        return 0;
+    
+    // Spans are few (one per executable section), walk backwards to the owner
+    for (i = job->NumSpans; i > 0; i--)
+    {
+        if (job->Spans[i - 1].FirstPage <= ordinal)
+            break;
+    }
+    pageOff = (ordinal - job->Spans[i - 1].FirstPage) * MEASURE_PAGE_SIZE;
+    *offset = job->Spans[i - 1].Offset + pageOff;
+    
+    if (job->Spans[i - 1].Size - pageOff < MEASURE_PAGE_SIZE)
+        return job->Spans[i - 1].Size - pageOff;
+    return MEASURE_PAGE_SIZE;
+}
+
+uint32 measurePages(MeasureJob *job, uint32 first, uint32 count)
+{
+    uint32 sum = 0, i, j, len, offset = 0;
+    uint8 *ptr;
+    
+    for (i = first; i < first + count; i++)
+    {
+        len = measureLocatePage(job, i, &offset);
+        if (len == 0)
+            break;
+        
+        ptr = job->MapPage(job->Context, offset);
+        if (ptr == NULL)
+        {
+            measureCountUnmapped(job);
+            continue;
+        }
+        for (j = 0; j < len; j++)
+        {
+            sum += ptr[j];
+        }
+        if (job->UnmapPage != NULL)
+            job->UnmapPage(job->Context, ptr);
+    }
+    
+    return sum;
+}
+
+void measureChunk(MeasureJob *job, uint32 chunk)
+{
+    job->ChunkSums[chunk] = measurePages(job, chunk * job->ChunkPages, job->ChunkPages);
+}
+
+uint32 measureCombine(MeasureJob *job)
+{
+    uint32 i, sum = 0;
+    
+    for (i = 0; i < job->NumChunks; i++)
+    {
+        sum += job->ChunkSums[i];
+    }
+    return sum;
+}
+
+uint32 measureFindOrdinal(MeasureJob *job, uint32 offset)
+{
+    uint32 i;
+    
+    for (i = 0; i < job->NumSpans; i++)
+    {
+        if (offset >= job->Spans[i].Offset && 
+                    offset - job->Spans[i].Offset < job->Spans[i].Size)
+        {
+            return job->Spans[i].FirstPage + 
+                        (offset - job->Spans[i].Offset) / MEASURE_PAGE_SIZE;
+        }
+    }
+    return MEASURE_NO_PAGE;
+}
+
+uint32 measureSchedStorageSize(uint32 numPages)
+{
+    // Reference checksums followed by the activity, coverage and skip bitmaps
+    return (numPages + 3 * ((numPages + 31) / 32)) * sizeof(uint32);
+}
+
+void measureSchedInit(MeasureScheduler *sched, 
+                      MeasureJob *job, 
+                      uint32 *storage, 
+                      uint32 budgetPercent, 
+                      uint64 minDelay, 
+                      uint64 maxDelay, 
+                      uint32 seed)
+{
+    memset(sched, 0, sizeof(MeasureScheduler));
+    
+    sched->Job = job;
+    sched->NumWords = (job->NumPages + 31) / 32;
+    sched->Reference = storage;
+    sched->ActivityBits = storage + job->NumPages;
+    sched->CoverageBits = sched->ActivityBits + sched->NumWords;
+    sched->SkipBits = sched->CoverageBits + sched->NumWords;
+    sched->SlicePages = MEASURE_MIN_CHUNK_PAGES;
+    sched->BudgetPercent = (budgetPercent == 0 || budgetPercent > 100) ? 
+                                                MEASURE_DEFAULT_BUDGET : budgetPercent;
+    sched->JitterPercent = MEASURE_DEFAULT_JITTER;
+    sched->MinDelay = minDelay;
+    sched->MaxDelay = maxDelay;
+    sched->Seed = (seed != 0) ? seed : 0x2545F491;
+    sched->Total.NumPages = job->NumPages;
+}
+
+/**
+    Returns whether a page has been marked skipped
+*/
+static uint8 measureSchedSkipped(MeasureScheduler *sched, uint32 ordinal)
+{
+    return (sched->SkipBits[ordinal / 32] & ((uint32) 1 << (ordinal % 32))) != 0;
+}
+
+/**
+    Marks a page which could not be mapped as skipped
+*/
+static void measureSchedSkip(MeasureScheduler *sched, uint32 ordinal)
+{
+    sched->SkipBits[ordinal / 32] |= (uint32) 1 << (ordinal % 32);
+    sched->ActivityBits[ordinal / 32] &= ~((uint32) 1 << (ordinal % 32));
+    sched->Interval.Skipped++;
+}
+
+void measureSchedCapture(MeasureScheduler *sched)
+{
+    uint32 i;
+    long unmapped;
+    
+    for (i = 0; i < sched->Job->NumPages; i++)
+    {
+        unmapped = sched->Job->Unmapped;
+        sched->Reference[i] = measurePages(sched->Job, i, 1);
+        if (sched->Job->Unmapped != unmapped && !measureSchedSkipped(sched, i))
+            measureSchedSkip(sched, i);
+    }
+}
+
+void measureSchedNoteActivity(MeasureScheduler *sched, uint32 offset)
+{
+    uint32 ordinal;
+    
+    if (sched == NULL || sched->Job == NULL)
+        return;
+    ordinal = measureFindOrdinal(sched->Job, offset);
+    if (ordinal != MEASURE_NO_PAGE && !measureSchedSkipped(sched, ordinal))
+        sched->ActivityBits[ordinal / 32] |= (uint32) 1 << (ordinal % 32);
+}
+
+/**
+    Measures a single page against its reference and updates the statistics
+    
+    A page which cannot be mapped is not counted as measured, it is marked 
+    skipped so later slices do not spend their budget on it again.
+*/
+static uint32 measureSchedPage(MeasureScheduler *sched, uint32 ordinal)
+{
+    uint32 offset = 0, mismatch = 0, sum;
+    long unmapped = sched->Job->Unmapped;
+    
+    sum = measurePages(sched->Job, ordinal, 1);
+    if (sched->Job->Unmapped != unmapped)
+    {
+        measureSchedSkip(sched, ordinal);
+        return 0;
+    }
+    if (sum != sched->Reference[ordinal])
+    {
+        measureLocatePage(sched->Job, ordinal, &offset);
+        sched->LastMismatch = offset;
+        mismatch = 1;
+    }
+    sched->CoverageBits[ordinal / 32] |= (uint32) 1 << (ordinal % 32);
+    sched->Interval.PagesMeasured++;
+    sched->Interval.Mismatches += mismatch;
+    
+    return mismatch;
+}
+
+uint32 measureSchedSlice(MeasureScheduler *sched)
+{
+    uint32 budget = sched->SlicePages, mismatches = 0, i, bit, bits, steps;
+    
+    if (sched->Job == NULL || sched->Job->NumPages == 0)
+        return 0;
+    
+    // Pages with recent write or exec activity go first
+    for (i = 0; i < sched->NumWords && budget > 0; i++)
+    {
+        while (sched->ActivityBits[i] != 0 && budget > 0)
+        {
+            bits = sched->ActivityBits[i];
+            for (bit = 0; !(bits & ((uint32) 1 << bit)); bit++);
+            sched->ActivityBits[i] &= ~((uint32) 1 << bit);
+            
+            mismatches += measureSchedPage(sched, i * 32 + bit);
+            sched->Interval.HotPages++;
+            budget--;
+        }
+    }
+    
+    // Spend the rest of the slice on the round-robin sweep, passing over the
+    // skipped pages
+    for (steps = 0; budget > 0 && steps < sched->Job->NumPages; steps++)
+    {
+        if (!measureSchedSkipped(sched, sched->Cursor))
+        {
+            mismatches += measureSchedPage(sched, sched->Cursor);
+            budget--;
+        }
+        sched->Cursor++;
+        if (sched->Cursor == sched->Job->NumPages)
+        {
+            sched->Cursor = 0;
+            sched->Interval.Passes++;
+        }
+    }
+    
+    sched->Interval.Slices++;
+    return mismatches;
+}
+
+uint64 measureSchedNextDelay(MeasureScheduler *sched, uint64 sliceCost)
+{
+    uint64 delay = sliceCost * (100 - sched->BudgetPercent) / sched->BudgetPercent;
+    uint32 spread;
+    
+    // Keep the delay within bounds by changing how much work a slice does,
+    // the budget itself is never exceeded
+    if (delay > sched->MaxDelay && sched->SlicePages > MEASURE_MIN_SLICE_PAGES)
+        sched->SlicePages /= 2;
+    else if (delay < sched->MinDelay && sched->SlicePages < MEASURE_MAX_SLICE_PAGES)
+        sched->SlicePages *= 2;
+    
+    if (delay < sched->MinDelay)
+        delay = sched->MinDelay;
+    
+    // Randomize the delay so the slices cannot be predicted (xorshift32)
+    sched->Seed ^= sched->Seed << 13;
+    sched->Seed ^= sched->Seed >> 17;
+    sched->Seed ^= sched->Seed << 5;
+    spread = 2 * sched->JitterPercent + 1;
+    delay = delay * (100 - sched->JitterPercent + (sched->Seed % spread)) / 100;
+    
+    sched->Interval.BusyTime += sliceCost;
+    sched->Interval.IdleTime += delay;
+    return delay;
+}
+
+void measureSchedEndInterval(MeasureScheduler *sched, MeasureStats *stats)
+{
+    uint32 i, bits;
+    
+    sched->Interval.NumPages = sched->Job->NumPages;
+    sched->Interval.PagesCovered = 0;
+    for (i = 0; i < sched->NumWords; i++)
+    {
+        for (bits = sched->CoverageBits[i]; bits != 0; bits &= bits - 1)
+        {
+            sched->Interval.PagesCovered++;
+        }
+        sched->CoverageBits[i] = 0;
+    }
+    
+    if (stats != NULL)
+        *stats = sched->Interval;
+    
+    sched->Total.Slices += sched->Interval.Slices;
+    sched->Total.PagesMeasured += sched->Interval.PagesMeasured;
+    sched->Total.HotPages += sched->Interval.HotPages;
+    sched->Total.Mismatches += sched->Interval.Mismatches;
+    sched->Total.Passes += sched->Interval.Passes;
+    sched->Total.Skipped += sched->Interval.Skipped;
+    sched->Total.BusyTime += sched->Interval.BusyTime;
+    sched->Total.IdleTime += sched->Interval.IdleTime;
+    memset(&sched->Interval, 0, sizeof(MeasureStats));
+}
+
+/**
+    Body of every worker, claims chunks until there are none left
+    
+    @param shared Pointer to the state shared by the workers of the job
+*/
+static void measureWorkerLoop(MeasureShared *shared)
+{
+    uint32 chunk;
+    
+    while ((chunk = measureClaimChunk(shared)) < shared->Job->NumChunks)
+    {
+        measureChunk(shared->Job, chunk);
+    }
+}
+
+#ifdef MORE_PTHREADS
+
+static void * measureWorkerThread(void *param)
+{
+    measureWorkerLoop((MeasureShared *) param);
+    return NULL;
+}
+
+uint32 measureRun(MeasureJob *job, uint32 numWorkers)
+{
+    pthread_t threads[MEASURE_MAX_WORKERS];
+    uint8 started[MEASURE_MAX_WORKERS] = {0};
+    MeasureShared shared = {0};
+    uint32 i;
+    
+    shared.Job = job;
+    if (numWorkers > MEASURE_MAX_WORKERS)
+        numWorkers = MEASURE_MAX_WORKERS;
+    if (numWorkers > job->NumChunks)
+        numWorkers = job->NumChunks;
+    
+    // The calling thread is worker 0
+    for (i = 1; i < numWorkers; i++)
+    {
+        started[i] = (pthread_create(&threads[i], NULL, measureWorkerThread, &shared) == 0);
+    }
+    measureWorkerLoop(&shared);
+    for (i = 1; i < numWorkers; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
+    
+    return measureCombine(job);
+}
+
+uint32 measureGetProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32) count : 1;
+}
+
+#else
+
+/**
+    Structure used to hand a share of the job to a system worker thread
+*/
+struct MeasureWorker_s
+{
+    WORK_QUEUE_ITEM Item;
+    KEVENT Done;
+    MeasureShared *Shared;
+};
+
+typedef struct MeasureWorker_s MeasureWorker;
+
+static VOID measureWorkerRoutine(PVOID param)
+{
+    MeasureWorker *worker = (MeasureWorker *) param;
+    
+    measureWorkerLoop(worker->Shared);
+    KeSetEvent(&worker->Done, 0, FALSE);
+}
+
+uint32 measureRun(MeasureJob *job, uint32 numWorkers)
+{
+    MeasureWorker workers[MEASURE_MAX_WORKERS];
+    MeasureShared shared = {0};
+    uint32 i;
+    
+    shared.Job = job;
+    if (numWorkers > MEASURE_MAX_WORKERS)
+        numWorkers = MEASURE_MAX_WORKERS;
+    if (numWorkers > job->NumChunks)
+        numWorkers = job->NumChunks;
+    // Worker threads can only be used from IRQL = 0
+    if (numWorkers > 1 && KeGetCurrentIrql() != PASSIVE_LEVEL)
+        numWorkers = 1;
+    
+    // The calling thread is worker 0
+    for (i = 1; i < numWorkers; i++)
+    {
+        workers[i].Shared = &shared;
+        KeInitializeEvent(&workers[i].Done, NotificationEvent, FALSE);
+        ExInitializeWorkItem(&workers[i].Item, measureWorkerRoutine, &workers[i]);
+        ExQueueWorkItem(&workers[i].Item, CriticalWorkQueue);
+    }
+    measureWorkerLoop(&shared);
+    for (i = 1; i < numWorkers; i++)
+    {
+        KeWaitForSingleObject(&workers[i].Done, Executive, KernelMode, FALSE, NULL);
+    }
+    
+    return measureCombine(job);
+}
+
+uint32 measureGetProcessorCount()
+{
+    return (uint32) KeQueryActiveProcessorCount(NULL);
+}
+
+#endif
@@ -0,0 +1,290 @@
+/**
+	@file
+	Chunked measurement engine (header file)
+    
+    Splits the pages of a set of spans into fixed chunks, hashes the chunks
+    independently (optionally on several worker threads) and combines the
+    partial results in chunk order
+		
+	@date 10/19/2026
+***************************************************************/
+
+#ifndef _MORE_MEASURE_H_
+#define _MORE_MEASURE_H_
+
+#include "stdint.h"
+
+/** Page granularity used by the measurement engine */
+#define MEASURE_PAGE_SIZE 0x1000
+/** Maximum number of spans (executable sections) in a job */
+#define MEASURE_MAX_SPANS 16
+/** Maximum number of chunks a job is split into */
+#define MEASURE_MAX_CHUNKS 64
+/** Smallest number of pages placed in a chunk */
+#define MEASURE_MIN_CHUNK_PAGES 8
+/** Maximum number of worker threads used for a single job */
+#define MEASURE_MAX_WORKERS 16
+
+/** Default CPU budget of the measurement scheduler (percent of one core) */
+#define MEASURE_DEFAULT_BUDGET 5
+/** Default jitter applied to the delay between slices (+/- percent) */
+#define MEASURE_DEFAULT_JITTER 50
+/** Smallest number of pages measured per slice */
+#define MEASURE_MIN_SLICE_PAGES 1
+/** Largest number of pages measured per slice */
+#define MEASURE_MAX_SLICE_PAGES 256
+/** Ordinal returned for an offset no page of the job covers */
+#define MEASURE_NO_PAGE 0xFFFFFFFF
+
+/**
+    Callback which makes one page of the measured image readable
+    
+    @param context Caller supplied context from the job
+    @param offset Offset of the page from the start of the image
+    @return Pointer to the page, or NULL if it cannot be mapped
+*/
+typedef uint8 * (*MeasureMapFn)(void *context, uint32 offset);
+
+/**
+    Callback which releases a page returned by a MeasureMapFn
+    
+    @param context Caller supplied context from the job
+    @param ptr Pointer previously returned by the map callback
+*/
+typedef void (*MeasureUnmapFn)(void *context, uint8 *ptr);
+
+/**
+    Structure describing a contiguous range of the image to measure
+*/
+struct MeasureSpan_s
+{
+    uint32 Offset; /**< Offset of the span from the start of the image */
+    uint32 Size; /**< Number of bytes in the span */
+    uint32 FirstPage; /**< Ordinal of the first page of the span within the job */
+};
+
+typedef struct MeasureSpan_s MeasureSpan;
+
+/**
+    Structure holding a measurement job and its partial results
+*/
+struct MeasureJob_s
+{
+    MeasureSpan Spans[MEASURE_MAX_SPANS];
+    uint32 NumSpans;
+    uint32 NumPages; /**< Total pages across all spans */
+    uint32 ChunkPages; /**< Pages per chunk (the last chunk may be shorter) */
+    uint32 NumChunks;
+    uint32 ChunkSums[MEASURE_MAX_CHUNKS]; /**< Partial result of each chunk */
+    volatile long Unmapped; /**< Number of pages the map callback failed to provide (workers add to it concurrently) */
+    MeasureMapFn MapPage;
+    MeasureUnmapFn UnmapPage;
+    void *Context;
+};
+
+typedef struct MeasureJob_s MeasureJob;
+
+/**
+    Statistics kept by the measurement scheduler
+*/
+struct MeasureStats_s
+{
+    uint32 Slices; /**< Number of slices measured */
+    uint32 PagesMeasured; /**< Number of pages measured, including repeats */
+    uint32 HotPages; /**< Pages measured because of recent write or exec activity */
+    uint32 PagesCovered; /**< Distinct pages measured (filled in per interval) */
+    uint32 NumPages; /**< Pages in the job (filled in per interval) */
+    uint32 Mismatches; /**< Pages which no longer match their reference */
+    uint32 Passes; /**< Completed round-robin sweeps over the whole job */
+    uint32 Skipped; /**< Pages found unmappable, which are left out from then on */
+    uint64 BusyTime; /**< Time spent measuring, in the caller's units */
+    uint64 IdleTime; /**< Time scheduled between slices, in the caller's units */
+};
+
+typedef struct MeasureStats_s MeasureStats;
+
+/**
+    Incremental measurement scheduler
+    
+    Measures a job a slice at a time, hot pages first, and paces the slices so
+    that the time spent measuring stays within a CPU budget. The caller owns
+    the clock, all times are in whatever unit it passes in.
+*/
+struct MeasureScheduler_s
+{
+    MeasureJob *Job;
+    uint32 *Reference; /**< Reference checksum of every page */
+    uint32 *ActivityBits; /**< Pages with recent write or exec activity */
+    uint32 *CoverageBits; /**< Pages measured during the current interval */
+    uint32 *SkipBits; /**< Pages which could not be mapped and are no longer measured */
+    uint32 NumWords; /**< Number of words in each bitmap */
+    uint32 Cursor; /**< Next page of the round-robin sweep */
+    uint32 SlicePages; /**< Pages per slice, adapted to the budget */
+    uint32 BudgetPercent; /**< Share of one core measurement may use */
+    uint32 JitterPercent; /**< Random +/- variation of the delay */
+    uint64 MinDelay; /**< Shortest delay between slices */
+    uint64 MaxDelay; /**< Longest delay between slices before slices shrink */
+    uint32 Seed; /**< Jitter generator state, must be non-zero */
+    uint32 LastMismatch; /**< Image offset of the last page found modified */
+    MeasureStats Interval; /**< Statistics for the current interval */
+    MeasureStats Total; /**< Statistics since the scheduler was initialized */
+};
+
+typedef struct MeasureScheduler_s MeasureScheduler;
+
+/**
+    Initializes an empty measurement job
+    
+    @param job Pointer to the job
+    @param map Callback used to map pages in
+    @param unmap Callback used to map pages out
+    @param context Context handed to the callbacks
+*/
+void measureInitJob(MeasureJob *job, MeasureMapFn map, MeasureUnmapFn unmap, void *context);
+
+/**
+    Adds a span to a measurement job and recomputes the chunk layout
+    
+    @param job Pointer to the job
+    @param offset Offset of the span from the start of the image
+    @param size Number of bytes in the span
+    @return 1 if the span was added, 0 if the job is full
+*/
+uint8 measureAddSpan(MeasureJob *job, uint32 offset, uint32 size);
+
+/**
+    Locates a page of the job
+    
+    @param job Pointer to the job
+    @param ordinal Ordinal of the page within the job
+    @param offset Receives the image offset of the page
+    @return Number of bytes of the page which belong to the span, 0 if out of range
+*/
+uint32 measureLocatePage(MeasureJob *job, uint32 ordinal, uint32 *offset);
+
+/**
+    Hashes a run of pages on the calling thread
+    
+    @param job Pointer to the job
+    @param first Ordinal of the first page
+    @param count Number of pages
+    @return Partial checksum of the pages
+*/
+uint32 measurePages(MeasureJob *job, uint32 first, uint32 count);
+
+/**
+    Hashes a single chunk and stores its partial result in the job
+    
+    @param job Pointer to the job
+    @param chunk Chunk index
+*/
+void measureChunk(MeasureJob *job, uint32 chunk);
+
+/**
+    Combines the partial results of all chunks, in chunk order
+    
+    @param job Pointer to the job
+    @return Checksum of the whole job
+*/
+uint32 measureCombine(MeasureJob *job);
+
+/**
+    Measures a job, spreading the chunks over up to numWorkers threads
+    
+    @note With numWorkers <= 1 the job is measured serially on the calling thread,
+    which is the only mode that is safe at raised IRQL or in VMX root
+    @param job Pointer to the job
+    @param numWorkers Number of threads (including the caller) to use
+    @return Checksum of the whole job, independent of numWorkers
+*/
+uint32 measureRun(MeasureJob *job, uint32 numWorkers);
+
+/**
+    Returns the image offset to page ordinal mapping of a job
+    
+    @param job Pointer to the job
+    @param offset Offset from the start of the image
+    @return Ordinal of the page holding offset, or MEASURE_NO_PAGE if the job 
+            does not cover it
+*/
+uint32 measureFindOrdinal(MeasureJob *job, uint32 offset);
+
+/**
+    Returns the number of bytes of storage a scheduler needs for a job
+    
+    @param numPages Number of pages in the job
+    @return Size of the storage to hand to measureSchedInit
+*/
+uint32 measureSchedStorageSize(uint32 numPages);
+
+/**
+    Initializes a measurement scheduler
+    
+    @param sched Pointer to the scheduler
+    @param job Pointer to a fully built job, must outlive the scheduler
+    @param storage Zeroed buffer of measureSchedStorageSize bytes
+    @param budgetPercent Share of one core measurement may use (1 - 100)
+    @param minDelay Shortest delay between slices
+    @param maxDelay Longest delay between slices
+    @param seed Seed of the jitter generator
+*/
+void measureSchedInit(MeasureScheduler *sched, 
+                      MeasureJob *job, 
+                      uint32 *storage, 
+                      uint32 budgetPercent, 
+                      uint64 minDelay, 
+                      uint64 maxDelay, 
+                      uint32 seed);
+
+/**
+    Records the current contents of every page as the reference
+    
+    @note Pages which cannot be mapped are marked skipped
+    @param sched Pointer to the scheduler
+*/
+void measureSchedCapture(MeasureScheduler *sched);
+
+/**
+    Marks a page as recently written or executed so it is measured first
+    
+    @param sched Pointer to the scheduler
+    @param offset Offset of the page from the start of the image
+*/
+void measureSchedNoteActivity(MeasureScheduler *sched, uint32 offset);
+
+/**
+    Measures the next slice of pages
+    
+    @note A page which cannot be mapped is marked skipped and counted once, it 
+    is passed over by later slices and never measured again. The sweep visits
+    each page at most once per slice
+    @param sched Pointer to the scheduler
+    @return Number of pages in the slice which no longer match their reference
+*/
+uint32 measureSchedSlice(MeasureScheduler *sched);
+
+/**
+    Computes the delay until the next slice from the cost of the last one
+    
+    @param sched Pointer to the scheduler
+    @param sliceCost Time the last slice took
+    @return Jittered delay which keeps measurement within the budget
+*/
+uint64 measureSchedNextDelay(MeasureScheduler *sched, uint64 sliceCost);
+
+/**
+    Ends a statistics interval
+    
+    @param sched Pointer to the scheduler
+    @param stats Receives the statistics of the interval, including coverage
+*/
+void measureSchedEndInterval(MeasureScheduler *sched, MeasureStats *stats);
+
+/**
+    Returns the number of processors available to run measurement workers
+    
+    @return Number of active processors
+*/
+uint32 measureGetProcessorCount();
+
+#endif // _MORE_MEASURE_H_
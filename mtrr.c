@@ -0,0 +1,145 @@
+/**
+	@file
+	Memory type range register decoding
+    
+    Builds in the driver or, with MORE_PTHREADS defined, as a user-space
+    library: gcc -DMORE_PTHREADS -c mtrr.c
+    
+	@date 10/19/2026
+***************************************************************/
+#ifdef MORE_PTHREADS
+#include <string.h>
+#else
+#include "ntddk.h"
+#endif
+#include "stdint.h"
+#include "mtrr.h"
+
+/** End of the 64 KB fixed ranges */
+#define MTRR_FIXED_64K_END 0x80000
+/** End of the 16 KB fixed ranges */
+#define MTRR_FIXED_16K_END 0xC0000
+
+const uint32 mtrrFixedMsrs[MTRR_NUM_FIXED_MSRS] =
+{
+    0x250, 0x258, 0x259, 0x268, 0x269, 0x26A, 0x26B, 0x26C, 0x26D, 0x26E, 0x26F
+};
+
+void mtrrInit(MtrrState *state, uint64 cap, uint64 defType, uint32 physBits)
+{
+    uint32 count = (uint32) (cap & 0xFF);
+    
+    memset(state, 0, sizeof(MtrrState));
+    state->Enabled = (uint8) ((defType >> 11) & 1);
+    state->FixedEnabled = (uint8) (((cap >> 8) & 1) && ((defType >> 10) & 1));
+    state->DefaultType = (uint8) (defType & 0xFF);
+    state->NumVariable = (uint8) ((count < MTRR_MAX_VARIABLE) ? count : MTRR_MAX_VARIABLE);
+    state->AddressMask = ((physBits < 64) ? ((uint64) 1 << physBits) - 1 : ~(uint64) 0) &
+                         ~(uint64) 0xFFF;
+}
+
+void mtrrSetFixed(MtrrState *state, uint32 index, uint64 value)
+{
+    uint32 i;
+    
+    if (index >= MTRR_NUM_FIXED_MSRS)
+        return;
+    for (i = 0; i < 8; i++)
+    {
+        state->Fixed[index * 8 + i] = (uint8) (value >> (i * 8));
+    }
+}
+
+void mtrrSetVariable(MtrrState *state, uint32 index, uint64 physBase, uint64 physMask)
+{
+    if (index >= state->NumVariable)
+        return;
+    // PHYSMASKn.V (bit 11) says whether the pair is in use
+    state->VarMask[index] = ((physMask >> 11) & 1) ? physMask & state->AddressMask : 0;
+    state->VarBase[index] = physBase & state->VarMask[index];
+    state->VarType[index] = (uint8) (physBase & 0xFF);
+}
+
+/**
+    Returns the index of the fixed range holding addr and the end of that range
+*/
+static uint32 mtrrFixedIndex(uint32 addr, uint32 *end)
+{
+    if (addr < MTRR_FIXED_64K_END)
+    {
+        *end = (addr & ~0xFFFF) + 0x10000;
+        return addr >> 16;
+    }
+    if (addr < MTRR_FIXED_16K_END)
+    {
+        *end = (addr & ~0x3FFF) + 0x4000;
+        return 8 + ((addr - MTRR_FIXED_64K_END) >> 14);
+    }
+    *end = (addr & ~0xFFF) + 0x1000;
+    return 24 + ((addr - MTRR_FIXED_16K_END) >> 12);
+}
+
+/**
+    Returns the type of overlapping variable ranges of types a and b
+*/
+static uint8 mtrrCombine(uint8 a, uint8 b)
+{
+    if (a == b)
+        return a;
+    if (a == MTRR_TYPE_UC || b == MTRR_TYPE_UC)
+        return MTRR_TYPE_UC;
+    if ((a == MTRR_TYPE_WT && b == MTRR_TYPE_WB) || (a == MTRR_TYPE_WB && b == MTRR_TYPE_WT))
+        return MTRR_TYPE_WT;
+    return MTRR_TYPE_UC;
+}
+
+/**
+    Returns the type of an aligned block, halving it wherever a fixed range or
+    a variable range only covers part of it
+*/
+static uint8 mtrrBlockType(const MtrrState *state, uint64 base, uint64 size)
+{
+    uint64 low = size - 1;
+    uint32 i, addr, end;
+    uint8 type = MTRR_TYPE_UC, matched = 0, half;
+    
+    if (state->FixedEnabled && base < MTRR_FIXED_END)
+    {
+        // Only the block at 0 reaches past the fixed ranges
+        if (base + size > MTRR_FIXED_END)
+            goto split;
+        type = state->Fixed[mtrrFixedIndex((uint32) base, &end)];
+        for (addr = end; addr < base + size; addr = end)
+        {
+            if (state->Fixed[mtrrFixedIndex(addr, &end)] != type)
+                return MTRR_TYPE_MIXED;
+        }
+        return type;
+    }
+    
+    for (i = 0; i < state->NumVariable; i++)
+    {
+        // The bits above the block decide whether the range reaches it at all,
+        // mask bits inside the block mean it only covers part of it
+        if (state->VarMask[i] == 0 || ((base ^ state->VarBase[i]) & state->VarMask[i] & ~low) != 0)
+            continue;
+        if (state->VarMask[i] & low)
+            goto split;
+        type = matched ? mtrrCombine(type, state->VarType[i]) : state->VarType[i];
+        matched = 1;
+    }
+    return matched ? type : state->DefaultType;
+    
+  split:
+    half = mtrrBlockType(state, base, size / 2);
+    if (half == MTRR_TYPE_MIXED || half != mtrrBlockType(state, base + size / 2, size / 2))
+        return MTRR_TYPE_MIXED;
+    return half;
+}
+
+uint8 mtrrRangeType(const MtrrState *state, uint64 base, uint64 size)
+{
+    if (!state->Enabled)
+        return MTRR_TYPE_UC;
+    return mtrrBlockType(state, base & ~(size - 1), size);
+}
@@ -0,0 +1,107 @@
+/**
+	@file
+	Memory type range register decoding (header file)
+    
+    Holds a copy of the fixed and variable MTRRs and answers which memory
+    type a naturally aligned range of physical memory has, or that the range
+    crosses a type boundary and must be mapped with smaller pages
+    
+	@date 10/19/2026
+***************************************************************/
+
+#ifndef _MORE_MTRR_H_
+#define _MORE_MTRR_H_
+
+#include "stdint.h"
+
+/** IA32_MTRRCAP */
+#define MTRR_MSR_CAP 0xFE
+/** IA32_MTRR_DEF_TYPE */
+#define MTRR_MSR_DEF_TYPE 0x2FF
+/** IA32_MTRR_PHYSBASEn */
+#define MTRR_MSR_PHYSBASE(n) (0x200 + 2 * (n))
+/** IA32_MTRR_PHYSMASKn */
+#define MTRR_MSR_PHYSMASK(n) (0x201 + 2 * (n))
+
+/** Number of fixed range MTRRs */
+#define MTRR_NUM_FIXED_MSRS 11
+/** Number of ranges the fixed MTRRs describe, one type byte each */
+#define MTRR_NUM_FIXED 88
+/** End of the memory described by the fixed MTRRs (1 MiB) */
+#define MTRR_FIXED_END 0x100000
+/** Most variable range MTRRs kept */
+#define MTRR_MAX_VARIABLE 32
+
+/** Memory types, the same encoding as the EPT memory types */
+#define MTRR_TYPE_UC 0
+#define MTRR_TYPE_WC 1
+#define MTRR_TYPE_WT 4
+#define MTRR_TYPE_WP 5
+#define MTRR_TYPE_WB 6
+/** Returned for a range which holds more than one memory type */
+#define MTRR_TYPE_MIXED 0xFF
+
+/** MSR numbers of the fixed range MTRRs, in address order */
+extern const uint32 mtrrFixedMsrs[MTRR_NUM_FIXED_MSRS];
+
+/**
+    Copy of the MTRRs of a processor
+*/
+struct MtrrState_s
+{
+    uint8 Enabled; /**< IA32_MTRR_DEF_TYPE.E, all memory is UC when clear */
+    uint8 FixedEnabled; /**< The fixed MTRRs are supported and enabled */
+    uint8 DefaultType; /**< Type of memory no variable range covers */
+    uint8 NumVariable; /**< Number of variable ranges kept */
+    uint8 Fixed[MTRR_NUM_FIXED]; /**< Type of each fixed range, in address order */
+    uint8 VarType[MTRR_MAX_VARIABLE];
+    uint64 VarBase[MTRR_MAX_VARIABLE]; /**< Masked base of each variable range */
+    uint64 VarMask[MTRR_MAX_VARIABLE]; /**< Mask of each variable range, 0 if not valid */
+    uint64 AddressMask; /**< Physical address bits of a page (MAXPHYADDR-1:12) */
+};
+
+typedef struct MtrrState_s MtrrState;
+
+/**
+    Initializes the state from IA32_MTRRCAP and IA32_MTRR_DEF_TYPE, with no
+    fixed or variable ranges set yet
+    
+    @param state Pointer to the state
+    @param cap Value of IA32_MTRRCAP
+    @param defType Value of IA32_MTRR_DEF_TYPE
+    @param physBits Width of a physical address in bits
+*/
+void mtrrInit(MtrrState *state, uint64 cap, uint64 defType, uint32 physBits);
+
+/**
+    Records a fixed range MTRR
+    
+    @param state Pointer to the state
+    @param index Index of the MSR in mtrrFixedMsrs
+    @param value Value of the MSR, eight type bytes
+*/
+void mtrrSetFixed(MtrrState *state, uint32 index, uint64 value);
+
+/**
+    Records a variable range MTRR, ignored if index is past NumVariable
+    
+    @param state Pointer to the state
+    @param index Number of the variable range
+    @param physBase Value of IA32_MTRR_PHYSBASEn
+    @param physMask Value of IA32_MTRR_PHYSMASKn
+*/
+void mtrrSetVariable(MtrrState *state, uint32 index, uint64 physBase, uint64 physMask);
+
+/**
+    Returns the memory type of a naturally aligned range
+    
+    @note Where variable ranges overlap UC wins and WT wins over WB, other
+    overlaps are undefined and taken as UC
+    @param state Pointer to the state
+    @param base Physical address of the range, a multiple of size
+    @param size Power of two size of the range, at least 4 KB
+    @return MTRR_TYPE_* of the whole range, or MTRR_TYPE_MIXED
+*/
+uint8 mtrrRangeType(const MtrrState *state, uint64 base, uint64 size);
+
+#endif // _MORE_MTRR_H_
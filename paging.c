@@ -1,304 +1,819 @@
-/**
-	@file
-	Windows driver to manipulate the page tables
-		
-	@date 11/17/2011
-***************************************************************/
-#include "Ntifs.h"
-#include "ntddk.h"
-#include "../stdint.h"
-#include "paging.h"
-#include "vmx/ept.h"
-
-uint32 ContextTag = '2gaT';
-
-void pagingMapOutEntry(void *ptr)
-{
-    pagingMapOutEntryDirql(ptr, NULL);
-}
-
-void pagingMapOutEntryDirql(void *ptr, PagingContext * context)
-{
-    if (ptr != NULL)
-        MapOutMemory(context, ptr, sizeof(PageTableEntry));
-}
-
-PageTableEntry * pagingMapInPte(uint32 CR3, void *virtualAddress)
-{
-    return pagingMapInPteDirql(CR3, virtualAddress, NULL);
-}
-
-PageTableEntry * pagingMapInPteDirql(uint32 CR3, 
-                                     void *virtualAddress, 
-                                     PagingContext * context)
-{
-    PHYSICAL_ADDRESS pageTablePhys = {0};
-    PageDirectoryEntrySmallPage *pageDirectory = (PageDirectoryEntrySmallPage *)
-                                            pagingMapInPdeDirql(CR3, virtualAddress, context);
-    PageTableEntry *outPte = NULL;
-    uint32 pdeOff, pteOff, pageOff = 0;
-    
-    if (pageDirectory == NULL)
-    {
-        return NULL;
-    }
-
-    // Determine if we're dealing with large or small pages
-    if (pageDirectory->ps == 1 || pageDirectory->p == 0)
-    {
-        // We are a PDE, not PTE   
-        outPte = NULL;
-    } 
-    else
-    {
-        pteOff = ((uint32) virtualAddress & 0x003FF000) >> 12;
-        pageTablePhys.LowPart = (pageDirectory->address << 12) | 
-                                            (pteOff * sizeof(PageTableEntry));
-                                            
-        outPte = MapInMemory(context, pageTablePhys, sizeof(*outPte));
-    }
-    
-    pagingMapOutEntryDirql((void *) pageDirectory, context);
-    return outPte;
-}
-
-PageDirectoryEntry * pagingMapInPde(uint32 CR3, void *virtualAddress)
-{
-    return pagingMapInPdeDirql(CR3, virtualAddress, NULL);
-}
-
-PageDirectoryEntry * pagingMapInPdeDirql(uint32 CR3, 
-                                         void *virtualAddress, 
-                                         PagingContext * context)
-{
-    PHYSICAL_ADDRESS pageDirPhys = {0};
-    uint32 pdeOff = ((uint32) virtualAddress & 0xFFC00000) >> 22;
-    pageDirPhys.LowPart = (CR3 & 0xFFFFF000) | 
-                                        (pdeOff * sizeof(PageDirectoryEntry));
-    
-    return (PageDirectoryEntry *) MapInMemory(context, pageDirPhys, 
-                                            sizeof(PageDirectoryEntry));
-}
-
-PageWalkContext * pagingInitWalk(PHYSICAL_ADDRESS physicalAddress)
-{
-    PageWalkContext *context = (PageWalkContext *) ExAllocatePoolWithTag(
-                                                        NonPagedPool, 
-                                                        sizeof(PageWalkContext), 
-                                                        ContextTag);
-    PHYSICAL_ADDRESS pdeBase = {0};
-    uint32 cr3val = 0;
-    
-    __asm
-    {
-        push eax
-        mov eax, cr3
-        mov cr3val, eax
-        pop eax
-    }
-    
-    pdeBase.LowPart = cr3val & 0xFFFFF000;
-    
-    context->targetAddress = physicalAddress;
-    context->pdeOff = 0;
-    context->pteOff = 0;
-    context->pte = NULL;
-    context->pde = MmMapIoSpace(pdeBase, 1024 * sizeof(PageDirectoryEntry), 0);
-    
-    return context;
-}
-
-uint32 pagingGetNext(PageWalkContext *context)
-{
-    PHYSICAL_ADDRESS ptePhys = {0};
-    if (context->pde == NULL)
-        return 0;
-    if (context->pte == NULL)
-    {
-        for ( ; context->pdeOff < 1024; context->pdeOff++)
-        {
-            // Large pages (could be paged out)
-            if ((context->pde[context->pdeOff]).ps == 1)
-            {
-                if (context->targetAddress.LowPart >> 22 == 
-                                        (context->pde[context->pdeOff]).address)
-                {
-                    // Prevent an endless loop
-                    context->pdeOff++;
-                    return ((context->pdeOff - 1) << 22) | 
-                                (context->targetAddress.LowPart & 0x003FFFFF);
-                }
-            }
-            // Small pages
-            else if ((context->pde[context->pdeOff]).p == 1 &&
-                                        (context->pde[context->pdeOff]).ps == 0)
-            {
-                ptePhys.LowPart = ((PageDirectoryEntrySmallPage *) 
-                                    &(context->pde[context->pdeOff]))->address << 12;
-                context->pte = MmMapIoSpace(ptePhys, 1024 * sizeof(PageTableEntry), 0);
-                
-                // Loop through a page table
-                for (context->pteOff = 0; context->pteOff < 1024; context->pteOff++)
-                {
-                    if ((context->pte[context->pteOff]).address ==
-                                            context->targetAddress.LowPart >> 12)
-                    {
-                        //DbgPrint("Address %x\r\n", (context->pte[context->pteOff]).address);
-                        context->pteOff++;
-                        return (context->pdeOff << 22) | ((context->pteOff - 1) << 12) |
-                                (context->targetAddress.LowPart & 0x00000FFF);
-                    }
-                }
-                
-                MmUnmapIoSpace(context->pte, 1024 * sizeof(PageTableEntry));
-                context->pte = NULL;
-                context->pteOff = 0;
-            }
-        }
-    }
-    else
-    {
-        // Loop through a page table
-        for ( ; context->pteOff < 1024; context->pteOff++)
-        {
-            if ((context->pte[context->pteOff]).address ==
-                                    context->targetAddress.LowPart >> 12)
-            {
-                //DbgPrint("Address %x\r\n", (context->pte[context->pteOff]).address);
-                context->pteOff++;
-                return (context->pdeOff << 22) | ((context->pteOff - 1) << 12) |
-                        (context->targetAddress.LowPart & 0x00000FFF);
-            }
-        }
-        
-        MmUnmapIoSpace(context->pte, 1024 * sizeof(PageTableEntry));
-        context->pte = NULL;
-        context->pteOff = 0;
-        context->pdeOff++;
-        
-        // Recurse to the next PDE
-        return pagingGetNext(context);
-    }
-    
-    // Not found
-    return 0;
-}
-
-void pagingFreeWalk(PageWalkContext *context)
-{
-    if (context->pde != NULL)
-    {
-        MmUnmapIoSpace(context->pde, 1024 * sizeof(*(context->pde)));
-    }
-    if (context->pte != NULL)
-    {
-        MmUnmapIoSpace(context->pte, 1024 * sizeof(*(context->pte)));
-    }
-    
-    ExFreePoolWithTag((PVOID) context, ContextTag);
-}
-
-PMDLX pagingLockProcessMemory(PVOID startAddr, 
-                              uint32 len,
-                              PEPROCESS proc, 
-                              PKAPC_STATE apcstate)
-{
-    PMDLX mdl = NULL;
-    
-    // Attach to process to ensure virtual addresses are correct
-    KeStackAttachProcess(proc, apcstate); 
-    
-    // Create MDL to represent the image
-    mdl = IoAllocateMdl(startAddr, (ULONG) len, FALSE, FALSE, NULL);
-    if (mdl == NULL)
-        return NULL;
-    
-    // Attempt to probe and lock the pages into memory
-    try 
-    {
-        MmProbeAndLockPages(mdl, UserMode, ReadAccess);
-    } except (EXCEPTION_EXECUTE_HANDLER)
-    {
-        DbgPrint("Unable to ProbeAndLockPages! Error: %x\r\n", GetExceptionCode());
-        
-        IoFreeMdl(mdl);
-        mdl = NULL;
-    }
-    
-    KeUnstackDetachProcess(apcstate);
-    
-    
-    return mdl;
-}
-
-void pagingUnlockProcessMemory(PEPROCESS proc, PKAPC_STATE apcstate, PMDLX mdl)
-{
-    // Attach to process to ensure virtual addresses are correct
-    KeStackAttachProcess(proc, apcstate); 
-    
-    // Unlock & free MDL and corresponding pages
-    MmUnlockPages(mdl);
-    IoFreeMdl(mdl);
-    
-    KeUnstackDetachProcess(apcstate);
-}
-
-void pagingInitMappingOperations(PagingContext *context, uint32 numPages)
-{
-    uint32 i, cr3Val;
-    const uint32 tag = '4gaT';
-    PHYSICAL_ADDRESS phys = {0};
-    PageDirectoryEntrySmallPage *pde;
-    
-    __asm
-    {
-        PUSH EAX
-        MOV EAX, CR3
-        MOV cr3Val, EAX
-        POP EAX
-    }
-    context->CR3Val = cr3Val;
-    phys.LowPart = cr3Val & 0xFFFFF000;
-    
-    context->PageArray = (uint8 *) ExAllocatePoolWithTag(NonPagedPool, 
-                                                    numPages * PAGE_SIZE, tag);
-    context->NumPages = numPages;
-    context->PageArrayBitmap = (uint8 *) ExAllocatePoolWithTag(NonPagedPool, 
-                                                                numPages, tag);
-    RtlZeroMemory(context->PageArrayBitmap, numPages);
-
-}
-
-void pagingEndMappingOperations(PagingContext *context)
-{
-    const uint32 tag = '4gaT';
-    PHYSICAL_ADDRESS phys = {0};
-    PageDirectoryEntrySmallPage *pde;
-
-    ExFreePoolWithTag(context->PageArray, tag);
-    context->NumPages = 0;
-    ExFreePoolWithTag(context->PageArrayBitmap, tag);
-    
-}
-
-void * pagingAllocPage(PagingContext *context)
-{
-    uint32 i;
-    for (i = 0; i < context->NumPages; i++)
-    {
-        if (context->PageArrayBitmap[i] == 0)
-        {
-            // Mark page as taken
-            context->PageArrayBitmap[i] = 1;
-            return context->PageArray + (i * PAGE_SIZE);
-        }
-    }
-    // No memory left
-    return NULL;
-}
-
-void pagingFreePage(PagingContext *context, void * ptr)
-{
-    // Mark that page as free
-    context->PageArrayBitmap[((uint8 *) ptr - context->PageArray) / PAGE_SIZE] = 0;
-}
+/**
+	@file
+	Windows driver to manipulate the page tables
+		
+	@date 11/17/2011
+***************************************************************/
+#include "Ntifs.h"
+#include "ntddk.h"
+#include "../stdint.h"
+#include "paging.h"
+#include "vmx/ept.h"
+
+/** Set if the guest runs with PAE paging (CR4.PAE) */
+uint8 PagingPae = 0;
+
+void pagingMapOutEntry(void *ptr)
+{
+    pagingMapOutEntryDirql(ptr, NULL);
+}
+
+void pagingMapOutEntryDirql(void *ptr, PagingContext * context)
+{
+    if (ptr != NULL)
+        MapOutMemory(context, ptr, sizeof(PageTableEntry));
+}
+
+PageTableEntry * pagingMapInPte(uint32 CR3, void *virtualAddress)
+{
+    return pagingMapInPteDirql(CR3, virtualAddress, NULL);
+}
+
+PageTableEntry * pagingMapInPteDirql(uint32 CR3, 
+                                     void *virtualAddress, 
+                                     PagingContext * context)
+{
+    PHYSICAL_ADDRESS pageTablePhys = {0};
+    PageDirectoryEntrySmallPage *pageDirectory = (PageDirectoryEntrySmallPage *)
+                                            pagingMapInPdeDirql(CR3, virtualAddress, context);
+    PageTableEntry *outPte = NULL;
+    uint32 pdeOff, pteOff, pageOff = 0;
+    
+    if (pageDirectory == NULL)
+    {
+        return NULL;
+    }
+
+    // Determine if we're dealing with large or small pages
+    if (pageDirectory->ps == 1 || pageDirectory->p == 0)
+    {
+        // We are a PDE, not PTE   
+        outPte = NULL;
+    } 
+    else
+    {
+        pteOff = ((uint32) virtualAddress & 0x003FF000) >> 12;
+        pageTablePhys.LowPart = (pageDirectory->address << 12) | 
+                                            (pteOff * sizeof(PageTableEntry));
+                                            
+        outPte = MapInMemory(context, pageTablePhys, sizeof(*outPte));
+    }
+    
+    pagingMapOutEntryDirql((void *) pageDirectory, context);
+    return outPte;
+}
+
+PageDirectoryEntry * pagingMapInPde(uint32 CR3, void *virtualAddress)
+{
+    return pagingMapInPdeDirql(CR3, virtualAddress, NULL);
+}
+
+PageDirectoryEntry * pagingMapInPdeDirql(uint32 CR3, 
+                                         void *virtualAddress, 
+                                         PagingContext * context)
+{
+    PHYSICAL_ADDRESS pageDirPhys = {0};
+    uint32 pdeOff = ((uint32) virtualAddress & 0xFFC00000) >> 22;
+    
+    // 32-bit entries only, PAE tables are walked with a GuestMemory accessor
+    if (PagingPae)
+        return NULL;
+    pageDirPhys.LowPart = (CR3 & 0xFFFFF000) | 
+                                        (pdeOff * sizeof(PageDirectoryEntry));
+    
+    return (PageDirectoryEntry *) MapInMemory(context, pageDirPhys, 
+                                            sizeof(PageDirectoryEntry));
+}
+
+/** Number of page tables a translation cache keeps mapped */
+#define PAGING_CACHE_TABLES 16
+
+/**
+    Cache of the mapped in page tables of one address space
+    
+    PTE pointers handed out by the cache hold a reference on their page table,
+    so tables are only unmapped once every PTE in them was mapped out
+*/
+struct PagingTableCache_s
+{
+    uint32 CR3;
+    PagingContext *Context; /**< Context to map with, or NULL for the kernel functions */
+    PageDirectoryEntrySmallPage *Directory; /**< Page directory, mapped for the cache's lifetime */
+    PageTableEntry *Tables[PAGING_CACHE_TABLES];
+    uint32 PdeIndex[PAGING_CACHE_TABLES]; /**< PDE the table belongs to, ~0 once stale */
+    uint32 TableFrame[PAGING_CACHE_TABLES]; /**< Frame the PDE pointed at when mapped */
+    uint32 RefCount[PAGING_CACHE_TABLES]; /**< PTEs handed out from the table */
+    uint32 Next; /**< Next slot to consider for eviction */
+};
+
+typedef struct PagingTableCache_s PagingTableCache;
+
+/**
+    Sets up a translation cache for an address space
+    
+    @param cache Pointer to the cache to initialize
+    @param CR3 CR3 value of the address space
+    @param context Pointer to paging context to map with, or NULL
+    @return 1 if the page directory could be mapped, 0 otherwise or if the
+    guest uses PAE
+*/
+static uint8 pagingInitTableCache(PagingTableCache *cache, uint32 CR3, PagingContext *context)
+{
+    PHYSICAL_ADDRESS phys = {0};
+    
+    RtlZeroMemory(cache, sizeof(PagingTableCache));
+    cache->CR3 = CR3;
+    cache->Context = context;
+    if (PagingPae)
+        return 0;
+    phys.LowPart = CR3 & 0xFFFFF000;
+    cache->Directory = (PageDirectoryEntrySmallPage *) MapInMemory(context, phys, PAGE_SIZE);
+    return cache->Directory != NULL;
+}
+
+/**
+    Unmaps everything held by a translation cache
+    
+    @param cache Pointer to the cache
+*/
+static void pagingFreeTableCache(PagingTableCache *cache)
+{
+    uint32 i;
+    
+    for (i = 0; i < PAGING_CACHE_TABLES; i++)
+    {
+        if (cache->Tables[i] != NULL)
+            MapOutMemory(cache->Context, (void *) cache->Tables[i], PAGE_SIZE);
+        cache->Tables[i] = NULL;
+    }
+    if (cache->Directory != NULL)
+        MapOutMemory(cache->Context, (void *) cache->Directory, PAGE_SIZE);
+    cache->Directory = NULL;
+}
+
+/**
+    Returns the PTE for a virtual address, mapping its page table in only if
+    it is not cached already
+    
+    @note If the PDE now points at a different page table the cached mapping
+    is dropped. If every slot is in use the PTE is mapped on its own.
+    @param cache Pointer to the cache
+    @param virtualAddress Virtual address of the memory
+    @return Pointer to the PTE, or NULL if the address is not mapped with a PTE
+*/
+static PageTableEntry * pagingCacheMapInPte(PagingTableCache *cache, void *virtualAddress)
+{
+    uint32 pdeOff = (uint32) virtualAddress >> 22, 
+           pteOff = ((uint32) virtualAddress & 0x003FF000) >> 12, i, slot = ~0;
+    PageDirectoryEntrySmallPage pde;
+    PHYSICAL_ADDRESS phys = {0};
+    
+    if (cache->Directory == NULL)
+        return NULL;
+    pde = cache->Directory[pdeOff];
+    if (pde.p == 0 || pde.ps == 1)
+        return NULL;
+    
+    for (i = 0; i < PAGING_CACHE_TABLES; i++)
+    {
+        if (cache->Tables[i] == NULL || cache->PdeIndex[i] != pdeOff)
+            continue;
+        if (cache->TableFrame[i] == pde.address)
+        {
+            cache->RefCount[i]++;
+            return &cache->Tables[i][pteOff];
+        }
+        // The page table was remapped, never hand out the old one again
+        cache->PdeIndex[i] = ~0;
+        if (cache->RefCount[i] == 0)
+        {
+            MapOutMemory(cache->Context, (void *) cache->Tables[i], PAGE_SIZE);
+            cache->Tables[i] = NULL;
+        }
+    }
+    
+    // Take a free slot, or evict the next table nobody holds a PTE from
+    for (i = 0; i < PAGING_CACHE_TABLES && slot == ~0; i++)
+    {
+        if (cache->Tables[i] == NULL)
+            slot = i;
+    }
+    for (i = 0; i < PAGING_CACHE_TABLES && slot == ~0; i++)
+    {
+        if (cache->RefCount[cache->Next] == 0)
+        {
+            slot = cache->Next;
+            MapOutMemory(cache->Context, (void *) cache->Tables[slot], PAGE_SIZE);
+            cache->Tables[slot] = NULL;
+        }
+        cache->Next = (cache->Next + 1) % PAGING_CACHE_TABLES;
+    }
+    
+    phys.LowPart = pde.address << 12;
+    if (slot == ~0)
+    {
+        // Every table is in use, map just this PTE
+        phys.LowPart |= pteOff * sizeof(PageTableEntry);
+        return (PageTableEntry *) MapInMemory(cache->Context, phys, sizeof(PageTableEntry));
+    }
+    
+    cache->Tables[slot] = (PageTableEntry *) MapInMemory(cache->Context, phys, PAGE_SIZE);
+    if (cache->Tables[slot] == NULL)
+        return NULL;
+    cache->PdeIndex[slot] = pdeOff;
+    cache->TableFrame[slot] = pde.address;
+    cache->RefCount[slot] = 1;
+    return &cache->Tables[slot][pteOff];
+}
+
+/**
+    Releases a PTE returned by pagingCacheMapInPte
+    
+    @param cache Pointer to the cache
+    @param pte Pointer returned by pagingCacheMapInPte
+*/
+static void pagingCacheMapOutPte(PagingTableCache *cache, PageTableEntry *pte)
+{
+    uint32 i;
+    
+    if (pte == NULL)
+        return;
+    for (i = 0; i < PAGING_CACHE_TABLES; i++)
+    {
+        if (cache->Tables[i] != NULL && pte >= cache->Tables[i] && 
+                pte < cache->Tables[i] + PAGE_SIZE / sizeof(PageTableEntry))
+        {
+            cache->RefCount[i]--;
+            // Stale tables go as soon as the last PTE in them is released
+            if (cache->RefCount[i] == 0 && cache->PdeIndex[i] == ~0)
+            {
+                MapOutMemory(cache->Context, (void *) cache->Tables[i], PAGE_SIZE);
+                cache->Tables[i] = NULL;
+            }
+            return;
+        }
+    }
+    // Mapped on its own
+    MapOutMemory(cache->Context, (void *) pte, sizeof(PageTableEntry));
+}
+
+uint32 pagingTranslateRange(uint32 CR3, void *virtualAddress, uint32 numPages,
+                            uint32 *outPfns, PageTableEntry *outPtes, PagingContext *context)
+{
+    PagingTableCache cache;
+    PageDirectoryEntrySmallPage pde;
+    PageTableEntry *pte, zeroPte = {0};
+    uint32 va = (uint32) virtualAddress & 0xFFFFF000, i, present = 0;
+    GuestMemory gm;
+    uint64 phys;
+    
+    if (PagingPae)
+    {
+        // The accessor keeps the current PAE directory and table mapped
+        pagingInitGuestMemory(&gm, CR3, context);
+        for (i = 0; i < numPages; i++, va += PAGE_SIZE)
+        {
+            outPfns[i] = 0;
+            if (outPtes != NULL)
+                outPtes[i] = zeroPte;
+            if (gmemTranslate(&gm, va, &phys))
+            {
+                outPfns[i] = (uint32) (phys >> 12);
+                present++;
+            }
+        }
+        gmemRelease(&gm);
+        return present;
+    }
+    
+    if (!pagingInitTableCache(&cache, CR3, context))
+        return 0;
+    
+    for (i = 0; i < numPages; i++, va += PAGE_SIZE)
+    {
+        outPfns[i] = 0;
+        if (outPtes != NULL)
+            outPtes[i] = zeroPte;
+        
+        pde = cache.Directory[va >> 22];
+        if (pde.p == 0)
+            continue;
+        if (pde.ps == 1)
+        {
+            // 4 MiB page, the frame is the PDE's plus the page's index in it
+            outPfns[i] = (pde.address & 0xFFC00) | ((va >> 12) & 0x3FF);
+            present++;
+            continue;
+        }
+        
+        // Every page of a 4 MiB region hits the same cached table
+        pte = pagingCacheMapInPte(&cache, (void *) va);
+        if (pte == NULL)
+            continue;
+        if (outPtes != NULL)
+            outPtes[i] = *pte;
+        if (pte->p)
+        {
+            outPfns[i] = pte->address;
+            present++;
+        }
+        pagingCacheMapOutPte(&cache, pte);
+    }
+    
+    pagingFreeTableCache(&cache);
+    return present;
+}
+
+uint32 pagingNextChangedFrame(const uint32 *seen, const uint32 *pfns, uint32 start, 
+                              uint32 numPages)
+{
+    uint32 i = start;
+    
+    // Frames rarely change between two switches, skip unchanged groups of four
+    for ( ; i + 4 <= numPages; i += 4)
+    {
+        if (((seen[i] ^ pfns[i]) | (seen[i + 1] ^ pfns[i + 1]) |
+                (seen[i + 2] ^ pfns[i + 2]) | (seen[i + 3] ^ pfns[i + 3])) != 0)
+            break;
+    }
+    for ( ; i < numPages; i++)
+    {
+        if (seen[i] != pfns[i])
+            return i;
+    }
+    return numPages;
+}
+
+/**
+    Maps in a guest frame for a guest memory accessor
+*/
+static uint8 * pagingMapGuestFrame(void *param, uint64 phys)
+{
+    PagingContext *context = (PagingContext *) param;
+    PHYSICAL_ADDRESS framePhys;
+    
+    framePhys.QuadPart = (LONGLONG) phys;
+    if (context == NULL)
+        return (uint8 *) MmMapIoSpace(framePhys, PAGE_SIZE, 0);
+    return (uint8 *) pagingMapInPhys(context, framePhys, PAGE_SIZE);
+}
+
+static void pagingUnmapGuestFrame(void *param, uint8 *ptr)
+{
+    PagingContext *context = (PagingContext *) param;
+    
+    if (context == NULL)
+        MmUnmapIoSpace((void *) ptr, PAGE_SIZE);
+    else
+        pagingMapOutPhys(context, (void *) ptr, PAGE_SIZE);
+}
+
+void pagingInitGuestMemory(GuestMemory *gm, uint32 CR3, PagingContext *context)
+{
+    gmemInit(gm, CR3, PagingPae ? GMEM_FLAG_PAE : 0, pagingMapGuestFrame, 
+             pagingUnmapGuestFrame, (void *) context);
+}
+
+uint32 pagingBuildReverseMap(uint32 CR3, ReverseMap *map, PagingContext *context)
+{
+    uint32 found;
+#ifdef RMAP_SSE2
+    KFLOATING_SAVE fpState;
+    uint8 simd = 0;
+    
+    // The FPU state of the interrupted thread must survive the SSE2 kernel
+    map->Flags &= ~RMAP_FLAG_SIMD;
+    if (KeGetCurrentIrql() <= DISPATCH_LEVEL && 
+            ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) &&
+            NT_SUCCESS(KeSaveFloatingPointState(&fpState)))
+    {
+        map->Flags |= RMAP_FLAG_SIMD;
+        simd = 1;
+    }
+#endif
+    if (PagingPae)
+        map->Flags |= RMAP_FLAG_PAE;
+    else
+        map->Flags &= ~RMAP_FLAG_PAE;
+    found = rmapBuild(map, CR3, pagingMapGuestFrame, pagingUnmapGuestFrame, (void *) context);
+#ifdef RMAP_SSE2
+    if (simd)
+        KeRestoreFloatingPointState(&fpState);
+#endif
+    return found;
+}
+
+PMDLX pagingLockProcessMemory(PVOID startAddr, 
+                              uint32 len,
+                              PEPROCESS proc, 
+                              PKAPC_STATE apcstate)
+{
+    PMDLX mdl = NULL;
+    
+    // Attach to process to ensure virtual addresses are correct
+    KeStackAttachProcess(proc, apcstate); 
+    
+    // Create MDL to represent the image
+    mdl = IoAllocateMdl(startAddr, (ULONG) len, FALSE, FALSE, NULL);
+    if (mdl == NULL)
+    {
+        KeUnstackDetachProcess(apcstate);
+        return NULL;
+    }
+    
+    // Attempt to probe and lock the pages into memory
+    try 
+    {
+        MmProbeAndLockPages(mdl, UserMode, ReadAccess);
+    } except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        DbgPrint("Unable to ProbeAndLockPages! Error: %x\r\n", GetExceptionCode());
+        
+        IoFreeMdl(mdl);
+        mdl = NULL;
+    }
+    
+    KeUnstackDetachProcess(apcstate);
+    
+    
+    return mdl;
+}
+
+void pagingUnlockProcessMemory(PEPROCESS proc, PKAPC_STATE apcstate, PMDLX mdl)
+{
+    // Attach to process to ensure virtual addresses are correct
+    KeStackAttachProcess(proc, apcstate); 
+    
+    // Unlock & free MDL and corresponding pages
+    MmUnlockPages(mdl);
+    IoFreeMdl(mdl);
+    
+    KeUnstackDetachProcess(apcstate);
+}
+
+/**
+    Work item which tops up the reserve, runs at IRQL = 0
+*/
+static void pagingRefillWorker(PVOID param)
+{
+    PagingContext *context = (PagingContext *) param;
+    const uint32 tag = '4gaT';
+    uint8 *chunk = NULL;
+    uint32 i;
+    
+    // Requests made while this refill runs are kept for the next poll
+    InterlockedExchange(&context->RefillPending, 0);
+    if (context->NumReserveChunks < PAGING_MAX_REFILLS)
+    {
+        chunk = (uint8 *) ExAllocatePoolWithTag(NonPagedPool, 
+                                                PAGING_REFILL_PAGES * PAGE_SIZE, tag);
+    }
+    if (chunk != NULL)
+    {
+        context->ReserveChunks[context->NumReserveChunks] = chunk;
+        context->NumReserveChunks++;
+        for (i = 0; i < PAGING_REFILL_PAGES; i++)
+        {
+            InterlockedPushEntrySList(&context->Reserve, 
+                                      (PSLIST_ENTRY) (chunk + i * PAGE_SIZE));
+        }
+    }
+    
+    // Signal first, a new poll can only clear the event again once 
+    // RefillQueued is reset
+    KeSetEvent(&context->RefillIdle, 0, FALSE);
+    InterlockedExchange(&context->RefillQueued, 0);
+}
+
+void pagingServiceRefill(PagingContext *context)
+{
+    if (!context->RefillPending || InterlockedExchange(&context->RefillQueued, 1))
+        return;
+    KeClearEvent(&context->RefillIdle);
+    ExQueueWorkItem(&context->RefillWork, DelayedWorkQueue);
+}
+
+/**
+    Returns whether ptr is a page of one of the refills
+*/
+static uint8 pagingInReserve(PagingContext *context, void *ptr)
+{
+    uint32 i;
+    
+    if (((uint32) ptr & (PAGE_SIZE - 1)) != 0)
+        return 0;
+    for (i = 0; i < context->NumReserveChunks; i++)
+    {
+        if ((uint8 *) ptr >= context->ReserveChunks[i] && 
+                (uint8 *) ptr < context->ReserveChunks[i] + PAGING_REFILL_PAGES * PAGE_SIZE)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+    Returns the number of pages which can still be handed out
+*/
+static uint32 pagingFreePages(PagingContext *context)
+{
+    return context->NumPages + context->NumReserveChunks * PAGING_REFILL_PAGES - 
+                                                    (uint32) context->PagesInUse;
+}
+
+void pagingInitMappingOperations(PagingContext *context, uint32 numPages)
+{
+    uint32 i, cr3Val;
+    const uint32 tag = '4gaT';
+    PHYSICAL_ADDRESS phys = {0};
+    PageDirectoryEntrySmallPage *pde;
+    
+    __asm
+    {
+        PUSH EAX
+        MOV EAX, CR3
+        MOV cr3Val, EAX
+        POP EAX
+    }
+    context->CR3Val = cr3Val;
+    phys.LowPart = cr3Val & 0xFFFFF000;
+    
+    context->PageArray = (uint8 *) ExAllocatePoolWithTag(NonPagedPool, 
+                                                    numPages * PAGE_SIZE, tag);
+    context->NumPages = numPages;
+    context->NumWords = (numPages + 31) / 32;
+    context->PageArrayBitmap = (volatile LONG *) ExAllocatePoolWithTag(NonPagedPool, 
+                                                    context->NumWords * sizeof(LONG), tag);
+    if (context->PageArray == NULL || context->PageArrayBitmap == NULL)
+    {
+        context->NumPages = 0;
+        context->NumWords = 0;
+    }
+    else
+    {
+        RtlZeroMemory((void *) context->PageArrayBitmap, context->NumWords * sizeof(LONG));
+        // Mark the bits past the end of the pool as taken so they are never handed out
+        for (i = numPages; i < context->NumWords * 32; i++)
+        {
+            context->PageArrayBitmap[i / 32] |= (LONG) ((uint32) 1 << (i % 32));
+        }
+    }
+    context->Hint = 0;
+    context->PagesInUse = 0;
+    context->HighWaterMark = 0;
+    context->AllocFailures = 0;
+    
+    // Set up the reserve which is topped up at IRQL = 0 when the pool runs low
+    InitializeSListHead(&context->Reserve);
+    context->NumReserveChunks = 0;
+    context->RefillPending = 0;
+    context->RefillQueued = 0;
+    context->ReserveAllocs = 0;
+    pagingResetDemand(context);
+    KeInitializeEvent(&context->RefillIdle, NotificationEvent, TRUE);
+    ExInitializeWorkItem(&context->RefillWork, pagingRefillWorker, context);
+    
+    // Reserve the window, its PTEs are reached through the self-map so they can
+    // be rewritten from any context
+    context->Window = (uint8 *) MmAllocateMappingAddress(PAGING_WINDOW_PAGES * PAGE_SIZE, tag);
+    context->WindowPtes = (context->Window == NULL) ? NULL :
+                            (uint8 *) (PAGING_PTE_BASE + ((uint32) context->Window >> 12) * 
+                                (PagingPae ? sizeof(uint64) : sizeof(PageTableEntry)));
+    RtlZeroMemory((void *) context->WindowBitmap, sizeof(context->WindowBitmap));
+}
+
+void pagingEndMappingOperations(PagingContext *context)
+{
+    const uint32 tag = '4gaT';
+    PHYSICAL_ADDRESS phys = {0};
+    PageDirectoryEntrySmallPage *pde;
+    uint32 i;
+    
+    // Wait for a queued refill to finish
+    KeWaitForSingleObject(&context->RefillIdle, Executive, KernelMode, FALSE, NULL);
+    for (i = 0; i < context->NumReserveChunks; i++)
+    {
+        ExFreePoolWithTag(context->ReserveChunks[i], tag);
+    }
+    context->NumReserveChunks = 0;
+    InitializeSListHead(&context->Reserve);
+
+    if (context->PageArray != NULL)
+        ExFreePoolWithTag(context->PageArray, tag);
+    context->NumPages = 0;
+    context->NumWords = 0;
+    if (context->PageArrayBitmap != NULL)
+        ExFreePoolWithTag((void *) context->PageArrayBitmap, tag);
+    
+    if (context->Window != NULL)
+    {
+        MmFreeMappingAddress(context->Window, tag);
+        context->Window = NULL;
+        context->WindowPtes = NULL;
+    }
+}
+
+/**
+    Invalidates the TLB entry of a single page in the current context
+*/
+static void pagingInvalidatePage(void *ptr)
+{
+    __asm
+    {
+        PUSH EAX
+        MOV EAX, ptr
+        INVLPG [EAX]
+        POP EAX
+    }
+}
+
+/**
+    Points a window slot at a frame, or clears it if frame is 0
+*/
+static void pagingSetWindowPte(PagingContext *context, uint32 slot, uint64 frame)
+{
+    volatile uint32 *pte;
+    
+    if (!PagingPae)
+    {
+        pte = (volatile uint32 *) context->WindowPtes + slot;
+        *pte = (frame == 0) ? 0 : ((uint32) frame << 12) | 0x3;
+    }
+    else
+    {
+        // 8 byte PTE, the present bit is set last and cleared first
+        pte = (volatile uint32 *) context->WindowPtes + slot * 2;
+        if (frame == 0)
+        {
+            pte[0] = 0;
+            pte[1] = 0;
+        }
+        else
+        {
+            pte[1] = (uint32) (frame >> 20);
+            pte[0] = ((uint32) frame << 12) | 0x3;
+        }
+    }
+    pagingInvalidatePage(context->Window + slot * PAGE_SIZE);
+}
+
+/**
+    Claims count consecutive window slots
+    
+    @return First slot claimed, or ~0 if there is no free run long enough
+*/
+static uint32 pagingClaimSlots(PagingContext *context, uint32 count)
+{
+    uint32 i, j, busy;
+    
+    for (i = 0; i + count <= PAGING_WINDOW_PAGES; i++)
+    {
+        // Skip over full words
+        if (i % 32 == 0 && context->WindowBitmap[i / 32] == ~0)
+        {
+            i += 31;
+            continue;
+        }
+        // Slots are claimed atomically, the hypervisor may interrupt the guest here
+        for (j = 0; j < count; j++)
+        {
+            if (InterlockedBitTestAndSet(&context->WindowBitmap[(i + j) / 32], (i + j) % 32))
+                break;
+        }
+        if (j == count)
+            return i;
+        
+        // Give back the partial run and continue after the busy slot
+        busy = j;
+        while (j > 0)
+        {
+            j--;
+            InterlockedBitTestAndReset(&context->WindowBitmap[(i + j) / 32], (i + j) % 32);
+        }
+        i += busy;
+    }
+    return ~0;
+}
+
+void * pagingMapInPhys(PagingContext *context, PHYSICAL_ADDRESS phys, uint32 size)
+{
+    uint32 i, slot, count = ((phys.LowPart & 0xFFF) + size + PAGE_SIZE - 1) / PAGE_SIZE;
+    
+    // Frames above 4 GiB can only be reached with PAE
+    if (context == NULL || context->WindowPtes == NULL || size == 0 || 
+            (phys.HighPart != 0 && !PagingPae))
+        return NULL;
+    
+    slot = pagingClaimSlots(context, count);
+    if (slot == ~0)
+        return NULL;
+    
+    for (i = 0; i < count; i++)
+    {
+        pagingSetWindowPte(context, slot + i, (uint64) (phys.QuadPart >> 12) + i);
+    }
+    return context->Window + slot * PAGE_SIZE + (phys.LowPart & 0xFFF);
+}
+
+void pagingMapOutPhys(PagingContext *context, void *ptr, uint32 size)
+{
+    uint32 i, offset, slot, count;
+    
+    if (context == NULL || ptr == NULL || (uint8 *) ptr < context->Window)
+        return;
+    offset = (uint8 *) ptr - context->Window;
+    slot = offset / PAGE_SIZE;
+    count = ((offset & 0xFFF) + size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (slot + count > PAGING_WINDOW_PAGES)
+        return;
+    
+    for (i = slot; i < slot + count; i++)
+    {
+        pagingSetWindowPte(context, i, 0);
+        InterlockedBitTestAndReset(&context->WindowBitmap[i / 32], i % 32);
+    }
+}
+
+void pagingResetDemand(PagingContext *context)
+{
+    context->DemandBase = (uint32) context->PagesInUse;
+    context->PeakDemand = 0;
+}
+
+/**
+    Updates the statistics after a page was handed out and requests a refill
+    if the pool is running low
+*/
+static void pagingAccountAlloc(PagingContext *context)
+{
+    uint32 inUse = (uint32) InterlockedIncrement(&context->PagesInUse);
+    
+    if (inUse > context->HighWaterMark)
+        context->HighWaterMark = inUse;
+    if (inUse > context->DemandBase && inUse - context->DemandBase > context->PeakDemand)
+        context->PeakDemand = inUse - context->DemandBase;
+    if (pagingFreePages(context) < PAGING_LOW_WATERMARK)
+        InterlockedExchange(&context->RefillPending, 1);
+}
+
+void * pagingAllocPage(PagingContext *context)
+{
+    uint32 i, word;
+    ULONG bit;
+    PSLIST_ENTRY entry;
+    
+    for (i = 0; i < context->NumWords; i++)
+    {
+        word = (context->Hint + i) % context->NumWords;
+        // The hypervisor may take the same bit in the meantime, so keep looking
+        // in this word until the claim succeeds or the word is full
+        while (BitScanForward(&bit, ~((ULONG) context->PageArrayBitmap[word])))
+        {
+            if (!InterlockedBitTestAndSet(&context->PageArrayBitmap[word], bit))
+            {
+                context->Hint = word;
+                pagingAccountAlloc(context);
+                return context->PageArray + ((word * 32 + bit) * PAGE_SIZE);
+            }
+        }
+    }
+    
+    // Fall back on the pages added by refills
+    entry = InterlockedPopEntrySList(&context->Reserve);
+    if (entry != NULL)
+    {
+        context->ReserveAllocs++;
+        pagingAccountAlloc(context);
+        return (void *) entry;
+    }
+    
+    // No memory left, ask for more so a retry can succeed
+    InterlockedIncrement(&context->AllocFailures);
+    InterlockedExchange(&context->RefillPending, 1);
+    return NULL;
+}
+
+void pagingFreePage(PagingContext *context, void * ptr)
+{
+    uint32 i;
+    
+    if (ptr == NULL)
+        return;
+    if ((uint8 *) ptr < context->PageArray || 
+            (uint8 *) ptr >= context->PageArray + context->NumPages * PAGE_SIZE)
+    {
+        // Came from the reserve, anything else is not ours to hand out
+        if (!pagingInReserve(context, ptr))
+            return;
+        InterlockedPushEntrySList(&context->Reserve, (PSLIST_ENTRY) ptr);
+        InterlockedDecrement(&context->PagesInUse);
+        return;
+    }
+    i = ((uint8 *) ptr - context->PageArray) / PAGE_SIZE;
+    
+    // Mark that page as free, and look there first next time
+    if (InterlockedBitTestAndReset(&context->PageArrayBitmap[i / 32], i % 32))
+    {
+        InterlockedDecrement(&context->PagesInUse);
+        context->Hint = i / 32;
+    }
+}
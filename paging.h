@@ -1,246 +1,345 @@
-/**
-	@file
-	Windows driver to manipulate the page tables (header file)
-		
-	@date 1/30/2012
-***************************************************************/
-
-#ifndef _MORE_PAGING_H_
-#define _MORE_PAGING_H_
-
-#include "../stdint.h"
-#include "ntddk.h"
-
-#define PAGE_SIZE__LARGE 0x400000
-#define PAGE_SIZE__SMALL 0x1000
-
-#pragma pack(push, hook, 1)
-
-/**
-    Structure defining the page directory entry
-    from Intel Manual 3A - 4.3
-*/
-struct PageDirectoryEntry_s
-{
-    uint32 p :1; // Present
-    uint32 rw :1; // Read/Write
-    uint32 us :1; // User/Superuser
-    uint32 pwt :1; // Page write through
-    uint32 pcd :1; // Page level cache disable
-    uint32 a :1; // Accessed
-    uint32 d :1; // Dirty
-    uint32 ps :1; // Large page
-    uint32 g :1; // Global
-    uint32 reserved1 :3; // Must be 0
-    uint32 pat :1;	// PAT must be 0
-    uint32 reserved2 :9; // Must be 0
-    uint32 address :10;	// Address of page.
-};
-
-typedef struct PageDirectoryEntry_s PageDirectoryEntry;
-
-/**
-    Structure defining the page directory entry
-    from Intel Manual 3A - 4.3 (for small pages)
-*/
-struct PageDirectoryEntrySmallPage_s
-{
-    uint32 p :1; // Present
-    uint32 rw :1; // Read/Write
-    uint32 us :1; // User/Superuser
-    uint32 pwt :1; // Page write through
-    uint32 pcd :1; // Page level cache disable
-    uint32 a :1; // Accessed
-    uint32 ignored :1; // Ignored
-    uint32 ps :1; // Page Size
-    uint32 reserved1 :4; // Must be 0
-    uint32 address :20;	// Address of page.
-};
-
-typedef struct PageDirectoryEntrySmallPage_s PageDirectoryEntrySmallPage;
-
-/**
-    Structure defining the page table entry
-    from Intel Manual 3A
-*/
-struct PageTableEntry_s
-{
-    uint32 p :1; // Present
-    uint32 rw :1; // Read/Write
-    uint32 us :1; // User/Superuser
-    uint32 pwt :1; // Page write through
-    uint32 pcd :1; // Page level cache disable
-    uint32 a :1; // Accessed
-    uint32 d :1; // Dirty
-    uint32 pat :1; // PAT must be 0
-    uint32 g :1; // G must be 0
-    uint32 reserved1 :3; // Must be 0
-    uint32 address :20;	// Address of page.
-};
-
-typedef struct PageTableEntry_s PageTableEntry;
-
-#pragma pack(pop, hook)
-
-/**
-    Structure storing the needed information to complete a piecemeal walk of the
-    page-tables
-*/
-struct PageWalkContext_s
-{
-    PHYSICAL_ADDRESS targetAddress;
-    PageDirectoryEntry *pde;
-    uint32 pdeOff;
-    PageTableEntry *pte;
-    uint32 pteOff;
-};
-
-typedef struct PageWalkContext_s PageWalkContext;
-
-struct PagingContext_s
-{
-    PageTableEntry *PageTable;
-    uint32 VirtualPrefix;
-    uint8 *PageArray;
-    uint32 NumPages;
-    uint8 *PageArrayBitmap;
-    uint32 CR3Val;
-};
-
-typedef struct PagingContext_s PagingContext;
-
-/**
-    Maps a PTE/PDE out of memory
-    
-    @param ptr Virtual address of PDE/PTE
-*/
-void pagingMapOutEntry(void *ptr);
-
-/**
-    Maps a PTE/PDE out of memory, using the custom MM
-    
-    @param ptr Virtual address of PDE/PTE
-    @param context Pointer to paging context
-*/
-void pagingMapOutEntryDirql(void *ptr, PagingContext * context);
-
-/**
-    Function to map the PTE for a given CR3:Virtual address into memory
-    
-    @param CR3 CR3 value
-    @param virtualAddress Virtual address of the memory
-    
-    @return Pointer to mapped in PTE, or NULL is PS = 1
-*/
-PageTableEntry * pagingMapInPte(uint32 CR3, void *virtualAddress);
-
-/**
-    Function to map the PTE for a given CR3:Virtual address into memory (DIRQL)
-    
-    @param CR3 CR3 value
-    @param virtualAddress Virtual address of the memory
-    @param context Pointer to paging context
-    @return Pointer to mapped in PTE, or NULL is PS = 1
-*/
-PageTableEntry * pagingMapInPteDirql(uint32 CR3, void *virtualAddress, PagingContext * context);
-
-/**
-    Function to map the PDE for a given CR3:Virtual address into memory
-    
-    @param CR3 CR3 value
-    @param virtualAddress Virtual address of the memory
-    
-    @return Pointer to mapped in PDE
-*/
-PageDirectoryEntry * pagingMapInPde(uint32 CR3, void *virtualAddress);
-
-/**
-    Function to map the PDE for a given CR3:Virtual address into memory
-    
-    @param CR3 CR3 value
-    @param virtualAddress Virtual address of the memory
-    
-    @return Pointer to mapped in PDE
-*/
-PageDirectoryEntry * pagingMapInPdeDirql(uint32 CR3, void *virtualAddress, PagingContext * context);
-
-/**
-    Function which allocates a page table walk to find all virtual
-    addresses which reference a given physical memory address
-    
-    @param physicalAddress Target physical address
-    @return A pointer to the page walk context for future calls to pagingGetNext
-*/
-PageWalkContext * pagingInitWalk(PHYSICAL_ADDRESS physicalAddress);
-
-/**
-    Function to return the next virtual address that points to the physical
-    address of interest
-    
-    @param context Pointer to PageWalkContext generated by pagingInitWalk
-    @return NULL if no more references are found, otherwise a virtual address
-*/
-uint32 pagingGetNext(PageWalkContext *context);
-
-/**
-    Function to deallocate a PageWalkContext
-    
-    @param context Pointer to PageWalkContext to free
-*/
-void pagingFreeWalk(PageWalkContext *context);
-
-/** 
-    Function to 'lock' a process' memory into physical memory and prevent paging
-    
-    @param startAddr Starting virtual address to lock
-    @param len Number of bytes to lock
-    @param proc PEPROCESS pointer to the process
-    @param apcstate Pointer to an APC state memory location
-    @return MDL to be used later to unlock the memory or NULL if lock failed
-*/
-PMDLX pagingLockProcessMemory(PVOID startAddr, uint32 len, PEPROCESS proc, PKAPC_STATE apcstate);
-
-/** 
-    Function to 'lock' a process' memory into physical memory and prevent paging
-    
-    @param proc PEPROCESS pointer to the process
-    @param apcstate Pointer to an APC state memory location
-    @param mdl Pointer to previously locked process MDL
-*/
-void pagingUnlockProcessMemory(PEPROCESS proc, PKAPC_STATE apcstate, PMDLX mdl);
-
-/**
-    Initializes the page-fault-free memory operations
-    
-    @note Must be called at IRQL = 0
-    
-    @param context Pointer to the paging context to initialize
-    @param numPages Number of pages to reserve to hand out later
-*/
-void pagingInitMappingOperations(PagingContext *context, uint32 numPages);
-
-/**
-    Frees the pre-allocated buffer and ends all mapping operations
-    
-    @param context Pointer to the paging context to free
-*/
-void pagingEndMappingOperations(PagingContext *context);
-
-/**
-    Allocates a page of non-paged memory
-    
-    @param context Pointer to paging context
-    @return Pointer to the allocated page, or NULL if no pages are left
-*/
-void * pagingAllocPage(PagingContext *context);
-
-/** 
-    Frees allocated page
-    
-    @param context Pointer to paging context
-    @param ptr Pointer to page to be freed
-*/
-void pagingFreePage(PagingContext *context, void * ptr);
-
-#endif // _MORE_PAGING_H_
-
+/**
+	@file
+	Windows driver to manipulate the page tables (header file)
+		
+	@date 1/30/2012
+***************************************************************/
+
+#ifndef _MORE_PAGING_H_
+#define _MORE_PAGING_H_
+
+#include "../stdint.h"
+#include "ntddk.h"
+#include "gmem.h"
+#include "rmap.h"
+
+#define PAGE_SIZE__LARGE 0x400000
+#define PAGE_SIZE__SMALL 0x1000
+
+/** Virtual address the page tables are self-mapped at (32-bit and PAE) */
+#define PAGING_PTE_BASE 0xC0000000
+/** Number of pages in the DIRQL mapping window */
+#define PAGING_WINDOW_PAGES 64
+/** Number of words in the mapping window slot bitmap */
+#define PAGING_WINDOW_WORDS (PAGING_WINDOW_PAGES / 32)
+/** A refill is requested once fewer pages than this are free */
+#define PAGING_LOW_WATERMARK 64
+/** Number of pages added to the reserve by one refill */
+#define PAGING_REFILL_PAGES 128
+/** Maximum number of refills over the lifetime of a context */
+#define PAGING_MAX_REFILLS 32
+
+#pragma pack(push, hook, 1)
+
+/**
+    Structure defining the page directory entry
+    from Intel Manual 3A - 4.3
+*/
+struct PageDirectoryEntry_s
+{
+    uint32 p :1; // Present
+    uint32 rw :1; // Read/Write
+    uint32 us :1; // User/Superuser
+    uint32 pwt :1; // Page write through
+    uint32 pcd :1; // Page level cache disable
+    uint32 a :1; // Accessed
+    uint32 d :1; // Dirty
+    uint32 ps :1; // Large page
+    uint32 g :1; // Global
+    uint32 reserved1 :3; // Must be 0
+    uint32 pat :1;	// PAT must be 0
+    uint32 reserved2 :9; // Must be 0
+    uint32 address :10;	// Address of page.
+};
+
+typedef struct PageDirectoryEntry_s PageDirectoryEntry;
+
+/**
+    Structure defining the page directory entry
+    from Intel Manual 3A - 4.3 (for small pages)
+*/
+struct PageDirectoryEntrySmallPage_s
+{
+    uint32 p :1; // Present
+    uint32 rw :1; // Read/Write
+    uint32 us :1; // User/Superuser
+    uint32 pwt :1; // Page write through
+    uint32 pcd :1; // Page level cache disable
+    uint32 a :1; // Accessed
+    uint32 ignored :1; // Ignored
+    uint32 ps :1; // Page Size
+    uint32 reserved1 :4; // Must be 0
+    uint32 address :20;	// Address of page.
+};
+
+typedef struct PageDirectoryEntrySmallPage_s PageDirectoryEntrySmallPage;
+
+/**
+    Structure defining the page table entry
+    from Intel Manual 3A
+*/
+struct PageTableEntry_s
+{
+    uint32 p :1; // Present
+    uint32 rw :1; // Read/Write
+    uint32 us :1; // User/Superuser
+    uint32 pwt :1; // Page write through
+    uint32 pcd :1; // Page level cache disable
+    uint32 a :1; // Accessed
+    uint32 d :1; // Dirty
+    uint32 pat :1; // PAT must be 0
+    uint32 g :1; // G must be 0
+    uint32 reserved1 :3; // Must be 0
+    uint32 address :20;	// Address of page.
+};
+
+typedef struct PageTableEntry_s PageTableEntry;
+
+#pragma pack(pop, hook)
+
+struct PagingContext_s
+{
+    PageTableEntry *PageTable;
+    uint32 VirtualPrefix;
+    uint8 *PageArray;
+    uint32 NumPages;
+    volatile LONG *PageArrayBitmap; /**< One bit per page, set while the page is taken */
+    uint32 NumWords; /**< Number of words in PageArrayBitmap */
+    uint32 Hint; /**< Word the next allocation starts searching at */
+    volatile LONG PagesInUse; /**< Pages currently handed out */
+    uint32 HighWaterMark; /**< Most pages ever handed out at once */
+    volatile LONG AllocFailures; /**< Allocations which found no free page */
+    SLIST_HEADER Reserve; /**< Free pages added by refills */
+    uint8 *ReserveChunks[PAGING_MAX_REFILLS]; /**< Allocations backing the reserve */
+    uint32 NumReserveChunks; /**< Number of refills done */
+    volatile LONG RefillPending; /**< Set by the allocator once the pool runs low */
+    volatile LONG RefillQueued; /**< Set while the refill work item is queued */
+    WORK_QUEUE_ITEM RefillWork;
+    KEVENT RefillIdle; /**< Signalled while no refill work item is queued */
+    uint32 DemandBase; /**< PagesInUse when demand accounting was last reset */
+    uint32 PeakDemand; /**< Most pages in use above DemandBase */
+    uint32 ReserveAllocs; /**< Allocations served from the reserve */
+    uint32 CR3Val;
+    uint8 *Window; /**< Reserved VA range which physical pages are mapped into */
+    uint8 *WindowPtes; /**< PTEs backing the window (4 or 8 bytes each), rewritten directly */
+    volatile LONG WindowBitmap[PAGING_WINDOW_WORDS]; /**< Window slots in use */
+};
+
+typedef struct PagingContext_s PagingContext;
+
+/** Set by the loader if the guest uses PAE paging (CR4.PAE) */
+extern uint8 PagingPae;
+
+/**
+    Maps a PTE/PDE out of memory
+    
+    @param ptr Virtual address of PDE/PTE
+*/
+void pagingMapOutEntry(void *ptr);
+
+/**
+    Maps a PTE/PDE out of memory, using the custom MM
+    
+    @param ptr Virtual address of PDE/PTE
+    @param context Pointer to paging context
+*/
+void pagingMapOutEntryDirql(void *ptr, PagingContext * context);
+
+/**
+    Function to map the PTE for a given CR3:Virtual address into memory
+    
+    @param CR3 CR3 value
+    @param virtualAddress Virtual address of the memory
+    
+    @return Pointer to mapped in PTE, or NULL is PS = 1 or the guest uses PAE
+*/
+PageTableEntry * pagingMapInPte(uint32 CR3, void *virtualAddress);
+
+/**
+    Function to map the PTE for a given CR3:Virtual address into memory (DIRQL)
+    
+    @param CR3 CR3 value
+    @param virtualAddress Virtual address of the memory
+    @param context Pointer to paging context
+    @return Pointer to mapped in PTE, or NULL is PS = 1 or the guest uses PAE
+*/
+PageTableEntry * pagingMapInPteDirql(uint32 CR3, void *virtualAddress, PagingContext * context);
+
+/**
+    Function to map the PDE for a given CR3:Virtual address into memory
+    
+    @param CR3 CR3 value
+    @param virtualAddress Virtual address of the memory
+    
+    @return Pointer to mapped in PDE
+*/
+PageDirectoryEntry * pagingMapInPde(uint32 CR3, void *virtualAddress);
+
+/**
+    Translates a range of virtual pages of an address space in one pass
+    
+    @note Each page table is mapped once for all of the pages it covers. Pages
+    of a large page get the frame inside it, pages which are not present get
+    a frame of 0. Works with both 32-bit and PAE paging.
+    @param CR3 CR3 value of the address space
+    @param virtualAddress First virtual address to translate
+    @param numPages Number of pages to translate
+    @param outPfns Receives the frame number of each page
+    @param outPtes Receives a copy of the PTE of each page (zero for large
+    pages and with PAE), may be NULL
+    @param context Pointer to paging context to map with, or NULL
+    @return Number of pages which are present
+*/
+uint32 pagingTranslateRange(uint32 CR3, void *virtualAddress, uint32 numPages,
+                            uint32 *outPfns, PageTableEntry *outPtes, PagingContext *context);
+
+/**
+    Finds the next page whose frame differs between two arrays of frames, 
+    such as a snapshot and the output of a later pagingTranslateRange
+    
+    @note A scalar loop, unrolled to test four frames per branch. It uses no
+    SIMD registers, so it is safe in VMX root where the guest's are live.
+    @param seen Frames of the snapshot
+    @param pfns Current frames
+    @param start Index of the first page to compare
+    @param numPages Index after the last page to compare
+    @return Index of the first changed page at or after start, or numPages
+*/
+uint32 pagingNextChangedFrame(const uint32 *seen, const uint32 *pfns, uint32 start, 
+                              uint32 numPages);
+
+/**
+    Function to map the PDE for a given CR3:Virtual address into memory
+    
+    @param CR3 CR3 value
+    @param virtualAddress Virtual address of the memory
+    
+    @return Pointer to mapped in PDE
+*/
+PageDirectoryEntry * pagingMapInPdeDirql(uint32 CR3, void *virtualAddress, PagingContext * context);
+
+/**
+    Sets up an accessor for the memory of a guest address space which maps
+    the guest frames it needs itself, without going through the guest OS
+    
+    @note Safe at any IRQL and in VMX root if context is not NULL, pass the
+    guest's CR3 (GUEST_CR3 in VMX root). Release it with gmemRelease.
+    @param gm Pointer to the accessor
+    @param CR3 CR3 value of the address space
+    @param context Pointer to paging context whose window frames are mapped
+    through, or NULL
+*/
+void pagingInitGuestMemory(GuestMemory *gm, uint32 CR3, PagingContext *context);
+
+/**
+    Function which finds all virtual addresses which reference the frames in 
+    the map's range, with a single walk of the 32-bit or PAE page tables
+    
+    @note Safe at any IRQL and in VMX root if context is not NULL. The SIMD
+    compare kernel is only used at IRQL <= DISPATCH_LEVEL where the FPU state 
+    can be saved.
+    @param CR3 CR3 value of the address space to walk
+    @param map Pointer to a reverse map initialized with rmapInit
+    @param context Pointer to paging context to map the tables with, or NULL
+    @return Number of aliases found, look them up with rmapLookup(Batch)
+*/
+uint32 pagingBuildReverseMap(uint32 CR3, ReverseMap *map, PagingContext *context);
+
+/** 
+    Function to 'lock' a process' memory into physical memory and prevent paging
+    
+    @param startAddr Starting virtual address to lock
+    @param len Number of bytes to lock
+    @param proc PEPROCESS pointer to the process
+    @param apcstate Pointer to an APC state memory location
+    @return MDL to be used later to unlock the memory or NULL if lock failed
+*/
+PMDLX pagingLockProcessMemory(PVOID startAddr, uint32 len, PEPROCESS proc, PKAPC_STATE apcstate);
+
+/** 
+    Function to 'lock' a process' memory into physical memory and prevent paging
+    
+    @param proc PEPROCESS pointer to the process
+    @param apcstate Pointer to an APC state memory location
+    @param mdl Pointer to previously locked process MDL
+*/
+void pagingUnlockProcessMemory(PEPROCESS proc, PKAPC_STATE apcstate, PMDLX mdl);
+
+/**
+    Initializes the page-fault-free memory operations
+    
+    @note Must be called at IRQL = 0
+    
+    @param context Pointer to the paging context to initialize
+    @param numPages Number of pages to reserve to hand out later
+*/
+void pagingInitMappingOperations(PagingContext *context, uint32 numPages);
+
+/**
+    Starts a new period of demand accounting, e.g. when a new target is set up
+    
+    @param context Pointer to the paging context
+*/
+void pagingResetDemand(PagingContext *context);
+
+/**
+    Queues the refill work item if the allocator requested a refill
+    
+    @note Must be called in the guest at IRQL <= DISPATCH_LEVEL, the allocator
+    only sets a flag as it may run at DIRQL or in VMX root. Call it after 
+    anything which may have allocated, e.g. a VMCALL or a process event.
+    @param context Pointer to the paging context
+*/
+void pagingServiceRefill(PagingContext *context);
+
+/**
+    Frees the pre-allocated buffer and ends all mapping operations
+    
+    @param context Pointer to the paging context to free
+*/
+void pagingEndMappingOperations(PagingContext *context);
+
+/**
+    Maps physical memory into the context's window without calling the memory 
+    manager, safe at any IRQL and in VMX root
+    
+    @param context Pointer to paging context
+    @param phys Physical address to map
+    @param size Number of bytes to map
+    @return Virtual address of phys, or NULL if the window is full
+*/
+void * pagingMapInPhys(PagingContext *context, PHYSICAL_ADDRESS phys, uint32 size);
+
+/**
+    Unmaps memory mapped with pagingMapInPhys
+    
+    @param context Pointer to paging context
+    @param ptr Virtual address returned by pagingMapInPhys
+    @param size Number of bytes mapped
+*/
+void pagingMapOutPhys(PagingContext *context, void *ptr, uint32 size);
+
+/**
+    Allocates a page of non-paged memory
+    
+    @note Safe at any IRQL and in VMX root, the search starts at the word of the
+    last allocation or free and skips full words. Once the pool falls below 
+    PAGING_LOW_WATERMARK free pages a refill is requested, which 
+    pagingServiceRefill queues from the guest. Pages from refills are used 
+    once the pool is empty
+    @param context Pointer to paging context
+    @return Pointer to the allocated page, or NULL if no pages are left
+*/
+void * pagingAllocPage(PagingContext *context);
+
+/** 
+    Frees allocated page
+    
+    @param context Pointer to paging context
+    @param ptr Pointer to page to be freed, pointers which are neither in the
+               pool nor in a refill are ignored
+*/
+void pagingFreePage(PagingContext *context, void * ptr);
+
+#endif // _MORE_PAGING_H_
+
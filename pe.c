@@ -1,293 +1,420 @@
-/**
-	@file
-	Library to parse & measure PE files
-		
-	@date 11/14/2011
-***************************************************************/
-#include "ntifs.h"
-#include "Wdm.h"
-#include "ntddk.h"
-#include "stdint.h"
-#include "pe.h"
-#include "paging.h"
-#include "vmx/procmon.h"
-
-uint32 peGetNumberOfRelocs(uint8 *peBaseAddr, void *realBase, PEPROCESS proc, PKAPC_STATE apc)
-{
-    ImageDosHeader *dosHeader = NULL;
-    ImageNtHeaders *ntHeaders = NULL;
-    ImageSectionHeader *sectionHeader = NULL;
-    ImageBaseRelocation *relocationPtr = NULL, *bkupRPtr = NULL;
-    uint32 numRelocs = 0;
-    PageTableEntry *pte = NULL;
-    PHYSICAL_ADDRESS phys = {0};
-    
-    uint16 i, j = 0, execSectionCount = 0, numSections = 0;
-    
-    dosHeader = (ImageDosHeader *) peBaseAddr;
-    ntHeaders = (ImageNtHeaders *) ((uint8 *) peBaseAddr + dosHeader->e_lfanew);
-    numSections = ntHeaders->FileHeader.NumberOfSections;
-    sectionHeader = (ImageSectionHeader *) &ntHeaders[1];
-    
-    for (i = 0; i < numSections; i++)
-    {
-        if(strncmp(sectionHeader[i].Name, ".reloc", 8) == 0)
-            break;
-    }
-    if(strncmp(sectionHeader[i].Name, ".reloc", 8) != 0)
-            return 0;
-    /*DbgPrint("Found %.08s RVA: %x Characteristics: %x", sectionHeader[i].Name, 
-                                                        sectionHeader[i].VirtualAddress,
-                                                        sectionHeader[i].Characteristics);*/
-
-    //KeStackAttachProcess(proc, apc);
-    pte = pagingMapInPte(targetCR3, (uint8 *) (((uint32) realBase) +
-                                sectionHeader[i].VirtualAddress));
-    if (pte == NULL)
-        return 0;
-    phys.LowPart = pte->address << 12;
-    pagingMapOutEntry(pte);
-
-    relocationPtr = (ImageBaseRelocation *) MmMapIoSpace(phys,
-            PAGE_SIZE,
-            0);
-    bkupRPtr = relocationPtr;        
-    /*DbgPrint("%p + %x = %x", realBase, sectionHeader[i].VirtualAddress, (((uint32) realBase) +
-                                sectionHeader[i].VirtualAddress));*/
-    i = 0;
-    do
-    {       
-        //DbgPrint("RP: %x %x\r\n", relocationPtr->VirtualAddress, relocationPtr->SizeOfBlock); 
-        numRelocs += (relocationPtr->SizeOfBlock - sizeof(*relocationPtr)) / sizeof(uint16);
-        relocationPtr = (ImageBaseRelocation *) ((uint8 *) relocationPtr + relocationPtr->SizeOfBlock);
-        i++;
-    } while(relocationPtr->SizeOfBlock != 0);
-    MmUnmapIoSpace(bkupRPtr, PAGE_SIZE);
-    //KeUnstackDetachProcess(apc);
-   //DbgPrint("I %d\r\n", i);
-   
-    // Size of the table (minus the header) divided by the size of each entry
-    // FIXME Figure out why this is the case
-    return numRelocs - (i);
-}
-
-static uint32 peCalculateRelocDiff(uint8 *peBaseAddr, void *realBase)
-{
-    ImageDosHeader *dosHeader = NULL;
-    ImageNtHeaders *ntHeaders = NULL;
-    uint16 *ptr = (uint16 *) peBaseAddr;
-    uint32 imageBase = 0x01000000;
-    
-    dosHeader = (ImageDosHeader *) peBaseAddr;
-    ntHeaders = (ImageNtHeaders *) ((uint8 *) peBaseAddr + dosHeader->e_lfanew);
-    // Uncomment for a driver
-    //imageBase = ntHeaders->OptionalHeader.ImageBase;
-    
-    if(((uint32) realBase) > imageBase)
-        return ((uint32) realBase) - imageBase;
-    return imageBase - ((uint32) realBase);
-}
-
-uint32 peGetImageSize(uint8 *peBaseAddr)
-{
-    ImageDosHeader *dosHeader = NULL;
-    ImageNtHeaders *ntHeaders = NULL;
-    uint16 *ptr = (uint16 *) peBaseAddr;
-    
-    dosHeader = (ImageDosHeader *) peBaseAddr;
-    ntHeaders = (ImageNtHeaders *) ((uint8 *) peBaseAddr + dosHeader->e_lfanew);
-
-    return ntHeaders->OptionalHeader.SizeOfImage;
-}
-
-uint8 * peMapInImageHeader(PHYSICAL_ADDRESS physAddr)
-{
-    uint8 *pePtr = NULL;
-    uint32 imageSize = 0;
-
-    pePtr = MmMapIoSpace(physAddr, PAGE_SIZE, 0);
-    if (pePtr == NULL || *pePtr != 'M' || *(pePtr + 1) != 'Z')
-    {
-        DbgPrint("Invalid physical address!");
-        if (pePtr != NULL)
-            MmUnmapIoSpace(pePtr, PAGE_SIZE);
-        return NULL;
-    }
-    
-    return pePtr;
-}
-
-void peMapOutImageHeader(uint8 *peBaseAddr)
-{
-    MmUnmapIoSpace(peBaseAddr, PAGE_SIZE);
-}
-
-uint16 peGetNumExecSections(uint8 *peBaseAddr)
-{
-    ImageDosHeader *dosHeader = NULL;
-    ImageNtHeaders *ntHeaders = NULL;
-    ImageSectionHeader *sectionHeader = NULL;
-    
-    uint16 i, execSectionCount = 0, numSections = 0;
-    
-    dosHeader = (ImageDosHeader *) peBaseAddr;
-    ntHeaders = (ImageNtHeaders *) ((uint8 *) peBaseAddr + dosHeader->e_lfanew);
-    numSections = ntHeaders->FileHeader.NumberOfSections;
-
-    sectionHeader = (ImageSectionHeader *) (&ntHeaders[1]);
-    
-    for (i = 0; i < numSections; i++)
-    {
-        if (sectionHeader[i].Characteristics & IMAGE_SCN_MEM_EXECUTE &&
-            !(strcmp("INIT", sectionHeader[i].Name) == 0)) execSectionCount++;
-    }
-    
-    return execSectionCount;
-}
-
-void peGetExecSections(uint8 *peBaseAddr, SectionData *sections)
-{
-    ImageDosHeader *dosHeader = NULL;
-    ImageNtHeaders *ntHeaders = NULL;
-    ImageSectionHeader *sectionHeader = NULL;
-    
-    uint16 i, j = 0, execSectionCount = 0, numSections = 0;
-    
-    dosHeader = (ImageDosHeader *) peBaseAddr;
-    ntHeaders = (ImageNtHeaders *) ((uint8 *) peBaseAddr + dosHeader->e_lfanew);
-    numSections = ntHeaders->FileHeader.NumberOfSections;
-    sectionHeader = (ImageSectionHeader *) &ntHeaders[1];
-    
-    for (i = 0; i < numSections; i++)
-    {
-        if (sectionHeader[i].Characteristics & IMAGE_SCN_MEM_EXECUTE &&
-                            !(strcmp("INIT", sectionHeader[i].Name) == 0))
-        {
-            sections[j].VirtualAddress = sectionHeader[i].VirtualAddress;
-            sections[j].Size = sectionHeader[i].Misc.VirtualSize;
-            //DbgPrint("Section %.8s is executable", sectionHeader[i].Name);
-            j++;
-        }
-    }
-}
-
-void pePrintSections(uint8 *peBaseAddr)
-{
-    ImageDosHeader *dosHeader = NULL;
-    ImageNtHeaders *ntHeaders = NULL;
-    ImageSectionHeader *sectionHeader = NULL;
-    
-    uint16 i, j = 0, execSectionCount = 0, numSections = 0;
-    
-    dosHeader = (ImageDosHeader *) peBaseAddr;
-    ntHeaders = (ImageNtHeaders *) ((uint8 *) peBaseAddr + dosHeader->e_lfanew);
-    numSections = ntHeaders->FileHeader.NumberOfSections;
-    sectionHeader = (ImageSectionHeader *) &ntHeaders[1];
-    
-    for (i = 0; i < numSections; i++)
-    {
-        DbgPrint("Section %d: %.8s VA: %x Size %x", i + 1, sectionHeader[i].Name,
-                sectionHeader[i].VirtualAddress, sectionHeader[i].Misc.VirtualSize);
-    }
-}
-
-uint32 peChecksumExecSections(uint8 *peBaseAddr, 
-                              void *realBase, 
-                              PEPROCESS proc, 
-                              PKAPC_STATE apc, 
-                              PHYSICAL_ADDRESS *physArr)
-{
-    uint16 numExecSections = peGetNumExecSections(peBaseAddr);
-    uint32 checksum = 0, k, i, j, 
-                        numRelocs = peGetNumberOfRelocs(peBaseAddr, realBase, proc, apc), 
-                        relocDelta = peCalculateRelocDiff(peBaseAddr, realBase);
-    uint8 *dataPtr = NULL;
-    PHYSICAL_ADDRESS phys = {0};
-    SectionData *execSections = (SectionData *) MmAllocateNonCachedMemory(
-                                                numExecSections * sizeof(SectionData));
-    peGetExecSections(peBaseAddr, execSections);
-    
-    //DbgPrint("Found %d relocations, delta of: %x\r\n", numRelocs, relocDelta);
-    
-    for (i = 0; i < numExecSections; i++)
-    {   
-        uint32 numpages = execSections[i].Size / 0x1000, size = execSections[i].Size;
-        if (numpages * 0x1000 < execSections[i].Size)
-            numpages++;
-        for (k = 0; k < numpages; k++)
-        {
-            KeStackAttachProcess(proc, apc); 
-            dataPtr = (uint8 *) MmMapIoSpace(MmGetPhysicalAddress((void *)(((uint32) realBase) +
-                        execSections[i].VirtualAddress + (0x1000 * k))),
-                        0x1000, 0);
-            phys = MmGetPhysicalAddress((void *) dataPtr);
-
-            for (j = 0; j < min(size, 0x1000); j++)
-            {
-                checksum += dataPtr[j];
-            }
-            MmUnmapIoSpace((void *) dataPtr, 0x1000);
-            size -= 0x1000;
-            KeUnstackDetachProcess(apc);
-        }
-    }
-    
-    // Subtract the relocations from the checksum
-    // TODO Fix incase of lower load address
-    checksum += numRelocs * (relocDelta & 0x000000FF);
-    checksum += numRelocs * ((relocDelta & 0x0000FF00) >> 8);
-    checksum += numRelocs * ((relocDelta & 0x00FF0000) >> 16);
-    checksum += numRelocs * ((relocDelta & 0xFF000000) >> 24);
-    
-    
-    MmFreeNonCachedMemory((void *) execSections, numExecSections * sizeof(SectionData));
-    return checksum;
-}
-
-uint32 peChecksumBkupExecSections(uint8 *peBaseAddr, 
-                                  void *realBase, 
-                                  PEPROCESS proc, 
-                                  PKAPC_STATE apc, 
-                                  PHYSICAL_ADDRESS *physArr)
-{
-    uint16 numExecSections = peGetNumExecSections(peBaseAddr);
-    uint32 checksum = 0, k, i, j, 
-                        numRelocs = peGetNumberOfRelocs(peBaseAddr, realBase, proc, apc), 
-                        relocDelta = peCalculateRelocDiff(peBaseAddr, realBase);
-    uint8 *dataPtr = NULL;
-    PHYSICAL_ADDRESS phys = {0};
-    SectionData *execSections = (SectionData *) MmAllocateNonCachedMemory(
-                                                numExecSections * sizeof(SectionData));
-    peGetExecSections(peBaseAddr, execSections);
-    
-    //DbgPrint("Found %d relocations, delta of: %x\r\n", numRelocs, relocDelta);
-    
-    for (i = 0; i < numExecSections; i++)
-    {   
-        uint32 numpages = execSections[i].Size / 0x1000, size = execSections[i].Size;
-        if (numpages * 0x1000 < execSections[i].Size)
-            numpages++;
-        for (k = 0; k < numpages; k++)
-        {
-            dataPtr = (uint8 *) MmMapIoSpace(physArr[(execSections[i].VirtualAddress / PAGE_SIZE) + k],
-                        min(size, 0x1000), 0);
-            for (j = 0; j < min(size, 0x1000); j++)
-            {
-                checksum += dataPtr[j];
-            }
-            MmUnmapIoSpace((void *) dataPtr, min(size, 0x1000));
-            size -= 0x1000;
-        }
-    }
-    
-    // Subtract the relocations from the checksum
-    // TODO Fix incase of lower load address
-    checksum += numRelocs * (relocDelta & 0x000000FF);
-    checksum += numRelocs * ((relocDelta & 0x0000FF00) >> 8);
-    checksum += numRelocs * ((relocDelta & 0x00FF0000) >> 16);
-    checksum += numRelocs * ((relocDelta & 0xFF000000) >> 24);
-    
-    
-    MmFreeNonCachedMemory((void *) execSections, numExecSections * sizeof(SectionData));
-    return checksum;
-}
+/**
+	@file
+	Library to parse & measure PE files
+		
+	@date 11/14/2011
+***************************************************************/
+#include "ntifs.h"
+#include "Wdm.h"
+#include "ntddk.h"
+#include "stdint.h"
+#include "pe.h"
+#include "paging.h"
+#include "measure.h"
+#include "vmx/procmon.h"
+
+uint8 peBuildImageInfo(uint8 *peBaseAddr, void *realBase, uint32 CR3, PeImageInfo *info,
+                       PagingContext *context)
+{
+    ImageDosHeader *dosHeader = NULL;
+    ImageNtHeaders *ntHeaders = NULL;
+    ImageSectionHeader *sectionHeader = NULL;
+    uint32 imageBase = 0x01000000, numPages;
+    uint16 i, numSections = 0;
+    
+    if (peBaseAddr == NULL || info == NULL)
+        return 0;
+    
+    RtlZeroMemory(info, sizeof(PeImageInfo));
+    
+    dosHeader = (ImageDosHeader *) peBaseAddr;
+    ntHeaders = (ImageNtHeaders *) ((uint8 *) peBaseAddr + dosHeader->e_lfanew);
+    numSections = ntHeaders->FileHeader.NumberOfSections;
+    sectionHeader = (ImageSectionHeader *) &ntHeaders[1];
+    
+    if (numSections > PE_MAX_SECTIONS)
+    {
+        DbgPrint("Too many sections to describe: %d\r\n", numSections);
+        return 0;
+    }
+    
+    info->ImageBase = (uint32) realBase;
+    info->SizeOfImage = ntHeaders->OptionalHeader.SizeOfImage;
+    info->NumSections = numSections;
+    
+    for (i = 0; i < numSections; i++)
+    {
+        info->Sections[i].VirtualAddress = sectionHeader[i].VirtualAddress;
+        info->Sections[i].Size = sectionHeader[i].Misc.VirtualSize;
+        info->Sections[i].Characteristics = sectionHeader[i].Characteristics;
+        
+        if (info->RelocRva == 0 && strncmp(sectionHeader[i].Name, ".reloc", 8) == 0)
+            info->RelocRva = sectionHeader[i].VirtualAddress;
+        
+        if (sectionHeader[i].Characteristics & IMAGE_SCN_MEM_EXECUTE &&
+                            !(strncmp("INIT", sectionHeader[i].Name, 8) == 0))
+        {
+            if (info->NumExecSections == PE_MAX_EXEC_SECTIONS)
+            {
+                DbgPrint("Too many executable sections to describe\r\n");
+                return 0;
+            }
+            info->ExecSections[info->NumExecSections].VirtualAddress = 
+                                                    sectionHeader[i].VirtualAddress;
+            info->ExecSections[info->NumExecSections].Size = 
+                                                    sectionHeader[i].Misc.VirtualSize;
+            numPages = sectionHeader[i].Misc.VirtualSize / PAGE_SIZE;
+            if (numPages * PAGE_SIZE < sectionHeader[i].Misc.VirtualSize)
+                numPages++;
+            info->NumExecPages += numPages;
+            info->NumExecSections++;
+        }
+    }
+    
+    // Uncomment for a driver
+    //imageBase = ntHeaders->OptionalHeader.ImageBase;
+    if (((uint32) realBase) > imageBase)
+        info->RelocDelta = ((uint32) realBase) - imageBase;
+    else
+        info->RelocDelta = imageBase - ((uint32) realBase);
+    
+    if (info->RelocRva != 0)
+        info->NumRelocs = peGetNumberOfRelocs((void *) (info->ImageBase + info->RelocRva), 
+                                              CR3, context);
+    
+    // Precompute what the relocations add to the checksum
+    // TODO Fix incase of lower load address
+    info->RelocAdjust = info->NumRelocs * (info->RelocDelta & 0x000000FF);
+    info->RelocAdjust += info->NumRelocs * ((info->RelocDelta & 0x0000FF00) >> 8);
+    info->RelocAdjust += info->NumRelocs * ((info->RelocDelta & 0x00FF0000) >> 16);
+    info->RelocAdjust += info->NumRelocs * ((info->RelocDelta & 0xFF000000) >> 24);
+    
+    return 1;
+}
+
+uint32 peGetNumberOfRelocs(void *relocVirt, uint32 CR3, PagingContext *context)
+{
+    ImageBaseRelocation block = {0};
+    uint32 numRelocs = 0, i = 0, va = (uint32) relocVirt;
+    GuestMemory gm;
+    
+    // Read the block headers through the target's page tables, 32-bit or PAE
+    pagingInitGuestMemory(&gm, CR3, context);
+    while (gmemRead(&gm, va, (uint8 *) &block, sizeof(block)) == sizeof(block) &&
+                block.SizeOfBlock != 0)
+    {
+        //DbgPrint("RP: %x %x\r\n", block.VirtualAddress, block.SizeOfBlock); 
+        numRelocs += (block.SizeOfBlock - sizeof(block)) / sizeof(uint16);
+        va += block.SizeOfBlock;
+        i++;
+    }
+    gmemRelease(&gm);
+   
+    // Size of the table (minus the header) divided by the size of each entry
+    // FIXME Figure out why this is the case
+    return numRelocs - (i);
+}
+
+uint32 peGetImageSize(uint8 *peBaseAddr)
+{
+    ImageDosHeader *dosHeader = NULL;
+    ImageNtHeaders *ntHeaders = NULL;
+    uint16 *ptr = (uint16 *) peBaseAddr;
+    
+    dosHeader = (ImageDosHeader *) peBaseAddr;
+    ntHeaders = (ImageNtHeaders *) ((uint8 *) peBaseAddr + dosHeader->e_lfanew);
+
+    return ntHeaders->OptionalHeader.SizeOfImage;
+}
+
+uint32 peGetTimeDateStamp(uint8 *peBaseAddr)
+{
+    ImageDosHeader *dosHeader = (ImageDosHeader *) peBaseAddr;
+    ImageNtHeaders *ntHeaders = (ImageNtHeaders *) (peBaseAddr + dosHeader->e_lfanew);
+    
+    return ntHeaders->FileHeader.TimeDateStamp;
+}
+
+uint32 peGetRelocSection(uint8 *peBaseAddr, uint32 *size)
+{
+    ImageDosHeader *dosHeader = (ImageDosHeader *) peBaseAddr;
+    ImageNtHeaders *ntHeaders = (ImageNtHeaders *) (peBaseAddr + dosHeader->e_lfanew);
+    ImageSectionHeader *sectionHeader = (ImageSectionHeader *) &ntHeaders[1];
+    uint16 i;
+    
+    // The same section peBuildImageInfo takes the relocations from
+    for (i = 0; i < ntHeaders->FileHeader.NumberOfSections && i < PE_MAX_SECTIONS; i++)
+    {
+        if (strncmp(sectionHeader[i].Name, ".reloc", 8) == 0)
+        {
+            *size = sectionHeader[i].Misc.VirtualSize;
+            return sectionHeader[i].VirtualAddress;
+        }
+    }
+    *size = 0;
+    return 0;
+}
+
+uint8 peIsExecPage(PeImageInfo *info, uint32 rva)
+{
+    uint32 page = rva / PAGE_SIZE, first;
+    uint16 j;
+    
+    for (j = 0; j < info->NumExecSections; j++)
+    {
+        first = info->ExecSections[j].VirtualAddress / PAGE_SIZE;
+        if (page >= first && 
+                page < first + (info->ExecSections[j].Size + PAGE_SIZE - 1) / PAGE_SIZE)
+            return 1;
+    }
+    return 0;
+}
+
+uint8 * peMapInImageHeader(uint32 CR3, void *virt, PHYSICAL_ADDRESS *physAddr,
+                           PagingContext *context)
+{
+    const uint32 tag = '6gaT';
+    uint8 *pePtr = NULL;
+    uint64 phys = 0;
+    uint8 read = 0;
+    GuestMemory gm;
+    
+    pePtr = (uint8 *) ExAllocatePoolWithTag(NonPagedPool, PAGE_SIZE, tag);
+    if (pePtr == NULL)
+        return NULL;
+    
+    pagingInitGuestMemory(&gm, CR3, context);
+    if (gmemTranslate(&gm, (uint32) virt, &phys))
+        read = (gmemRead(&gm, (uint32) virt, pePtr, PAGE_SIZE) == PAGE_SIZE);
+    gmemRelease(&gm);
+    physAddr->QuadPart = (LONGLONG) phys;
+    if (!read || *pePtr != 'M' || *(pePtr + 1) != 'Z')
+    {
+        DbgPrint("Invalid image header!");
+        ExFreePoolWithTag(pePtr, tag);
+        return NULL;
+    }
+    
+    return pePtr;
+}
+
+void peMapOutImageHeader(uint8 *peBaseAddr)
+{
+    ExFreePoolWithTag(peBaseAddr, '6gaT');
+}
+
+void pePrintSections(PeImageInfo *info)
+{
+    uint16 i;
+    
+    for (i = 0; i < info->NumSections; i++)
+    {
+        DbgPrint("Section %d: VA: %x Size %x Characteristics %x", i + 1, 
+                info->Sections[i].VirtualAddress, info->Sections[i].Size,
+                info->Sections[i].Characteristics);
+    }
+}
+
+/**
+    Maps in a page of the image through the target's own page tables
+*/
+static uint8 * peMapGuestPage(void *context, uint32 offset)
+{
+    PeMeasureContext *ctx = (PeMeasureContext *) context;
+    PHYSICAL_ADDRESS phys = {0};
+    uint64 frame;
+    uint8 present;
+    GuestMemory gm;
+    
+    // Each worker walks the tables with its own accessor, a page which is not
+    // present is reported as unmapped instead of reading frame 0
+    pagingInitGuestMemory(&gm, ctx->CR3, ctx->Paging);
+    present = gmemTranslate(&gm, ctx->ImageBase + offset, &frame);
+    gmemRelease(&gm);
+    if (!present)
+        return NULL;
+    phys.QuadPart = (LONGLONG) (frame & ~((uint64) PAGE_SIZE - 1));
+    
+    if (ctx->Paging != NULL)
+        return (uint8 *) pagingMapInPhys(ctx->Paging, phys, PAGE_SIZE);
+    return (uint8 *) MmMapIoSpace(phys, PAGE_SIZE, 0);
+}
+
+/**
+    Maps in a page of the image from the saved physical addresses
+*/
+static uint8 * peMapPhysPage(void *context, uint32 offset)
+{
+    PeMeasureContext *ctx = (PeMeasureContext *) context;
+    
+    return (uint8 *) MmMapIoSpace(ctx->PhysArr[offset / PAGE_SIZE], PAGE_SIZE, 0);
+}
+
+static void peUnmapPage(void *context, uint8 *ptr)
+{
+    PeMeasureContext *ctx = (PeMeasureContext *) context;
+    
+    if (ctx->Paging != NULL)
+        pagingMapOutPhys(ctx->Paging, (void *) ptr, PAGE_SIZE);
+    else
+        MmUnmapIoSpace((void *) ptr, PAGE_SIZE);
+}
+
+/**
+    Maps in a page of the image through the paging context's window, from the 
+    saved physical addresses
+*/
+static uint8 * peMapWindowPage(void *context, uint32 offset)
+{
+    PeMeasureContext *ctx = (PeMeasureContext *) context;
+    
+    return (uint8 *) pagingMapInPhys(ctx->Paging, ctx->PhysArr[offset / PAGE_SIZE], PAGE_SIZE);
+}
+
+/**
+    Returns the persistent mapping of a page made by peMapExecPages
+*/
+static uint8 * peGetMappedPage(void *context, uint32 offset)
+{
+    PeMeasureContext *ctx = (PeMeasureContext *) context;
+    
+    return ctx->Mapped[offset / PAGE_SIZE];
+}
+
+uint8 peMapExecPages(PeImageInfo *info, PeMeasureContext *ctx)
+{
+    const uint32 tag = '6gaT';
+    uint32 i, page, numPages = info->SizeOfImage / PAGE_SIZE, size;
+    uint16 j;
+    
+    if (ctx->PhysArr == NULL)
+        return 0;
+    
+    size = numPages * sizeof(uint8 *);
+    ctx->Mapped = (uint8 **) ExAllocatePoolWithTag(NonPagedPool, size, tag);
+    if (ctx->Mapped == NULL)
+        return 0;
+    RtlZeroMemory(ctx->Mapped, size);
+    
+    for (j = 0; j < info->NumExecSections; j++)
+    {
+        page = info->ExecSections[j].VirtualAddress / PAGE_SIZE;
+        for (i = 0; i < (info->ExecSections[j].Size + PAGE_SIZE - 1) / PAGE_SIZE; i++)
+        {
+            if (page + i < numPages && ctx->Mapped[page + i] == NULL)
+            {
+                ctx->Mapped[page + i] = (uint8 *) MmMapIoSpace(ctx->PhysArr[page + i], 
+                                                               PAGE_SIZE, 0);
+            }
+        }
+    }
+    return 1;
+}
+
+void peUnmapExecPages(PeImageInfo *info, PeMeasureContext *ctx)
+{
+    const uint32 tag = '6gaT';
+    uint32 i;
+    
+    if (ctx->Mapped == NULL)
+        return;
+    for (i = 0; i < info->SizeOfImage / PAGE_SIZE; i++)
+    {
+        if (ctx->Mapped[i] != NULL)
+            MmUnmapIoSpace((void *) ctx->Mapped[i], PAGE_SIZE);
+    }
+    ExFreePoolWithTag(ctx->Mapped, tag);
+    ctx->Mapped = NULL;
+}
+
+void peInitMeasureJob(PeImageInfo *info, 
+                      MeasureJob *job, 
+                      PeMeasureContext *ctx)
+{
+    uint16 i;
+    
+    if (ctx->Mapped != NULL)
+    {
+        measureInitJob(job, peGetMappedPage, NULL, (void *) ctx);
+    }
+    else if (ctx->PhysArr == NULL)
+    {
+        measureInitJob(job, peMapGuestPage, peUnmapPage, (void *) ctx);
+    }
+    else
+    {
+        measureInitJob(job, (ctx->Paging != NULL) ? peMapWindowPage : peMapPhysPage, 
+                       peUnmapPage, (void *) ctx);
+    }
+    for (i = 0; i < info->NumExecSections; i++)
+    {
+        measureAddSpan(job, info->ExecSections[i].VirtualAddress, info->ExecSections[i].Size);
+    }
+}
+
+uint32 peChecksumExecSections(PeImageInfo *info, 
+                              uint32 CR3, 
+                              uint32 numWorkers,
+                              PagingContext *context)
+{
+    MeasureJob job;
+    PeMeasureContext ctx = {0};
+    
+    ctx.CR3 = CR3;
+    ctx.ImageBase = info->ImageBase;
+    ctx.Paging = context;
+    peInitMeasureJob(info, &job, &ctx);
+    
+    // Subtract the relocations from the checksum
+    return measureRun(&job, numWorkers) + info->RelocAdjust;
+}
+
+uint32 peChecksumBkupExecSections(PeImageInfo *info, 
+                                  PHYSICAL_ADDRESS *physArr,
+                                  uint32 numWorkers)
+{
+    MeasureJob job;
+    PeMeasureContext ctx = {0};
+    
+    ctx.ImageBase = info->ImageBase;
+    ctx.PhysArr = physArr;
+    peInitMeasureJob(info, &job, &ctx);
+    
+    // Subtract the relocations from the checksum
+    return measureRun(&job, numWorkers) + info->RelocAdjust;
+}
+
+uint32 peChecksumExecSectionsDirql(PeImageInfo *info, 
+                                   uint32 CR3, 
+                                   PagingContext *context)
+{
+    GuestMemory gm;
+    uint32 sum = 0;
+    uint16 i;
+    
+    // Walk the target's page tables directly, the tables stay mapped in the
+    // window for the whole measurement instead of once per page
+    pagingInitGuestMemory(&gm, CR3, context);
+    for (i = 0; i < info->NumExecSections; i++)
+    {
+        gmemHash(&gm, info->ImageBase + info->ExecSections[i].VirtualAddress, 
+                 info->ExecSections[i].Size, &sum);
+    }
+    gmemRelease(&gm);
+    return sum + info->RelocAdjust;
+}
+
+uint32 peChecksumBkupExecSectionsDirql(PeImageInfo *info, 
+                                       PHYSICAL_ADDRESS *physArr, 
+                                       PagingContext *context)
+{
+    MeasureJob job;
+    PeMeasureContext ctx = {0};
+    
+    ctx.ImageBase = info->ImageBase;
+    ctx.PhysArr = physArr;
+    ctx.Paging = context;
+    peInitMeasureJob(info, &job, &ctx);
+    
+    return measureRun(&job, 1) + info->RelocAdjust;
+}
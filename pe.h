@@ -1,300 +1,435 @@
-/**
-	@file
-	Defines PE format structures
-		
-	@date 11/10/2011
-***************************************************************/
-
-#ifndef _MORE_PE_H_
-#define _MORE_PE_H_
-
-#include "stdint.h"
-
-// Bitmask defines
-/** The section contains executable code */
-#define IMAGE_SCN_CNT_CODE 0x00000020
-/** The section contains initialized data */
-#define IMAGE_SCN_CNT_INITIALIZED_DATA 0x00000040
-/** The section contains un-initialized data */
-#define IMAGE_SCN_CNT_UNINITIALIZED_DATA 0x00000080
-/** The section is executable */
-#define IMAGE_SCN_MEM_EXECUTE 0x20000000
-/** The section is readable */
-#define IMAGE_SCN_MEM_READ 0x40000000
-/** The section is writable */
-#define IMAGE_SCN_MEM_WRITE 0x80000000
-
-/** Defines a high-low relocation type */
-#define IMAGE_REL_BASED_HIGHLOW 3
-/** Defines an absolute relocation type (unused by PE loader) */
-#define IMAGE_REL_BASED_ABSOLUTE 0
-
-#pragma pack(push, pe, 1)
-
-/**
-    Structure representing the DOS stub of a PE
-    
-    @note Known in MS docs as IMAGE_DOS_HEADER
-*/
-struct ImageDosHeader_s
-{
-    uint16 e_magic;
-    uint16 e_cblp;
-    uint16 e_cp;
-    uint16 e_crlc;
-    uint16 e_cparhdr;
-    uint16 e_minalloc;
-    uint16 e_maxalloc;
-    uint16 e_ss;
-    uint16 e_sp;
-    uint16 e_csum;
-    uint16 e_ip;
-    uint16 e_cs;
-    uint16 e_lfarlc;
-    uint16 e_ovno;
-    uint16 e_res[4];
-    uint16 e_oemid;
-    uint16 e_oeminfo;
-    uint16 e_res2[10];
-    uint32 e_lfanew;
-};
-
-typedef struct ImageDosHeader_s ImageDosHeader;
-
-/**
-    Structure representing a PE file header
-    
-    @note Known as IMAGE_FILE_HEADER in MS docs
-*/
-struct ImageFileHeader_s
-{
-    uint16 Machine;
-    uint16 NumberOfSections;
-    uint32 TimeDateStamp;
-    uint32 PointerToSymbolTable;
-    uint32 NumberOfSymbols;
-    uint16 SizeOfOptionalHeader;
-    uint16 Characteristics;
-};
-
-typedef struct ImageFileHeader_s ImageFileHeader;
-
-/**
-    Structure representing a PE data directory
-    
-    @note Known as IMAGE_DATA_DIRECTORY in MS docs
-*/
-struct ImageDataDirectory_s
-{
-    uint32 VirtualAddress;
-    uint32 Size;
-};
-
-typedef struct ImageDataDirectory_s ImageDataDirectory;
-
-/**
-    Structure representing a PE optional header
-    
-    @note Known as IMAGE_OPTIONAL_HEADER in MS docs
-    @note DataDirectory can have more or less entries than 16
-*/
-struct ImageOptionalHeader_s
-{
-    uint16 Magic;
-    uint8 MajorLinkerVersion;
-    uint8 MinorLinkerVersion;
-    uint32 SizeOfCode;
-    uint32 SizeOfInitializedData;
-    uint32 SizeOfUninitializedData;
-    uint32 AddressOfEntryPoint;
-    uint32 BaseOfCode;
-    uint32 BaseOfData;
-    uint32 ImageBase;
-    uint32 SectionAlignment;
-    uint32 FileAlignment;
-    uint16 MajorOperatingSystemVersion;
-    uint16 MinorOperatingSystemVersion;
-    uint16 MajorImageVersion;
-    uint16 MinorImageVersion;
-    uint16 MajorSubsystemVersion;
-    uint16 MinorSubsystemVersion;
-    uint32 Win32VersionValue;
-    uint32 SizeOfImage;
-    uint32 SizeOfHeaders;
-    uint32 CheckSum;
-    uint16 Subsystem;
-    uint16 DllCharacteristics;
-    uint32 SizeOfStackReserve;
-    uint32 SizeOfStackCommit;
-    uint32 SizeOfHeapReserve;
-    uint32 SizeOfHeapCommit;
-    uint32 LoaderFlags;
-    uint32 NumberOfRvaAndSizes;
-    ImageDataDirectory DataDirectory[16];
-};
-
-typedef struct ImageOptionalHeader_s ImageOptionalHeader;
-
-/**
-    Structure representing a PE NT header
-    
-    @note Known as IMAGE_NT_HEADERS in MS docs
-*/
-struct ImageNtHeaders_s
-{
-    uint32 Signature;
-    ImageFileHeader FileHeader;
-    ImageOptionalHeader OptionalHeader;
-};
-
-typedef struct ImageNtHeaders_s ImageNtHeaders;
-
-/**
-    Struct representing the PE relocation header
-    
-    @note Known as IMAGE_BASE_RELOCATION in MS docs
-*/
-struct ImageBaseRelocation_s
-{
-    uint32 VirtualAddress;
-    uint32 SizeOfBlock;
-};
-
-typedef struct ImageBaseRelocation_s ImageBaseRelocation;
-
-/**
-    Structure for a PE relocation
-*/
-struct PeRelocation_s
-{
-    uint16 RelocationOffset :12;
-    uint16 RelocationType :4;
-};
-
-typedef struct PeRelocation_s PeRelocation;
-
-/**
-    Structure representing a PE section header
-    
-    @note Known as IMAGE_SECTION_HEADER in MS docs
-*/
-struct ImageSectionHeader_s
-{
-    uint8 Name[8];
-    union
-    {
-        uint32 PhysicalAddress;
-        uint32 VirtualSize;
-    } Misc;
-    uint32 VirtualAddress;
-    uint32 SizeOfRawData;
-    uint32 PointerToRawData;
-    uint32 PointerToRelocations;
-    uint32 PointerToLinenumbers;
-    uint16 NumberOfRelocations;
-    uint16 NumberOfLinenumbers;
-    uint32 Characteristics; /**< Bitmask of section characteristics */
-};
-
-typedef struct ImageSectionHeader_s ImageSectionHeader;
-
-// Reuse ImageDataDirectory structure for section data
-typedef ImageDataDirectory SectionData;
-
-#pragma pack(pop, pe)
-
-/**
-    Returns the number of relocations in the section
-    
-    @param headerPtr Pointer to the relocation table header
-    @param realBase The virtual address the PE is loaded into
-    @param proc Pointer to the EPROCESS for the target process
-    @param apc Pointer to an APC state storage location
-    @return Number of relocations in the table
-*/
-uint32 peGetNumberOfRelocs(uint8 *peBaseAddr, void *realBase, PEPROCESS proc, PKAPC_STATE apc);
-
-/**
-    Calculates the 'delta' between the linked and loaded address for 
-    relocations
-    
-    @param peBaseAddr Pointer to mapped in PE structure
-    @param realBase The virtual address the PE is loaded into
-    @return Difference between the linked and loaded executable
-*/
-static uint32 peCalculateRelocDiff(uint8 *peBaseAddr, void *realBase);
-
-/**
-    Returns the number of bytes in the PE image
-    
-    @param peBaseAddr Pointer to the base image address
-    @return Number of bytes in PE image
-*/
-uint32 peGetImageSize(uint8 *peBaseAddr);
-
-/**
-    Maps a PE header into memory from a physical address
-    
-    @note Ensure memory is mapped out with peMapOutImage
-    @param physAddr Physical address of PE base
-    @return Pointer to mapped in PE image header
-*/
-uint8 * peMapInImageHeader(PHYSICAL_ADDRESS physAddr);
-
-/**
-    Unmaps a PE image from virtual memory
-    
-    @param peBaseAddr Pointer to the base image address
-*/
-void peMapOutImageHeader(uint8 *peBaseAddr);
-
-/**
-    Prints the sections found in a PE
-    
-    @param peBaseAddr Pointer to the base image address
-*/
-void pePrintSections(uint8 *peBaseAddr);
-
-/**
-    Returns the number of executable sections in the PE image
-    
-    @param peBaseAddr Pointer to the base image address
-    @return Number of sections marked as executable
-*/
-uint16 peGetNumExecSections(uint8 *peBaseAddr);
-
-/**
-    Populates the passed SectionData array with pointers and sizes to each 
-    executable section of the PE
-    
-    @note The sections array must be allocated by caller using the number
-    returned by peGetNumExecSections
-    @param peBaseAddr Pointer to the base image address
-    @param sections Pointer to array memory location to store the section data
-*/
-void peGetExecSections(uint8 *peBaseAddr, SectionData *sections);
-
-/**
-    Returns a simple checksum of all the executable sections of the passed PE
-    
-    @param peBaseAddr Pointer to the base image address
-    @param realBase The real base address mapped in by the loader
-    @param proc Pointer to the EPROCESS for the PE
-    @param apc Pointer to an APC state storage location
-    @return Simple checksum of the executable sections of the PE
-*/
-uint32 peChecksumExecSections(uint8 *peBaseAddr, void *realBase, PEPROCESS proc, PKAPC_STATE apc, PHYSICAL_ADDRESS *physArr);
-
-/**
-    Returns a simple checksum of all the executable sections of the passed PE using a different physical mapping
-    
-    @param peBaseAddr Pointer to the base image address
-    @param realBase The real base address mapped in by the loader
-    @param proc Pointer to the EPROCESS for the PE
-    @param apc Pointer to an APC state storage location
-    @param physArr Array of physical addresses to use instead of what is in the paging structures
-    @return Simple checksum of the executable sections of the PE
-*/
-uint32 peChecksumBkupExecSections(uint8 *peBaseAddr, void *realBase, PEPROCESS proc, PKAPC_STATE apc, PHYSICAL_ADDRESS *physArr);
-
-#endif  // _MORE_PE_H
+/**
+	@file
+	Defines PE format structures
+		
+	@date 11/10/2011
+***************************************************************/
+
+#ifndef _MORE_PE_H_
+#define _MORE_PE_H_
+
+#include "stdint.h"
+#include "measure.h"
+#include "paging.h"
+
+// Bitmask defines
+/** The section contains executable code */
+#define IMAGE_SCN_CNT_CODE 0x00000020
+/** The section contains initialized data */
+#define IMAGE_SCN_CNT_INITIALIZED_DATA 0x00000040
+/** The section contains un-initialized data */
+#define IMAGE_SCN_CNT_UNINITIALIZED_DATA 0x00000080
+/** The section is executable */
+#define IMAGE_SCN_MEM_EXECUTE 0x20000000
+/** The section is readable */
+#define IMAGE_SCN_MEM_READ 0x40000000
+/** The section is writable */
+#define IMAGE_SCN_MEM_WRITE 0x80000000
+
+/** Defines a high-low relocation type */
+#define IMAGE_REL_BASED_HIGHLOW 3
+/** Defines an absolute relocation type (unused by PE loader) */
+#define IMAGE_REL_BASED_ABSOLUTE 0
+
+#pragma pack(push, pe, 1)
+
+/**
+    Structure representing the DOS stub of a PE
+    
+    @note Known in MS docs as IMAGE_DOS_HEADER
+*/
+struct ImageDosHeader_s
+{
+    uint16 e_magic;
+    uint16 e_cblp;
+    uint16 e_cp;
+    uint16 e_crlc;
+    uint16 e_cparhdr;
+    uint16 e_minalloc;
+    uint16 e_maxalloc;
+    uint16 e_ss;
+    uint16 e_sp;
+    uint16 e_csum;
+    uint16 e_ip;
+    uint16 e_cs;
+    uint16 e_lfarlc;
+    uint16 e_ovno;
+    uint16 e_res[4];
+    uint16 e_oemid;
+    uint16 e_oeminfo;
+    uint16 e_res2[10];
+    uint32 e_lfanew;
+};
+
+typedef struct ImageDosHeader_s ImageDosHeader;
+
+/**
+    Structure representing a PE file header
+    
+    @note Known as IMAGE_FILE_HEADER in MS docs
+*/
+struct ImageFileHeader_s
+{
+    uint16 Machine;
+    uint16 NumberOfSections;
+    uint32 TimeDateStamp;
+    uint32 PointerToSymbolTable;
+    uint32 NumberOfSymbols;
+    uint16 SizeOfOptionalHeader;
+    uint16 Characteristics;
+};
+
+typedef struct ImageFileHeader_s ImageFileHeader;
+
+/**
+    Structure representing a PE data directory
+    
+    @note Known as IMAGE_DATA_DIRECTORY in MS docs
+*/
+struct ImageDataDirectory_s
+{
+    uint32 VirtualAddress;
+    uint32 Size;
+};
+
+typedef struct ImageDataDirectory_s ImageDataDirectory;
+
+/**
+    Structure representing a PE optional header
+    
+    @note Known as IMAGE_OPTIONAL_HEADER in MS docs
+    @note DataDirectory can have more or less entries than 16
+*/
+struct ImageOptionalHeader_s
+{
+    uint16 Magic;
+    uint8 MajorLinkerVersion;
+    uint8 MinorLinkerVersion;
+    uint32 SizeOfCode;
+    uint32 SizeOfInitializedData;
+    uint32 SizeOfUninitializedData;
+    uint32 AddressOfEntryPoint;
+    uint32 BaseOfCode;
+    uint32 BaseOfData;
+    uint32 ImageBase;
+    uint32 SectionAlignment;
+    uint32 FileAlignment;
+    uint16 MajorOperatingSystemVersion;
+    uint16 MinorOperatingSystemVersion;
+    uint16 MajorImageVersion;
+    uint16 MinorImageVersion;
+    uint16 MajorSubsystemVersion;
+    uint16 MinorSubsystemVersion;
+    uint32 Win32VersionValue;
+    uint32 SizeOfImage;
+    uint32 SizeOfHeaders;
+    uint32 CheckSum;
+    uint16 Subsystem;
+    uint16 DllCharacteristics;
+    uint32 SizeOfStackReserve;
+    uint32 SizeOfStackCommit;
+    uint32 SizeOfHeapReserve;
+    uint32 SizeOfHeapCommit;
+    uint32 LoaderFlags;
+    uint32 NumberOfRvaAndSizes;
+    ImageDataDirectory DataDirectory[16];
+};
+
+typedef struct ImageOptionalHeader_s ImageOptionalHeader;
+
+/**
+    Structure representing a PE NT header
+    
+    @note Known as IMAGE_NT_HEADERS in MS docs
+*/
+struct ImageNtHeaders_s
+{
+    uint32 Signature;
+    ImageFileHeader FileHeader;
+    ImageOptionalHeader OptionalHeader;
+};
+
+typedef struct ImageNtHeaders_s ImageNtHeaders;
+
+/**
+    Struct representing the PE relocation header
+    
+    @note Known as IMAGE_BASE_RELOCATION in MS docs
+*/
+struct ImageBaseRelocation_s
+{
+    uint32 VirtualAddress;
+    uint32 SizeOfBlock;
+};
+
+typedef struct ImageBaseRelocation_s ImageBaseRelocation;
+
+/**
+    Structure for a PE relocation
+*/
+struct PeRelocation_s
+{
+    uint16 RelocationOffset :12;
+    uint16 RelocationType :4;
+};
+
+typedef struct PeRelocation_s PeRelocation;
+
+/**
+    Structure representing a PE section header
+    
+    @note Known as IMAGE_SECTION_HEADER in MS docs
+*/
+struct ImageSectionHeader_s
+{
+    uint8 Name[8];
+    union
+    {
+        uint32 PhysicalAddress;
+        uint32 VirtualSize;
+    } Misc;
+    uint32 VirtualAddress;
+    uint32 SizeOfRawData;
+    uint32 PointerToRawData;
+    uint32 PointerToRelocations;
+    uint32 PointerToLinenumbers;
+    uint16 NumberOfRelocations;
+    uint16 NumberOfLinenumbers;
+    uint32 Characteristics; /**< Bitmask of section characteristics */
+};
+
+typedef struct ImageSectionHeader_s ImageSectionHeader;
+
+// Reuse ImageDataDirectory structure for section data
+typedef ImageDataDirectory SectionData;
+
+#pragma pack(pop, pe)
+
+/** Maximum number of section headers a PeImageInfo descriptor can describe */
+#define PE_MAX_SECTIONS 32
+/** Maximum number of executable sections a PeImageInfo descriptor can describe */
+#define PE_MAX_EXEC_SECTIONS 16
+
+/**
+    Structure describing a single section of a loaded PE image
+*/
+struct PeSectionInfo_s
+{
+    uint32 VirtualAddress; /**< RVA of the section */
+    uint32 Size; /**< Virtual size of the section in bytes */
+    uint32 Characteristics; /**< Bitmask of section characteristics */
+};
+
+typedef struct PeSectionInfo_s PeSectionInfo;
+
+/**
+    Parsed descriptor of a loaded PE image
+    
+    Built once per target with peBuildImageInfo so the measurement routines
+    don't have to re-walk the DOS, NT and section headers (or allocate) on 
+    every call
+*/
+struct PeImageInfo_s
+{
+    uint32 ImageBase; /**< Virtual address the loader mapped the image at */
+    uint32 SizeOfImage; /**< Number of bytes in the loaded image */
+    uint16 NumSections; /**< Number of valid entries in Sections */
+    uint16 NumExecSections; /**< Number of valid entries in ExecSections */
+    PeSectionInfo Sections[PE_MAX_SECTIONS]; /**< All section ranges */
+    SectionData ExecSections[PE_MAX_EXEC_SECTIONS]; /**< Executable spans (RVA and size) */
+    uint32 NumExecPages; /**< Total number of pages covered by ExecSections */
+    uint32 RelocRva; /**< RVA of the .reloc section, 0 if there is none */
+    uint32 NumRelocs; /**< Number of relocations applied by the loader */
+    uint32 RelocDelta; /**< Difference between the linked and loaded address */
+    uint32 RelocAdjust; /**< Checksum adjustment accounting for the relocations */
+};
+
+typedef struct PeImageInfo_s PeImageInfo;
+
+/**
+    Context handed to the measurement engine's page callbacks
+*/
+struct PeMeasureContext_s
+{
+    uint32 CR3; /**< CR3 of the process to resolve virtual addresses in */
+    uint32 ImageBase; /**< Virtual address the image is loaded at */
+    PHYSICAL_ADDRESS *PhysArr; /**< Per-page physical addresses, or NULL */
+    uint8 **Mapped; /**< Per-page persistent mappings made by peMapExecPages, or NULL */
+    PagingContext *Paging; /**< Context whose window PhysArr pages are mapped through, or NULL */
+};
+
+typedef struct PeMeasureContext_s PeMeasureContext;
+
+/**
+    Parses the headers of a loaded PE image into a PeImageInfo descriptor
+    
+    @note Must be called at IRQL = 0, the relocation table is mapped in through
+    the target's page tables
+    @param peBaseAddr Pointer to the mapped in PE header
+    @param realBase The virtual address the PE is loaded into
+    @param CR3 CR3 value of the process the PE is loaded into
+    @param info Pointer to the descriptor to fill in
+    @param context Pointer to the paging context the tables are mapped through
+    @return 1 if the descriptor was built, 0 if the headers could not be described
+*/
+uint8 peBuildImageInfo(uint8 *peBaseAddr, void *realBase, uint32 CR3, PeImageInfo *info,
+                       PagingContext *context);
+
+/**
+    Returns the number of relocations in the section
+    
+    @param relocVirt Virtual address of the relocation table
+    @param CR3 CR3 value of the process the PE is loaded into
+    @param context Pointer to the paging context the tables are mapped through
+    @return Number of relocations in the table
+*/
+uint32 peGetNumberOfRelocs(void *relocVirt, uint32 CR3, PagingContext *context);
+
+/**
+    Returns the number of bytes in the PE image
+    
+    @param peBaseAddr Pointer to the base image address
+    @return Number of bytes in PE image
+*/
+uint32 peGetImageSize(uint8 *peBaseAddr);
+
+/**
+    Returns the link time stamp of the PE image
+    
+    @param peBaseAddr Pointer to the base image address
+    @return TimeDateStamp of the file header
+*/
+uint32 peGetTimeDateStamp(uint8 *peBaseAddr);
+
+/**
+    Finds the .reloc section of the PE image
+    
+    @param peBaseAddr Pointer to the base image address
+    @param size Receives the virtual size of the section in bytes
+    @return RVA of the section, or 0 if the image has none
+*/
+uint32 peGetRelocSection(uint8 *peBaseAddr, uint32 *size);
+
+/**
+    Returns whether a page of the image belongs to an executable section
+    
+    @param info Parsed image descriptor
+    @param rva RVA of the page
+    @return 1 if the page is covered by ExecSections, 0 otherwise
+*/
+uint8 peIsExecPage(PeImageInfo *info, uint32 rva);
+
+/**
+    Reads the header page of a loaded PE through its process's page tables
+    
+    @note Must be called at IRQL = 0, release it with peMapOutImageHeader
+    @param CR3 CR3 value of the process the PE is loaded into
+    @param virt Virtual address the PE is loaded at
+    @param physAddr Receives the physical address of the header
+    @param context Pointer to the paging context the tables are mapped through
+    @return Pointer to a copy of the PE image header, or NULL if it is not 
+            present or not a PE
+*/
+uint8 * peMapInImageHeader(uint32 CR3, void *virt, PHYSICAL_ADDRESS *physAddr,
+                           PagingContext *context);
+
+/**
+    Releases a PE header returned by peMapInImageHeader
+    
+    @param peBaseAddr Pointer to the base image address
+*/
+void peMapOutImageHeader(uint8 *peBaseAddr);
+
+/**
+    Prints the sections found in a PE
+    
+    @param info Pointer to the parsed image descriptor
+*/
+void pePrintSections(PeImageInfo *info);
+
+/**
+    Fills in a measurement job covering the executable sections of the image
+    
+    @note If ctx->Mapped is set the persistent mappings are used, which makes
+    the job safe to run from VMX root. Otherwise pages are mapped from 
+    ctx->PhysArr, or resolved by walking ctx->CR3's page tables with a guest 
+    memory accessor if it is NULL. If ctx->Paging is set the tables and pages 
+    are mapped through its window, which is safe at any IRQL, else through 
+    MmMapIoSpace at IRQL = 0. ctx must outlive the job.
+    @param info Pointer to the parsed image descriptor
+    @param job Pointer to the job to fill in
+    @param ctx Pointer to the context used to map the pages
+*/
+void peInitMeasureJob(PeImageInfo *info, MeasureJob *job, PeMeasureContext *ctx);
+
+/**
+    Maps in every executable page of the image from ctx->PhysArr for as long as 
+    the target lives, so that it can be measured without calling the kernel
+    
+    @note Must be called at IRQL <= DISPATCH_LEVEL, pages which fail to map are 
+    left NULL and reported as unmapped by the measurement
+    @param info Pointer to the parsed image descriptor
+    @param ctx Pointer to the context to store the mappings in
+    @return 1 if the mapping table was allocated, 0 otherwise
+*/
+uint8 peMapExecPages(PeImageInfo *info, PeMeasureContext *ctx);
+
+/**
+    Releases the mappings made by peMapExecPages
+    
+    @param info Pointer to the parsed image descriptor
+    @param ctx Pointer to the context holding the mappings
+*/
+void peUnmapExecPages(PeImageInfo *info, PeMeasureContext *ctx);
+
+/**
+    Returns a simple checksum of all the executable sections of the passed PE
+    
+    @note The sections are split into chunks which are hashed on up to numWorkers
+    system worker threads, the result does not depend on the number of workers
+    @param info Pointer to the parsed image descriptor
+    @param CR3 CR3 value of the process the PE is loaded into
+    @param numWorkers Number of threads to measure with, 1 to measure on the calling thread
+    @param context Pointer to the paging context to map pages with
+    @return Simple checksum of the executable sections of the PE
+*/
+uint32 peChecksumExecSections(PeImageInfo *info, uint32 CR3, uint32 numWorkers,
+                              PagingContext *context);
+
+/**
+    Returns a simple checksum of all the executable sections of the passed PE using a different physical mapping
+    
+    @param info Pointer to the parsed image descriptor
+    @param physArr Array of physical addresses to use instead of what is in the paging structures
+    @param numWorkers Number of threads to measure with, 1 to measure on the calling thread
+    @return Simple checksum of the executable sections of the PE
+*/
+uint32 peChecksumBkupExecSections(PeImageInfo *info, PHYSICAL_ADDRESS *physArr, uint32 numWorkers);
+
+/**
+    Returns a simple checksum of all the executable sections of the passed PE,
+    safe at any IRQL
+    
+    @note The target's page tables are walked by a guest memory accessor which
+    maps through the context's window, pages which are not present are skipped
+    @param info Pointer to the parsed image descriptor
+    @param CR3 CR3 value of the process the PE is loaded into
+    @param context Pointer to the paging context to map pages with
+    @return Simple checksum of the executable sections of the PE
+*/
+uint32 peChecksumExecSectionsDirql(PeImageInfo *info, uint32 CR3, PagingContext *context);
+
+/**
+    Returns a simple checksum of all the executable sections of the passed PE 
+    using a different physical mapping, safe at any IRQL
+    
+    @param info Pointer to the parsed image descriptor
+    @param physArr Array of physical addresses to use instead of what is in the paging structures
+    @param context Pointer to the paging context to map pages with
+    @return Simple checksum of the executable sections of the PE
+*/
+uint32 peChecksumBkupExecSectionsDirql(PeImageInfo *info, 
+                                       PHYSICAL_ADDRESS *physArr, 
+                                       PagingContext *context);
+
+#endif  // _MORE_PE_H
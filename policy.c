@@ -0,0 +1,155 @@
+/**
+	@file
+	Target policy table
+    
+    Builds in the driver or, with MORE_PTHREADS defined, as a user-space
+    library: gcc -DMORE_PTHREADS -c policy.c
+    
+	@date 10/19/2026
+***************************************************************/
+#ifdef MORE_PTHREADS
+#include <string.h>
+#else
+#include "ntddk.h"
+#endif
+#include "stdint.h"
+#include "policy.h"
+
+/** Characters of an image name which count, EPROCESS.ImageFileName keeps 
+    15 bytes including the NUL */
+#define POLICY_NAME_MAX (POLICY_NAME_LEN - 2)
+
+/**
+    Reads a little endian 32-bit value
+*/
+static uint32 policyRead32(const uint8 *ptr)
+{
+    return (uint32) ptr[0] | ((uint32) ptr[1] << 8) | ((uint32) ptr[2] << 16) |
+           ((uint32) ptr[3] << 24);
+}
+
+/**
+    Copies at most POLICY_NAME_MAX characters of a name in lower case and
+    returns their FNV-1a hash
+*/
+static uint32 policyNormalize(const char *name, uint32 max, char *out)
+{
+    uint32 i, hash = 2166136261u;
+    char c;
+    
+    for (i = 0; i < max && i < POLICY_NAME_MAX && name[i] != '\0'; i++)
+    {
+        c = name[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        out[i] = c;
+        hash = (hash ^ (uint8) c) * 16777619u;
+    }
+    for (; i < POLICY_NAME_LEN; i++)
+    {
+        out[i] = '\0';
+    }
+    return hash;
+}
+
+/**
+    Returns the number of slots for numEntries entries, a power of two at
+    least twice numEntries so probe sequences stay short
+*/
+static uint32 policyNumSlots(uint32 numEntries)
+{
+    uint32 slots = 16;
+    
+    while (slots < 2 * numEntries)
+    {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+uint32 policyBlobEntries(const uint8 *blob, uint32 len)
+{
+    uint32 count;
+    
+    if (blob == NULL || len < sizeof(PolicyBlobHeader) ||
+            policyRead32(blob) != POLICY_MAGIC ||
+            policyRead32(blob + 4) != POLICY_VERSION)
+        return 0;
+    count = policyRead32(blob + 8);
+    if (count == 0 || count > POLICY_MAX_ENTRIES ||
+            count > (len - sizeof(PolicyBlobHeader)) / sizeof(PolicyBlobEntry))
+        return 0;
+    return count;
+}
+
+uint32 policyStorageSize(uint32 numEntries)
+{
+    return numEntries * sizeof(PolicyEntry) + policyNumSlots(numEntries) * sizeof(uint16);
+}
+
+uint8 policyLoad(PolicyTable *table, const uint8 *blob, uint32 len,
+                 void *storage, uint32 storageSize)
+{
+    uint32 count = policyBlobEntries(blob, len), i, slot, numSlots;
+    const uint8 *record;
+    PolicyEntry *entry;
+    uint8 *base;
+    
+    memset(table, 0, sizeof(PolicyTable));
+    if (count == 0 || storage == NULL || storageSize < policyStorageSize(count))
+        return 0;
+    
+    base = (uint8 *) storage;
+    numSlots = policyNumSlots(count);
+    table->Entries = (PolicyEntry *) base;
+    table->Slots = (uint16 *) (base + count * sizeof(PolicyEntry));
+    table->SlotMask = numSlots - 1;
+    memset(table->Slots, 0, numSlots * sizeof(uint16));
+    
+    record = blob + sizeof(PolicyBlobHeader);
+    for (i = 0; i < count; i++, record += sizeof(PolicyBlobEntry))
+    {
+        entry = &table->Entries[table->NumEntries];
+        entry->Hash = policyNormalize((const char *) record, POLICY_NAME_LEN, entry->Name);
+        entry->Digest = policyRead32(record + POLICY_NAME_LEN);
+        entry->Options = policyRead32(record + POLICY_NAME_LEN + 4);
+        if (entry->Name[0] == '\0')
+            continue;
+    
+        // Linear probing, the first entry of a name wins
+        for (slot = entry->Hash & table->SlotMask; table->Slots[slot] != 0;
+                slot = (slot + 1) & table->SlotMask)
+        {
+            if (table->Entries[table->Slots[slot] - 1].Hash == entry->Hash &&
+                    strcmp(table->Entries[table->Slots[slot] - 1].Name, entry->Name) == 0)
+                break;
+        }
+        if (table->Slots[slot] != 0)
+        {
+            table->Duplicates++;
+            continue;
+        }
+        table->Slots[slot] = (uint16) (table->NumEntries + 1);
+        table->NumEntries++;
+    }
+    return 1;
+}
+
+const PolicyEntry * policyLookup(const PolicyTable *table, const char *name)
+{
+    char normalized[POLICY_NAME_LEN];
+    uint32 hash, slot;
+    const PolicyEntry *entry;
+    
+    if (table->Slots == NULL || name == NULL)
+        return NULL;
+    hash = policyNormalize(name, POLICY_NAME_MAX, normalized);
+    for (slot = hash & table->SlotMask; table->Slots[slot] != 0;
+            slot = (slot + 1) & table->SlotMask)
+    {
+        entry = &table->Entries[table->Slots[slot] - 1];
+        if (entry->Hash == hash && strcmp(entry->Name, normalized) == 0)
+            return entry;
+    }
+    return NULL;
+}
@@ -0,0 +1,125 @@
+/**
+	@file
+	Target policy table (header file)
+    
+    Holds the images to split, loaded at runtime from a binary blob, with an
+    open addressed hash table over their names so matching a new process
+    costs the same with one policy or with thousands
+    
+	@date 10/19/2026
+***************************************************************/
+
+#ifndef _MORE_POLICY_H_
+#define _MORE_POLICY_H_
+
+#include "stdint.h"
+
+/** Magic value starting a policy blob ("MPOL") */
+#define POLICY_MAGIC 0x4C4F504D
+/** Version of the blob layout */
+#define POLICY_VERSION 1
+/** Bytes in an image name field, the kernel keeps 14 characters of the name */
+#define POLICY_NAME_LEN 16
+/** Most entries a table holds */
+#define POLICY_MAX_ENTRIES 4096
+
+/** Measure the executable sections of the target periodically */
+#define POLICY_OPT_MEASURE 0x1
+/** Only split the target if its executable sections match Digest */
+#define POLICY_OPT_VERIFY 0x2
+/** With POLICY_OPT_VERIFY, trust an earlier launch's verification of the same frames */
+#define POLICY_OPT_TRUST_WARM 0x4
+
+/**
+    Header of a policy blob, followed by NumEntries PolicyBlobEntry records
+    
+    @note All fields are little endian
+*/
+struct PolicyBlobHeader_s
+{
+    uint32 Magic; /**< POLICY_MAGIC */
+    uint32 Version; /**< POLICY_VERSION */
+    uint32 NumEntries;
+};
+
+typedef struct PolicyBlobHeader_s PolicyBlobHeader;
+
+/**
+    One policy as stored in a blob
+*/
+struct PolicyBlobEntry_s
+{
+    char Name[POLICY_NAME_LEN]; /**< Image name, NUL padded, only the first 14 characters count */
+    uint32 Digest; /**< Expected checksum of the executable sections */
+    uint32 Options; /**< POLICY_OPT_* */
+};
+
+typedef struct PolicyBlobEntry_s PolicyBlobEntry;
+
+/**
+    One loaded policy
+*/
+struct PolicyEntry_s
+{
+    char Name[POLICY_NAME_LEN]; /**< Lower case image name, NUL terminated */
+    uint32 Hash; /**< Hash of Name */
+    uint32 Digest; /**< Expected checksum of the executable sections */
+    uint32 Options; /**< POLICY_OPT_* */
+};
+
+typedef struct PolicyEntry_s PolicyEntry;
+
+/**
+    Policies indexed by image name
+*/
+struct PolicyTable_s
+{
+    PolicyEntry *Entries; /**< Caller supplied storage */
+    uint16 *Slots; /**< Index + 1 of the entry in each slot, 0 if empty */
+    uint32 NumEntries;
+    uint32 SlotMask; /**< Number of slots - 1, at least twice the entries */
+    uint32 Duplicates; /**< Entries dropped since an earlier one had the same name */
+};
+
+typedef struct PolicyTable_s PolicyTable;
+
+/**
+    Returns the number of entries in a blob
+    
+    @param blob Pointer to the blob
+    @param len Number of bytes in the blob
+    @return Number of entries, or 0 if the blob is not valid
+*/
+uint32 policyBlobEntries(const uint8 *blob, uint32 len);
+
+/**
+    Returns the bytes of storage a table of numEntries entries needs
+*/
+uint32 policyStorageSize(uint32 numEntries);
+
+/**
+    Loads the policies of a blob into a table
+    
+    @param table Pointer to the table
+    @param blob Pointer to the blob
+    @param len Number of bytes in the blob
+    @param storage Memory for the entries and slots, 4-byte aligned
+    @param storageSize Number of bytes of storage
+    @return 1 if the table was loaded, 0 if the blob is not valid or the
+    storage too small
+*/
+uint8 policyLoad(PolicyTable *table, const uint8 *blob, uint32 len,
+                 void *storage, uint32 storageSize);
+
+/**
+    Finds the policy of an image
+    
+    @note Names are compared without regard to case, only the first 14
+    characters count
+    @param table Pointer to a loaded table
+    @param name Image name, as returned by PsGetProcessImageFileName
+    @return Pointer to the policy, or NULL if the image has none
+*/
+const PolicyEntry * policyLookup(const PolicyTable *table, const char *name);
+
+#endif // _MORE_POLICY_H_
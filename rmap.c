@@ -0,0 +1,440 @@
+/**
+	@file
+	Reverse physical to virtual map
+    
+    Builds in the driver or, with MORE_PTHREADS defined, as a user-space
+    library: gcc -DMORE_PTHREADS -c rmap.c
+    
+	@date 10/19/2026
+***************************************************************/
+#ifndef MORE_PTHREADS
+#include "ntddk.h"
+#endif
+#include "stdint.h"
+#include "rmap.h"
+#ifdef RMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+/** Flag bits the directory entry has to allow for the alias to keep them */
+#define RMAP_DIR_FLAGS (RMAP_VA_WRITE | RMAP_VA_USER)
+/** Bits 51:44 of a PAE entry, frames up there do not fit in a 32-bit Pfn */
+#define RMAP_PAE_HIGH_FRAME 0x000FF000
+
+void rmapInit(ReverseMap *map, RmapEntry *storage, uint32 maxEntries,
+              uint32 minPfn, uint32 maxPfn, uint32 flags)
+{
+    map->Entries = storage;
+    map->NumEntries = 0;
+    map->MaxEntries = maxEntries;
+    map->MinPfn = minPfn;
+    map->MaxPfn = maxPfn;
+    map->Flags = flags;
+    map->Dropped = 0;
+    map->TablesScanned = 0;
+}
+
+/**
+    Returns the frame of a PAE entry held as its low and high words, or ~0 if
+    it does not fit in 32 bits
+*/
+static uint32 rmapPaePfn(uint32 low, uint32 high)
+{
+    if (high & RMAP_PAE_HIGH_FRAME)
+        return ~(uint32) 0;
+    return (low >> 12) | ((high & 0xFFF) << 20);
+}
+
+uint32 rmapScanTableScalar(const uint32 *table, uint32 minPfn, uint32 maxPfn, uint16 *matches)
+{
+    uint32 i, n = 0;
+    
+    for (i = 0; i < RMAP_TABLE_ENTRIES; i++)
+    {
+        // One unsigned compare covers both ends of the range
+        if ((table[i] & 1) && (table[i] >> 12) - minPfn < maxPfn - minPfn)
+            matches[n++] = (uint16) i;
+    }
+    return n;
+}
+
+uint32 rmapScanPaeTableScalar(const uint32 *table, uint32 minPfn, uint32 maxPfn,
+                              uint16 *matches)
+{
+    uint32 i, n = 0;
+    
+    for (i = 0; i < RMAP_PAE_ENTRIES; i++)
+    {
+        if ((table[2 * i] & 1) &&
+                rmapPaePfn(table[2 * i], table[2 * i + 1]) - minPfn < maxPfn - minPfn)
+            matches[n++] = (uint16) i;
+    }
+    return n;
+}
+
+#ifdef RMAP_SSE2
+/** Index of the lowest set bit of a non-zero nibble */
+static const uint8 rmapLowBit[16] = {0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
+
+/**
+    Appends the index of every set bit of an 8 bit match mask
+*/
+static uint32 rmapAddMatches(uint32 mask, uint32 base, uint16 *matches, uint32 n)
+{
+    // Most groups of PTEs have no match
+    for ( ; mask != 0; mask &= mask - 1)
+    {
+        matches[n++] = (uint16) (base + ((mask & 0x0F) ? rmapLowBit[mask & 0x0F] :
+                                                         4 + rmapLowBit[mask >> 4]));
+    }
+    return n;
+}
+
+/**
+    Returns which of four frames are in range, all ones in each lane that is
+*/
+static __m128i rmapInRange(__m128i pfns, __m128i low, __m128i span)
+{
+    // SSE2 only has signed compares, so both sides are biased by 2^31
+    const __m128i bias = _mm_set1_epi32((int) 0x80000000);
+    
+    return _mm_cmplt_epi32(_mm_xor_si128(_mm_sub_epi32(pfns, low), bias), span);
+}
+
+uint32 rmapScanTableSse2(const uint32 *table, uint32 minPfn, uint32 maxPfn, uint16 *matches)
+{
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i low = _mm_set1_epi32((int) minPfn);
+    const __m128i span = _mm_set1_epi32((int) ((maxPfn - minPfn) ^ 0x80000000));
+    __m128i a, b, hitA, hitB;
+    uint32 i, n = 0, mask;
+    
+    for (i = 0; i < RMAP_TABLE_ENTRIES; i += 8)
+    {
+        a = _mm_loadu_si128((const __m128i *) &table[i]);
+        b = _mm_loadu_si128((const __m128i *) &table[i + 4]);
+        hitA = rmapInRange(_mm_srli_epi32(a, 12), low, span);
+        hitB = rmapInRange(_mm_srli_epi32(b, 12), low, span);
+        hitA = _mm_and_si128(hitA, _mm_cmpeq_epi32(_mm_and_si128(a, one), one));
+        hitB = _mm_and_si128(hitB, _mm_cmpeq_epi32(_mm_and_si128(b, one), one));
+    
+        mask = (uint32) _mm_movemask_ps(_mm_castsi128_ps(hitA)) |
+               ((uint32) _mm_movemask_ps(_mm_castsi128_ps(hitB)) << 4);
+        n = rmapAddMatches(mask, i, matches, n);
+    }
+    return n;
+}
+
+/**
+    Returns which of the four PAE entries in a and b (two each) are present
+    and map a frame in range
+*/
+static __m128i rmapPaeHits(__m128i a, __m128i b, __m128i low, __m128i span)
+{
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i highFrame = _mm_set1_epi32(RMAP_PAE_HIGH_FRAME);
+    const __m128i frameBits = _mm_set1_epi32(0xFFF);
+    __m128i lows, highs, pfns, hit;
+    
+    // Gather the low and the high words of the four entries
+    lows = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b),
+                                           _MM_SHUFFLE(2, 0, 2, 0)));
+    highs = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b),
+                                            _MM_SHUFFLE(3, 1, 3, 1)));
+    pfns = _mm_or_si128(_mm_srli_epi32(lows, 12),
+                        _mm_slli_epi32(_mm_and_si128(highs, frameBits), 20));
+    hit = rmapInRange(pfns, low, span);
+    hit = _mm_and_si128(hit, _mm_cmpeq_epi32(_mm_and_si128(lows, one), one));
+    return _mm_and_si128(hit, _mm_cmpeq_epi32(_mm_and_si128(highs, highFrame), zero));
+}
+
+uint32 rmapScanPaeTableSse2(const uint32 *table, uint32 minPfn, uint32 maxPfn,
+                            uint16 *matches)
+{
+    const __m128i low = _mm_set1_epi32((int) minPfn);
+    const __m128i span = _mm_set1_epi32((int) ((maxPfn - minPfn) ^ 0x80000000));
+    __m128i hitA, hitB;
+    uint32 i, n = 0, mask;
+    
+    for (i = 0; i < RMAP_PAE_ENTRIES; i += 8)
+    {
+        hitA = rmapPaeHits(_mm_loadu_si128((const __m128i *) &table[2 * i]),
+                           _mm_loadu_si128((const __m128i *) &table[2 * i + 4]), low, span);
+        hitB = rmapPaeHits(_mm_loadu_si128((const __m128i *) &table[2 * i + 8]),
+                           _mm_loadu_si128((const __m128i *) &table[2 * i + 12]), low, span);
+    
+        mask = (uint32) _mm_movemask_ps(_mm_castsi128_ps(hitA)) |
+               ((uint32) _mm_movemask_ps(_mm_castsi128_ps(hitB)) << 4);
+        n = rmapAddMatches(mask, i, matches, n);
+    }
+    return n;
+}
+#endif
+
+/**
+    Appends an alias, counting it as dropped if the map is full
+*/
+static void rmapAdd(ReverseMap *map, uint32 pfn, uint32 va)
+{
+    if (map->NumEntries == map->MaxEntries)
+    {
+        map->Dropped++;
+        return;
+    }
+    map->Entries[map->NumEntries].Pfn = pfn;
+    map->Entries[map->NumEntries].Va = va;
+    map->NumEntries++;
+}
+
+/**
+    Returns the flags of an alias, the directory entry can take away write
+    and user access
+*/
+static uint32 rmapFlags(uint32 entry, uint32 dir)
+{
+    return entry & 0xFFF & (dir | ~(uint32) RMAP_DIR_FLAGS);
+}
+
+/**
+    Indexes the frames of a large page which fall in the range
+*/
+static void rmapAddLargePage(ReverseMap *map, uint32 base, uint32 numFrames, uint32 va,
+                             uint32 flags)
+{
+    uint32 j, first, last;
+    
+    if (base == ~(uint32) 0)
+        return;
+    first = (base > map->MinPfn) ? base : map->MinPfn;
+    last = (base + numFrames < map->MaxPfn) ? base + numFrames : map->MaxPfn;
+    for (j = first; j < last; j++)
+    {
+        rmapAdd(map, j, (va + ((j - base) << 12)) | flags);
+    }
+}
+
+/**
+    Indexes the matching PTEs of a page table
+*/
+static void rmapScanTable(ReverseMap *map, const uint32 *pt, uint32 va, uint32 dir)
+{
+    uint32 j, n, entry, pfn;
+    uint8 pae = (map->Flags & RMAP_FLAG_PAE) != 0;
+    
+    map->TablesScanned++;
+#ifdef RMAP_SSE2
+    if (map->Flags & RMAP_FLAG_SIMD)
+        n = pae ? rmapScanPaeTableSse2(pt, map->MinPfn, map->MaxPfn, map->Matches) :
+                  rmapScanTableSse2(pt, map->MinPfn, map->MaxPfn, map->Matches);
+    else
+#endif
+        n = pae ? rmapScanPaeTableScalar(pt, map->MinPfn, map->MaxPfn, map->Matches) :
+                  rmapScanTableScalar(pt, map->MinPfn, map->MaxPfn, map->Matches);
+    for (j = 0; j < n; j++)
+    {
+        entry = pae ? pt[2 * map->Matches[j]] : pt[map->Matches[j]];
+        pfn = pae ? rmapPaePfn(entry, pt[2 * map->Matches[j] + 1]) : entry >> 12;
+        rmapAdd(map, pfn, (va + ((uint32) map->Matches[j] << 12)) | rmapFlags(entry, dir));
+    }
+}
+
+/**
+    Indexes a 32-bit page directory
+*/
+static void rmapWalk32(ReverseMap *map, const uint32 *pd, RmapMapFn mapTable,
+                       RmapUnmapFn unmapTable, void *context)
+{
+    uint32 i, *pt;
+    
+    for (i = 0; i < RMAP_TABLE_ENTRIES; i++)
+    {
+        if (!(pd[i] & 1) || ((map->Flags & RMAP_FLAG_USER) && !(pd[i] & RMAP_VA_USER)))
+            continue;
+        // 4 MiB page
+        if (pd[i] & 0x80)
+        {
+            rmapAddLargePage(map, (pd[i] & 0xFFC00000) >> 12, RMAP_TABLE_ENTRIES, i << 22,
+                             pd[i] & 0xFFF);
+            continue;
+        }
+        pt = (uint32 *) mapTable(context, pd[i] & 0xFFFFF000);
+        if (pt == NULL)
+            continue;
+        rmapScanTable(map, pt, i << 22, pd[i]);
+        if (unmapTable != NULL)
+            unmapTable(context, (uint8 *) pt);
+    }
+}
+
+/**
+    Indexes a PAE page directory covering the GB at va
+*/
+static void rmapWalkPae(ReverseMap *map, const uint32 *pd, uint32 va, RmapMapFn mapTable,
+                        RmapUnmapFn unmapTable, void *context)
+{
+    uint32 i, low, high, *pt;
+    
+    for (i = 0; i < RMAP_PAE_ENTRIES; i++)
+    {
+        low = pd[2 * i];
+        high = pd[2 * i + 1];
+        if (!(low & 1) || ((map->Flags & RMAP_FLAG_USER) && !(low & RMAP_VA_USER)))
+            continue;
+        // 2 MiB page
+        if (low & 0x80)
+        {
+            rmapAddLargePage(map, rmapPaePfn(low & 0xFFE00000, high), RMAP_PAE_ENTRIES,
+                             va | (i << 21), low & 0xFFF);
+            continue;
+        }
+        pt = (uint32 *) mapTable(context, ((uint64) (high & 0x000FFFFF) << 32) |
+                                          (low & 0xFFFFF000));
+        if (pt == NULL)
+            continue;
+        rmapScanTable(map, pt, va | (i << 21), low);
+        if (unmapTable != NULL)
+            unmapTable(context, (uint8 *) pt);
+    }
+}
+
+/**
+    Returns non-zero if entry a sorts after entry b
+*/
+static int rmapAfter(const RmapEntry *a, const RmapEntry *b)
+{
+    return (a->Pfn != b->Pfn) ? a->Pfn > b->Pfn : a->Va > b->Va;
+}
+
+/**
+    Restores the heap property below node root
+*/
+static void rmapSiftDown(RmapEntry *entries, uint32 root, uint32 count)
+{
+    uint32 child;
+    RmapEntry tmp;
+    
+    while ((child = 2 * root + 1) < count)
+    {
+        if (child + 1 < count && rmapAfter(&entries[child + 1], &entries[child]))
+            child++;
+        if (!rmapAfter(&entries[child], &entries[root]))
+            return;
+        tmp = entries[root];
+        entries[root] = entries[child];
+        entries[child] = tmp;
+        root = child;
+    }
+}
+
+/**
+    Sorts the entries by frame, in place and without recursion (heapsort)
+*/
+static void rmapSort(RmapEntry *entries, uint32 count)
+{
+    uint32 i;
+    RmapEntry tmp;
+    
+    for (i = count / 2; i > 0; i--)
+    {
+        rmapSiftDown(entries, i - 1, count);
+    }
+    for (i = count; i > 1; i--)
+    {
+        tmp = entries[0];
+        entries[0] = entries[i - 1];
+        entries[i - 1] = tmp;
+        rmapSiftDown(entries, 0, i - 1);
+    }
+}
+
+uint32 rmapBuild(ReverseMap *map, uint32 cr3, RmapMapFn mapTable,
+                 RmapUnmapFn unmapTable, void *context)
+{
+    uint32 *top, *pdpt, *pd, i;
+    
+    map->NumEntries = 0;
+    map->Dropped = 0;
+    map->TablesScanned = 0;
+    if (map->MaxPfn <= map->MinPfn)
+        return 0;
+    
+    top = (uint32 *) mapTable(context, cr3 & 0xFFFFF000);
+    if (top == NULL)
+        return 0;
+    
+    if (!(map->Flags & RMAP_FLAG_PAE))
+    {
+        rmapWalk32(map, top, mapTable, unmapTable, context);
+    }
+    else
+    {
+        // The four PDPTEs are 32-byte aligned inside the page
+        pdpt = top + (cr3 & 0xFE0) / sizeof(uint32);
+        for (i = 0; i < 4; i++)
+        {
+            if (!(pdpt[2 * i] & 1))
+                continue;
+            pd = (uint32 *) mapTable(context, ((uint64) (pdpt[2 * i + 1] & 0x000FFFFF) << 32) |
+                                              (pdpt[2 * i] & 0xFFFFF000));
+            if (pd == NULL)
+                continue;
+            rmapWalkPae(map, pd, i << 30, mapTable, unmapTable, context);
+            if (unmapTable != NULL)
+                unmapTable(context, (uint8 *) pd);
+        }
+    }
+    if (unmapTable != NULL)
+        unmapTable(context, (uint8 *) top);
+    
+    rmapSort(map->Entries, map->NumEntries);
+    return map->NumEntries;
+}
+
+/**
+    Returns the index of the first entry in [low, NumEntries) whose frame is
+    not below pfn
+*/
+static uint32 rmapLowerBound(ReverseMap *map, uint32 low, uint32 pfn)
+{
+    uint32 high = map->NumEntries, mid;
+    
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (map->Entries[mid].Pfn < pfn)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+uint32 rmapLookup(ReverseMap *map, uint32 pfn, uint32 *first)
+{
+    uint32 i = rmapLowerBound(map, 0, pfn), n = 0;
+    
+    while (i + n < map->NumEntries && map->Entries[i + n].Pfn == pfn)
+    {
+        n++;
+    }
+    *first = i;
+    return n;
+}
+
+void rmapLookupBatch(ReverseMap *map, const uint32 *pfns, uint32 numPfns,
+                     uint32 *first, uint32 *count)
+{
+    uint32 i, pos = 0, n;
+    
+    for (i = 0; i < numPfns; i++)
+    {
+        // Keep going from the last answer while the queries ascend
+        if (i > 0 && pfns[i] < pfns[i - 1])
+            pos = 0;
+        pos = rmapLowerBound(map, pos, pfns[i]);
+        for (n = 0; pos + n < map->NumEntries && map->Entries[pos + n].Pfn == pfns[i]; n++);
+        first[i] = pos;
+        count[i] = n;
+    }
+}
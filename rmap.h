@@ -0,0 +1,167 @@
+/**
+	@file
+	Reverse physical to virtual map (header file)
+    
+    Walks the 32-bit or PAE page tables of a CR3 once and builds an index
+    of every virtual address a physical frame is mapped at, sorted by frame
+    
+	@date 10/19/2026
+***************************************************************/
+
+#ifndef _MORE_RMAP_H_
+#define _MORE_RMAP_H_
+
+#include "stdint.h"
+
+/** Number of 32-bit words in a page directory or page table */
+#define RMAP_TABLE_ENTRIES 1024
+/** Number of entries in a PAE page directory or page table */
+#define RMAP_PAE_ENTRIES 512
+/** Allow the SIMD PTE-compare kernel to be used (the caller saved the FPU state) */
+#define RMAP_FLAG_SIMD 0x1
+/** The page tables are PAE tables (CR4.PAE) */
+#define RMAP_FLAG_PAE 0x2
+/** Skip directory entries user mode cannot reach, e.g. the kernel half */
+#define RMAP_FLAG_USER 0x4
+/** Flag bit of an alias which is writable through every level of the walk */
+#define RMAP_VA_WRITE 0x2
+/** Flag bit of an alias which user mode can reach through every level of the walk */
+#define RMAP_VA_USER 0x4
+
+#if defined(__SSE2__) || defined(_M_IX86) || defined(_M_X64)
+/** The SSE2 PTE-compare kernels are compiled in (MSVC has the intrinsics without /arch:SSE2) */
+#define RMAP_SSE2 1
+#endif
+
+/**
+    Callback which makes a page directory or page table readable
+    
+    @param context Caller supplied context
+    @param phys Physical address of the table, may be above 4 GiB with PAE
+    @return Pointer to the 4 KB of the table, or NULL
+*/
+typedef uint8 * (*RmapMapFn)(void *context, uint64 phys);
+
+/**
+    Callback which releases a table returned by an RmapMapFn
+    
+    @param context Caller supplied context
+    @param ptr Pointer returned by the map callback
+*/
+typedef void (*RmapUnmapFn)(void *context, uint8 *ptr);
+
+/**
+    One virtual alias of a physical frame
+*/
+struct RmapEntry_s
+{
+    uint32 Pfn; /**< Physical frame number */
+    uint32 Va; /**< Virtual address the frame is mapped at, the low 12 bits hold
+                    the flags of the PTE (or large PDE) with RMAP_VA_WRITE and
+                    RMAP_VA_USER cleared unless the directory allows them too */
+};
+
+typedef struct RmapEntry_s RmapEntry;
+
+/**
+    Sorted frame to virtual address index
+*/
+struct ReverseMap_s
+{
+    RmapEntry *Entries; /**< Caller supplied storage, sorted by Pfn then Va */
+    uint32 NumEntries;
+    uint32 MaxEntries;
+    uint32 MinPfn; /**< Only frames in [MinPfn, MaxPfn) are indexed */
+    uint32 MaxPfn;
+    uint32 Flags; /**< RMAP_FLAG_* */
+    uint32 Dropped; /**< Aliases which did not fit in Entries */
+    uint32 TablesScanned; /**< Page tables compared during the last build */
+    uint16 Matches[RMAP_TABLE_ENTRIES]; /**< Scratch for the compare kernels, kept off the stack */
+};
+
+typedef struct ReverseMap_s ReverseMap;
+
+/**
+    Initializes an empty reverse map
+    
+    @param map Pointer to the map
+    @param storage Array of maxEntries entries
+    @param maxEntries Number of entries in storage
+    @param minPfn First frame to index
+    @param maxPfn Frame after the last one to index
+    @param flags RMAP_FLAG_* values
+*/
+void rmapInit(ReverseMap *map, RmapEntry *storage, uint32 maxEntries,
+              uint32 minPfn, uint32 maxPfn, uint32 flags);
+
+/**
+    Finds the present PTEs of a 32-bit page table which map a frame in
+    [minPfn, maxPfn)
+    
+    @param table Pointer to the RMAP_TABLE_ENTRIES PTEs of the table
+    @param minPfn First frame to match
+    @param maxPfn Frame after the last one to match
+    @param matches Receives the index of every matching PTE, in order
+    @return Number of matches
+*/
+uint32 rmapScanTableScalar(const uint32 *table, uint32 minPfn, uint32 maxPfn, uint16 *matches);
+
+/**
+    PAE version of rmapScanTableScalar, frames at or above 2^44 never match
+    
+    @param table Pointer to the RMAP_PAE_ENTRIES PTEs of the table
+*/
+uint32 rmapScanPaeTableScalar(const uint32 *table, uint32 minPfn, uint32 maxPfn,
+                              uint16 *matches);
+
+#ifdef RMAP_SSE2
+/**
+    SSE2 version of rmapScanTableScalar, compares four PTEs at a time
+*/
+uint32 rmapScanTableSse2(const uint32 *table, uint32 minPfn, uint32 maxPfn, uint16 *matches);
+
+/**
+    SSE2 version of rmapScanPaeTableScalar, compares four PTEs at a time
+*/
+uint32 rmapScanPaeTableSse2(const uint32 *table, uint32 minPfn, uint32 maxPfn,
+                            uint16 *matches);
+#endif
+
+/**
+    Walks the page tables of cr3 once and rebuilds the map
+    
+    @param map Pointer to an initialized map
+    @param cr3 CR3 value of the address space
+    @param mapTable Callback to make each table readable
+    @param unmapTable Callback to release each table, may be NULL
+    @param context Context passed to the callbacks
+    @return Number of aliases indexed
+*/
+uint32 rmapBuild(ReverseMap *map, uint32 cr3, RmapMapFn mapTable,
+                 RmapUnmapFn unmapTable, void *context);
+
+/**
+    Finds the virtual aliases of a frame
+    
+    @param map Pointer to a built map
+    @param pfn Frame to look up
+    @param first Receives the index of the first alias in map->Entries
+    @return Number of aliases
+*/
+uint32 rmapLookup(ReverseMap *map, uint32 pfn, uint32 *first);
+
+/**
+    Finds the virtual aliases of many frames
+    
+    @note Ascending runs of pfns are answered by continuing the search from the
+    previous result instead of from the start of the map
+    @param map Pointer to a built map
+    @param pfns Frames to look up
+    @param numPfns Number of frames
+    @param first Receives the index of the first alias of each frame
+    @param count Receives the number of aliases of each frame
+*/
+void rmapLookupBatch(ReverseMap *map, const uint32 *pfns, uint32 numPfns,
+                     uint32 *first, uint32 *count);
+
+#endif // _MORE_RMAP_H_
@@ -1,22 +1,22 @@
-/**
-	@file
-	Defines standard types
-		
-	@date 11/9/2011
-***************************************************************/
-
-#ifndef _MORE_STDINT_H_
-#define _MORE_STDINT_H_
-
-typedef unsigned int uint32;
-typedef int int32;
-
-typedef unsigned short uint16;
-typedef short int16;
-
-typedef unsigned char uint8;
-typedef char int8;
-
-typedef unsigned long long int uint64;
-
-#endif // _MORE_STDINT_H
+/**
+	@file
+	Defines standard types
+		
+	@date 11/9/2011
+***************************************************************/
+
+#ifndef _MORE_STDINT_H_
+#define _MORE_STDINT_H_
+
+typedef unsigned int uint32;
+typedef int int32;
+
+typedef unsigned short uint16;
+typedef short int16;
+
+typedef unsigned char uint8;
+typedef char int8;
+
+typedef unsigned long long int uint64;
+
+#endif // _MORE_STDINT_H
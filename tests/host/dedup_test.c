@@ -0,0 +1,184 @@
+/**
+    Unit test for the shared page copy store
+    
+    Shares the copy of a frame between users, keeps copies apart whose
+    frame, digest or contents differ, frees a copy with its last reference,
+    reuses the freed entries and handles a full store, then checks the
+    reference counts after a long random sequence against a simple model
+    
+    @file
+    
+    @authors Assured Information Security, Inc.
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dedup.h"
+#include "test.h"
+
+/** Entries in the store of the random test */
+#define TEST_ENTRIES 64
+/** Buckets in the store of the random test, few so that chains form */
+#define TEST_BUCKETS 8
+/** Frames the random test picks from */
+#define TEST_FRAMES 48
+/** Most references the random test holds at once */
+#define TEST_REFS 512
+/** Operations of the random test */
+#define TEST_STEPS 200000
+
+/** Contents of each simulated frame */
+static uint8 testFrames[TEST_FRAMES][DEDUP_PAGE_SIZE];
+
+/**
+    Makes a copy of a frame the way the driver does, returns NULL if the store is full
+*/
+static DedupEntry * testCopy(DedupStore *store, uint32 frame)
+{
+    uint32 digest = dedupDigest(testFrames[frame]);
+    DedupEntry *entry = dedupAcquire(store, frame, testFrames[frame], digest);
+    uint8 *copy;
+    
+    if (entry != NULL)
+        return entry;
+    copy = (uint8 *) malloc(DEDUP_PAGE_SIZE);
+    memcpy(copy, testFrames[frame], DEDUP_PAGE_SIZE);
+    entry = dedupInsert(store, frame, digest, copy, frame << 12);
+    if (entry == NULL)
+        free(copy);
+    return entry;
+}
+
+static void testBasic()
+{
+    DedupStore store;
+    DedupEntry entries[4], *a, *b, *c, *d;
+    uint32 buckets[4], i;
+    uint8 *freed;
+    
+    printf("sharing\n");
+    dedupInit(&store, entries, 4, buckets, 4);
+    memset(testFrames[1], 0x11, DEDUP_PAGE_SIZE);
+    memset(testFrames[2], 0x11, DEDUP_PAGE_SIZE);
+    
+    // Two users of one frame share the copy, another frame with the same
+    // contents gets its own
+    a = testCopy(&store, 1);
+    b = testCopy(&store, 1);
+    c = testCopy(&store, 2);
+    TEST_CHECK(a != NULL && a == b && a->Refs == 2);
+    TEST_CHECK(c != NULL && c != a && c->Refs == 1);
+    TEST_CHECK(store.NumEntries == 2 && store.Shared == 1);
+    
+    // A frame which changed since its copy was made gets a new copy
+    testFrames[1][100] ^= 0xFF;
+    d = testCopy(&store, 1);
+    TEST_CHECK(d != NULL && d != a && d->Refs == 1);
+    TEST_CHECK(store.NumEntries == 3);
+    
+    // Contents differing with the same digest are not shared
+    b = dedupAcquire(&store, 1, testFrames[1], a->Digest);
+    TEST_CHECK(b == NULL && store.Stale == 1);
+    
+    // The copy is only handed back with its last reference
+    TEST_CHECK(dedupRelease(&store, a) == NULL);
+    freed = a->Copy;
+    TEST_CHECK(dedupRelease(&store, a) == freed);
+    free(freed);
+    TEST_CHECK(store.NumEntries == 2 && a->Refs == 0);
+    TEST_CHECK(dedupRelease(&store, a) == NULL);
+    testFrames[1][100] ^= 0xFF;
+    TEST_CHECK(dedupAcquire(&store, 1, testFrames[1], dedupDigest(testFrames[1])) == NULL);
+    
+    // A full store refuses new copies, freed entries are reused
+    memset(testFrames[3], 0x33, DEDUP_PAGE_SIZE);
+    memset(testFrames[4], 0x44, DEDUP_PAGE_SIZE);
+    TEST_CHECK(testCopy(&store, 3) != NULL);
+    TEST_CHECK(testCopy(&store, 4) != NULL);
+    TEST_CHECK(store.NumEntries == 4 && store.FreeList == 0);
+    TEST_CHECK(testCopy(&store, 1) == NULL);
+    free(dedupRelease(&store, c));
+    TEST_CHECK(testCopy(&store, 1) == c);
+    for (i = 0; i < 4; i++)
+    {
+        free(entries[i].Copy);
+    }
+}
+
+static void testRandom()
+{
+    DedupStore store;
+    DedupEntry entries[TEST_ENTRIES], *held[TEST_REFS], *entry;
+    uint32 buckets[TEST_BUCKETS], heldFrame[TEST_REFS], refs[TEST_FRAMES] = {0};
+    uint32 numHeld = 0, step, i, frame, total, mismatches = 0, full = 0;
+    uint8 *freed;
+    
+    printf("random sequence\n");
+    dedupInit(&store, entries, TEST_ENTRIES, buckets, TEST_BUCKETS);
+    for (frame = 0; frame < TEST_FRAMES; frame++)
+    {
+        for (i = 0; i < DEDUP_PAGE_SIZE; i++)
+        {
+            testFrames[frame][i] = (uint8) rand();
+        }
+    }
+    
+    for (step = 0; step < TEST_STEPS; step++)
+    {
+        if (numHeld < TEST_REFS && (numHeld == 0 || rand() % 2))
+        {
+            frame = (uint32) rand() % TEST_FRAMES;
+            entry = testCopy(&store, frame);
+            if (entry == NULL)
+            {
+                full++;
+                continue;
+            }
+            if (entry->Frame != frame ||
+                    memcmp(entry->Copy, testFrames[frame], DEDUP_PAGE_SIZE) != 0)
+                mismatches++;
+            held[numHeld] = entry;
+            heldFrame[numHeld++] = frame;
+            refs[frame]++;
+        }
+        else
+        {
+            i = (uint32) rand() % numHeld;
+            refs[heldFrame[i]]--;
+            freed = dedupRelease(&store, held[i]);
+            // The copy goes with the last user of the frame
+            if ((freed != NULL) != (refs[heldFrame[i]] == 0))
+                mismatches++;
+            free(freed);
+            held[i] = held[--numHeld];
+            heldFrame[i] = heldFrame[numHeld];
+        }
+    }
+    TEST_CHECK(mismatches == 0);
+    TEST_CHECK(full == 0);
+    
+    // One entry per frame in use, holding all of its references
+    for (frame = 0, total = 0; frame < TEST_FRAMES; frame++)
+    {
+        total += (refs[frame] != 0);
+    }
+    TEST_CHECK(store.NumEntries == total);
+    for (i = 0; i < numHeld; i++)
+    {
+        TEST_CHECK(held[i]->Refs == refs[heldFrame[i]]);
+    }
+    while (numHeld > 0)
+    {
+        free(dedupRelease(&store, held[--numHeld]));
+    }
+    TEST_CHECK(store.NumEntries == 0);
+}
+
+int main()
+{
+    srand(1234);
+    testBasic();
+    testRandom();
+    return testResult("dedup_test");
+}
@@ -0,0 +1,281 @@
+/**
+    Unit test for the guest memory accessor
+    
+    Builds page tables in a simulated guest physical memory and checks
+    translation, read, hash and compare against the expected contents,
+    including 4 MiB pages, pages which are not present and accesses which
+    cross page boundaries, then walks PAE tables which map frames above
+    4 GiB
+    
+    @file
+    
+    @authors Assured Information Security, Inc.
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gmem.h"
+#include "test.h"
+
+/** Number of frames of simulated guest memory (12 MiB) */
+#define TEST_FRAMES 3072
+/** Virtual address of the small page region */
+#define TEST_SMALL_VA 0x00400000
+/** Number of small pages mapped, the last one is left not present */
+#define TEST_SMALL_PAGES 40
+/** Virtual address of the 4 MiB page */
+#define TEST_LARGE_VA 0x80000000
+/** Physical address the 4 MiB page maps */
+#define TEST_LARGE_PHYS 0x00800000
+/** Physical address above 4 GiB which is backed by simulated memory */
+#define TEST_HIGH_PHYS 0x240000000ULL
+/** Simulated memory backing TEST_HIGH_PHYS */
+#define TEST_HIGH_ALIAS 0x00400000
+/** Frame of the PAE page directory pointer table, at offset 0x20 */
+#define TEST_PAE_PDPT 0x2000
+/** Frame of the PAE page directory */
+#define TEST_PAE_PD 0x3000
+/** Frame of the PAE page table */
+#define TEST_PAE_PT 0x4000
+
+/** Simulated guest physical memory */
+static uint8 *testMemory;
+/** Frames currently mapped through the callbacks */
+static int testOutstanding;
+
+static uint8 * testMapFrame(void *context, uint64 phys)
+{
+    (void) context;
+    if (phys >= TEST_HIGH_PHYS)
+        phys = phys - TEST_HIGH_PHYS + TEST_HIGH_ALIAS;
+    if (phys >= TEST_FRAMES * GMEM_PAGE_SIZE)
+        return NULL;
+    testOutstanding++;
+    return testMemory + phys;
+}
+
+static void testUnmapFrame(void *context, uint8 *ptr)
+{
+    (void) context;
+    (void) ptr;
+    testOutstanding--;
+}
+
+/**
+    Frame backing small page i, scattered so consecutive pages are not contiguous
+*/
+static uint32 testSmallFrame(uint32 i)
+{
+    return 16 + ((i * 7) % TEST_SMALL_PAGES);
+}
+
+/**
+    Builds a page directory in frame 0, a page table in frame 1, the small
+    pages after them and one 4 MiB page
+*/
+static void testBuildTables()
+{
+    uint32 *pd = (uint32 *) testMemory, *pt = (uint32 *) (testMemory + GMEM_PAGE_SIZE), i;
+    
+    for (i = 0; i < TEST_FRAMES * GMEM_PAGE_SIZE; i++)
+    {
+        testMemory[i] = (uint8) (i * 31 + (i >> 12));
+    }
+    memset(pd, 0, 2 * GMEM_PAGE_SIZE);
+    
+    pd[TEST_SMALL_VA >> 22] = GMEM_PAGE_SIZE | 0x3;
+    pd[TEST_LARGE_VA >> 22] = TEST_LARGE_PHYS | 0x83;
+    for (i = 0; i < TEST_SMALL_PAGES; i++)
+    {
+        // Stale frame with the present bit clear for the last page
+        pt[i] = (testSmallFrame(i) << 12) | ((i == TEST_SMALL_PAGES - 1) ? 0x2 : 0x3);
+    }
+}
+
+static void testTranslate(GuestMemory *gm)
+{
+    uint64 phys = 0;
+    
+    printf("translate\n");
+    TEST_CHECK(gmemTranslate(gm, TEST_SMALL_VA + 0x123, &phys) && 
+               phys == (testSmallFrame(0) << 12) + 0x123);
+    TEST_CHECK(gmemTranslate(gm, TEST_SMALL_VA + 5 * GMEM_PAGE_SIZE, &phys) && 
+               phys == testSmallFrame(5) << 12);
+    TEST_CHECK(gmemTranslate(gm, TEST_LARGE_VA + 0x3FF004, &phys) && 
+               phys == TEST_LARGE_PHYS + 0x3FF004);
+    TEST_CHECK(!gmemTranslate(gm, TEST_SMALL_VA + (TEST_SMALL_PAGES - 1) * GMEM_PAGE_SIZE, &phys));
+    TEST_CHECK(!gmemTranslate(gm, 0x40000000, &phys));
+    
+    // A second lookup of the same page comes from the TLB
+    gmemTranslate(gm, TEST_SMALL_VA + 0x456, &phys);
+    TEST_CHECK(gm->TlbHits > 0);
+}
+
+static void testRead(GuestMemory *gm)
+{
+    uint32 len = 3 * GMEM_PAGE_SIZE, va = TEST_SMALL_VA + 5 * GMEM_PAGE_SIZE - 100, i, off;
+    uint8 *buf = (uint8 *) malloc(TEST_SMALL_PAGES * GMEM_PAGE_SIZE);
+    
+    printf("read\n");
+    TEST_CHECK(gmemRead(gm, va, buf, len) == len);
+    for (i = 0; i < len; i++)
+    {
+        off = va + i - TEST_SMALL_VA;
+        if (buf[i] != testMemory[(testSmallFrame(off >> 12) << 12) + (off & 0xFFF)])
+            break;
+    }
+    TEST_CHECK(i == len);
+    
+    // Stops at the page which is not present
+    va = TEST_SMALL_VA + (TEST_SMALL_PAGES - 2) * GMEM_PAGE_SIZE + 16;
+    TEST_CHECK(gmemRead(gm, va, buf, 2 * GMEM_PAGE_SIZE) == GMEM_PAGE_SIZE - 16);
+    
+    TEST_CHECK(gmemRead(gm, TEST_LARGE_VA + 0x1000, buf, 0x8000) == 0x8000);
+    TEST_CHECK(memcmp(buf, testMemory + TEST_LARGE_PHYS + 0x1000, 0x8000) == 0);
+    free(buf);
+}
+
+static void testHash(GuestMemory *gm)
+{
+    uint32 sum = 0, expect = 0, i, j;
+    
+    printf("hash\n");
+    // The whole region, the page which is not present is skipped
+    TEST_CHECK(gmemHash(gm, TEST_SMALL_VA, TEST_SMALL_PAGES * GMEM_PAGE_SIZE, &sum) ==
+               (TEST_SMALL_PAGES - 1) * GMEM_PAGE_SIZE);
+    for (i = 0; i < TEST_SMALL_PAGES - 1; i++)
+    {
+        for (j = 0; j < GMEM_PAGE_SIZE; j++)
+        {
+            expect += testMemory[(testSmallFrame(i) << 12) + j];
+        }
+    }
+    TEST_CHECK(sum == expect);
+    
+    // Sums accumulate
+    expect = sum + testMemory[TEST_LARGE_PHYS + 7];
+    TEST_CHECK(gmemHash(gm, TEST_LARGE_VA + 7, 1, &sum) == 1 && sum == expect);
+}
+
+static void testCompare(GuestMemory *gm)
+{
+    uint32 off = 0, va = TEST_SMALL_VA + 2 * GMEM_PAGE_SIZE;
+    uint8 buf[2 * GMEM_PAGE_SIZE];
+    
+    printf("compare\n");
+    gmemRead(gm, va, buf, sizeof(buf));
+    TEST_CHECK(gmemCompare(gm, va, buf, sizeof(buf), &off) == GMEM_MATCH);
+    
+    buf[GMEM_PAGE_SIZE + 9] ^= 0xFF;
+    TEST_CHECK(gmemCompare(gm, va, buf, sizeof(buf), &off) == GMEM_MISMATCH && 
+               off == GMEM_PAGE_SIZE + 9);
+    
+    va = TEST_SMALL_VA + (TEST_SMALL_PAGES - 2) * GMEM_PAGE_SIZE;
+    gmemRead(gm, va, buf, GMEM_PAGE_SIZE);
+    TEST_CHECK(gmemCompare(gm, va, buf, sizeof(buf), &off) == GMEM_FAULT && 
+               off == GMEM_PAGE_SIZE);
+}
+
+static void testMappings(GuestMemory *gm)
+{
+    uint32 sum = 0, maps = gm->Maps;
+    uint64 phys;
+    
+    printf("mappings\n");
+    // Streaming the region maps each data frame once and keeps the tables
+    gmemFlush(gm);
+    gmemRelease(gm);
+    TEST_CHECK(testOutstanding == 0);
+    maps = gm->Maps;
+    gmemHash(gm, TEST_SMALL_VA, (TEST_SMALL_PAGES - 1) * GMEM_PAGE_SIZE, &sum);
+    TEST_CHECK(gm->Maps - maps == 2 + TEST_SMALL_PAGES - 1);
+    TEST_CHECK(testOutstanding <= GMEM_MAP_SLOTS);
+    
+    // Switching address spaces forgets the translations
+    gmemSetCR3(gm, 0x2000);
+    TEST_CHECK(!gmemTranslate(gm, TEST_SMALL_VA, &phys));
+    gmemSetCR3(gm, 0);
+    
+    gmemRelease(gm);
+    TEST_CHECK(testOutstanding == 0);
+}
+
+/**
+    Builds PAE tables next to the 32-bit ones: PDPTE 0 maps a page table 
+    whose pages live above 4 GiB, PDPTE 2 maps a 2 MiB page
+*/
+static void testPae()
+{
+    uint64 *pdpt = (uint64 *) (testMemory + TEST_PAE_PDPT + 0x20);
+    uint64 *pd = (uint64 *) (testMemory + TEST_PAE_PD);
+    uint64 *pt = (uint64 *) (testMemory + TEST_PAE_PT), phys = 0;
+    uint32 i, sum = 0, expect = 0, off;
+    uint8 buf[3 * GMEM_PAGE_SIZE];
+    GuestMemory gm;
+    
+    printf("pae\n");
+    memset(testMemory + TEST_PAE_PDPT, 0, 3 * GMEM_PAGE_SIZE);
+    pdpt[0] = TEST_PAE_PD | 0x1;
+    pdpt[2] = TEST_PAE_PD | 0x1;
+    // 0x00600000: page table, 0x80400000: 2 MiB page
+    pd[3] = TEST_PAE_PT | 0x3;
+    pd[2] = TEST_LARGE_PHYS | 0x83;
+    for (i = 0; i < 8; i++)
+    {
+        // NX set on every PTE, the last one is not present
+        pt[i] = (TEST_HIGH_PHYS + ((uint64) (7 - i) << 12)) | (i == 7 ? 0x2 : 0x3) | 
+                ((uint64) 1 << 63);
+    }
+    
+    gmemInit(&gm, TEST_PAE_PDPT | 0x20, GMEM_FLAG_PAE, testMapFrame, testUnmapFrame, NULL);
+    TEST_CHECK(gmemTranslate(&gm, 0x00601234, &phys) && phys == TEST_HIGH_PHYS + 0x6234);
+    TEST_CHECK(gmemTranslate(&gm, 0x80400000 + 0x1FF010, &phys) && 
+               phys == TEST_LARGE_PHYS + 0x1FF010);
+    TEST_CHECK(!gmemTranslate(&gm, 0x00607000, &phys));
+    TEST_CHECK(!gmemTranslate(&gm, 0x40000000, &phys));
+    TEST_CHECK(!gmemTranslate(&gm, 0x00800000, &phys));
+    
+    // Reads cross from one high frame into the next, which comes before it
+    TEST_CHECK(gmemRead(&gm, 0x00600800, buf, 2 * GMEM_PAGE_SIZE) == 2 * GMEM_PAGE_SIZE);
+    TEST_CHECK(memcmp(buf, testMemory + TEST_HIGH_ALIAS + 0x7800, 0x800) == 0);
+    TEST_CHECK(memcmp(buf + 0x800, testMemory + TEST_HIGH_ALIAS + 0x6000, 0x1000) == 0);
+    
+    TEST_CHECK(gmemHash(&gm, 0x00600000, 8 * GMEM_PAGE_SIZE, &sum) == 7 * GMEM_PAGE_SIZE);
+    for (i = 0; i < 7 * GMEM_PAGE_SIZE; i++)
+    {
+        expect += testMemory[TEST_HIGH_ALIAS + GMEM_PAGE_SIZE + i];
+    }
+    TEST_CHECK(sum == expect);
+    
+    gmemRead(&gm, 0x00605000, buf, 2 * GMEM_PAGE_SIZE);
+    TEST_CHECK(gmemCompare(&gm, 0x00605000, buf, sizeof(buf), &off) == GMEM_FAULT && 
+               off == 2 * GMEM_PAGE_SIZE);
+    
+    gmemRelease(&gm);
+    TEST_CHECK(testOutstanding == 0);
+}
+
+int main()
+{
+    GuestMemory gm;
+    
+    testMemory = (uint8 *) malloc(TEST_FRAMES * GMEM_PAGE_SIZE);
+    if (testMemory == NULL)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+    testBuildTables();
+    gmemInit(&gm, 0, 0, testMapFrame, testUnmapFrame, NULL);
+    
+    testTranslate(&gm);
+    testRead(&gm);
+    testHash(&gm);
+    testCompare(&gm);
+    testMappings(&gm);
+    testPae();
+    
+    free(testMemory);
+    return testResult("gmem_test");
+}
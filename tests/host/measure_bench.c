@@ -0,0 +1,94 @@
+/**
+    Scaling benchmark for the chunked measurement engine
+    
+    Measures a large synthetic image with 1 to N worker threads and checks
+    that every run produces the same checksum
+    
+    @file
+    
+    @authors Assured Information Security, Inc.
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "measure.h"
+
+/** Default size of the synthetic image (MiB) */
+#define BENCH_IMAGE_MB 256
+/** Number of timed repetitions per worker count */
+#define BENCH_REPS 5
+
+static uint8 * benchMapPage(void *context, uint32 offset)
+{
+    return (uint8 *) context + offset;
+}
+
+static double benchNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32 imageMb = (argc > 1) ? (uint32) atoi(argv[1]) : BENCH_IMAGE_MB;
+    uint32 maxWorkers = (argc > 2) ? (uint32) atoi(argv[2]) : measureGetProcessorCount();
+    uint32 imageSize = imageMb * 1024 * 1024, i, workers, rep, reference = 0, sum;
+    uint8 *image = (uint8 *) malloc(imageSize);
+    MeasureJob job;
+    double start, best, serial = 0;
+    
+    if (image == NULL)
+    {
+        printf("Unable to allocate %u MiB\n", imageMb);
+        return 1;
+    }
+    if (maxWorkers > MEASURE_MAX_WORKERS)
+        maxWorkers = MEASURE_MAX_WORKERS;
+    
+    srand(54321);
+    for (i = 0; i < imageSize; i++)
+    {
+        image[i] = (uint8) rand();
+    }
+    
+    // Lay the image out like a PE: a few executable sections with ragged ends
+    measureInitJob(&job, benchMapPage, NULL, image);
+    measureAddSpan(&job, 0x1000, imageSize / 2 - 0x1000 - 0x123);
+    measureAddSpan(&job, imageSize / 2, imageSize / 4 + 0x456);
+    measureAddSpan(&job, imageSize - imageSize / 8, imageSize / 8);
+    
+    printf("%u MiB image, %u pages, %u chunks of %u pages\n", 
+           imageMb, job.NumPages, job.NumChunks, job.ChunkPages);
+    
+    for (workers = 1; workers <= maxWorkers; workers++)
+    {
+        best = 0;
+        for (rep = 0; rep < BENCH_REPS; rep++)
+        {
+            start = benchNow();
+            sum = measureRun(&job, workers);
+            start = benchNow() - start;
+            if (best == 0 || start < best)
+                best = start;
+            
+            if (workers == 1 && rep == 0)
+                reference = sum;
+            if (sum != reference)
+            {
+                printf("FAIL: %u workers produced %08x, expected %08x\n", 
+                       workers, sum, reference);
+                return 1;
+            }
+        }
+        if (workers == 1)
+            serial = best;
+        printf("%2u workers: %8.3f ms  %8.1f MiB/s  speedup %.2fx  checksum %08x\n",
+               workers, best * 1000, (job.NumPages * 4.0 / 1024) / best, serial / best, sum);
+    }
+    
+    free(image);
+    return 0;
+}
@@ -0,0 +1,323 @@
+/**
+    Unit test for the MTRR decoding
+    
+    Checks the memory type of pages and large pages under sample MTRR
+    configurations (a typical PC layout, overlapping ranges, disabled fixed
+    ranges and a non-contiguous mask), then compares every 2 MB and 1 GB
+    answer for random configurations against a page by page evaluation
+    
+    @file
+    
+    @authors Assured Information Security, Inc.
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mtrr.h"
+#include "test.h"
+
+/** Physical address width of the simulated processor */
+#define TEST_PHYS_BITS 36
+/** Memory covered by the random comparisons (4 GiB) */
+#define TEST_TOP ((uint64) 4 << 30)
+/** Number of random configurations compared */
+#define TEST_RANDOM_CONFIGS 40
+
+#define KB ((uint64) 1 << 10)
+#define MB ((uint64) 1 << 20)
+#define GB ((uint64) 1 << 30)
+
+/** IA32_MTRRCAP with 8 variable ranges and the fixed ranges */
+#define TEST_CAP 0x508
+/** IA32_MTRR_DEF_TYPE enabled, fixed ranges enabled, default type t */
+#define TEST_DEF(t) (0xC00 | (t))
+
+/**
+    Builds a fixed range MSR value with all eight ranges of type t
+*/
+static uint64 testFixedAll(uint8 t)
+{
+    return (uint64) t * 0x0101010101010101ULL;
+}
+
+/**
+    Sets variable range n to cover the size bytes at base
+*/
+static void testSetRange(MtrrState *state, uint32 n, uint64 base, uint64 size, uint8 type)
+{
+    mtrrSetVariable(state, n, base | type,
+                    (~(size - 1) & (((uint64) 1 << TEST_PHYS_BITS) - 1)) | 0x800);
+}
+
+/**
+    Type of the page at addr, evaluated directly from the MTRR rules
+*/
+static uint8 testPageType(const MtrrState *state, uint64 addr)
+{
+    uint32 i, index;
+    uint8 type = 0, matched = 0, t;
+    
+    if (!state->Enabled)
+        return MTRR_TYPE_UC;
+    if (state->FixedEnabled && addr < MTRR_FIXED_END)
+    {
+        if (addr < 0x80000)
+            index = (uint32) (addr / (64 * KB));
+        else if (addr < 0xC0000)
+            index = 8 + (uint32) ((addr - 0x80000) / (16 * KB));
+        else
+            index = 24 + (uint32) ((addr - 0xC0000) / (4 * KB));
+        return state->Fixed[index];
+    }
+    for (i = 0; i < state->NumVariable; i++)
+    {
+        if (state->VarMask[i] == 0 || (addr & state->VarMask[i]) != state->VarBase[i])
+            continue;
+        t = state->VarType[i];
+        if (!matched)
+            type = t;
+        else if (type == MTRR_TYPE_UC || t == MTRR_TYPE_UC)
+            type = MTRR_TYPE_UC;
+        else if (type != t && (type == MTRR_TYPE_WT || type == MTRR_TYPE_WB) &&
+                 (t == MTRR_TYPE_WT || t == MTRR_TYPE_WB))
+            type = MTRR_TYPE_WT;
+        else if (type != t)
+            type = MTRR_TYPE_UC;
+        matched = 1;
+    }
+    return matched ? type : state->DefaultType;
+}
+
+/**
+    A PC with 3.5 GiB of RAM: WB below 2 GiB and from 2 GiB to 3 GiB with an
+    8 MB UC hole at its top, UC above, legacy VGA and ROM in the fixed ranges
+*/
+static void testTypicalLayout()
+{
+    MtrrState state;
+    uint32 i;
+    
+    mtrrInit(&state, TEST_CAP, TEST_DEF(MTRR_TYPE_UC), TEST_PHYS_BITS);
+    mtrrSetFixed(&state, 0, testFixedAll(MTRR_TYPE_WB));
+    mtrrSetFixed(&state, 1, testFixedAll(MTRR_TYPE_WB));
+    mtrrSetFixed(&state, 2, testFixedAll(MTRR_TYPE_UC));
+    for (i = 3; i < MTRR_NUM_FIXED_MSRS; i++)
+    {
+        mtrrSetFixed(&state, i, testFixedAll(MTRR_TYPE_WP));
+    }
+    testSetRange(&state, 0, 0, 2 * GB, MTRR_TYPE_WB);
+    testSetRange(&state, 1, 2 * GB, GB, MTRR_TYPE_WB);
+    testSetRange(&state, 2, 3 * GB - 8 * MB, 8 * MB, MTRR_TYPE_UC);
+    
+    TEST_CHECK(mtrrRangeType(&state, 0x9F000, 4 * KB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, 0xA0000, 4 * KB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 0xA0000, 128 * KB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 0xF0000, 64 * KB) == MTRR_TYPE_WP);
+    TEST_CHECK(mtrrRangeType(&state, 0x80000, 512 * KB) == MTRR_TYPE_MIXED);
+    TEST_CHECK(mtrrRangeType(&state, MTRR_FIXED_END, 4 * KB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, MTRR_FIXED_END, MB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, 0, 2 * MB) == MTRR_TYPE_MIXED);
+    TEST_CHECK(mtrrRangeType(&state, 2 * MB, 2 * MB) == MTRR_TYPE_WB);
+    
+    // Only the first GB (fixed ranges) and the third (the hole) need splitting
+    TEST_CHECK(mtrrRangeType(&state, 0, GB) == MTRR_TYPE_MIXED);
+    TEST_CHECK(mtrrRangeType(&state, GB, GB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, 2 * GB, GB) == MTRR_TYPE_MIXED);
+    TEST_CHECK(mtrrRangeType(&state, 3 * GB, GB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 4 * GB, GB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 3 * GB - 10 * MB, 2 * MB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, 3 * GB - 8 * MB, 2 * MB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 3 * GB - 8 * MB, 8 * MB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 3 * GB - 16 * MB, 16 * MB) == MTRR_TYPE_MIXED);
+    
+    // An unaligned base is taken as the block holding it
+    TEST_CHECK(mtrrRangeType(&state, 3 * GB + 0x1234, 2 * MB) == MTRR_TYPE_UC);
+}
+
+/**
+    Overlapping variable ranges: UC wins, WT wins over WB, anything else is UC
+*/
+static void testOverlaps()
+{
+    MtrrState state;
+    
+    mtrrInit(&state, TEST_CAP, TEST_DEF(MTRR_TYPE_WB), TEST_PHYS_BITS);
+    testSetRange(&state, 0, GB, GB, MTRR_TYPE_WB);
+    testSetRange(&state, 1, GB, 4 * MB, MTRR_TYPE_WT);
+    testSetRange(&state, 2, GB + 2 * MB, 2 * MB, MTRR_TYPE_UC);
+    testSetRange(&state, 3, GB + 8 * MB, 2 * MB, MTRR_TYPE_WC);
+    testSetRange(&state, 4, GB + 16 * MB, 2 * MB, MTRR_TYPE_WB);
+    
+    TEST_CHECK(mtrrRangeType(&state, GB, 2 * MB) == MTRR_TYPE_WT);
+    TEST_CHECK(mtrrRangeType(&state, GB + 2 * MB, 2 * MB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, GB + 8 * MB, 2 * MB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, GB + 16 * MB, 2 * MB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, GB + 16 * MB, 8 * MB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, GB, GB) == MTRR_TYPE_MIXED);
+    
+    // Ranges which are not valid are ignored
+    mtrrSetVariable(&state, 1, GB | MTRR_TYPE_UC, ~(GB - 1) & 0xFFFFFF000ULL);
+    TEST_CHECK(mtrrRangeType(&state, GB, 2 * MB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, 3 * GB, GB) == MTRR_TYPE_WB);
+}
+
+/**
+    Disabled MTRRs make everything UC, disabled fixed ranges leave the first
+    MB to the variable ranges
+*/
+static void testDisabled()
+{
+    MtrrState state;
+    
+    mtrrInit(&state, TEST_CAP, MTRR_TYPE_WB, TEST_PHYS_BITS);
+    TEST_CHECK(mtrrRangeType(&state, 0, GB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 5 * GB, 4 * KB) == MTRR_TYPE_UC);
+    
+    mtrrInit(&state, TEST_CAP, 0x800 | MTRR_TYPE_UC, TEST_PHYS_BITS);
+    mtrrSetFixed(&state, 2, testFixedAll(MTRR_TYPE_UC));
+    testSetRange(&state, 0, 0, 4 * GB, MTRR_TYPE_WB);
+    TEST_CHECK(!state.FixedEnabled);
+    TEST_CHECK(mtrrRangeType(&state, 0xA0000, 4 * KB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, GB, GB) == MTRR_TYPE_WB);
+    
+    // Fixed ranges enabled in DEF_TYPE but not reported by MTRRCAP
+    mtrrInit(&state, 0x08, TEST_DEF(MTRR_TYPE_WB), TEST_PHYS_BITS);
+    TEST_CHECK(!state.FixedEnabled);
+    TEST_CHECK(mtrrRangeType(&state, 0, 2 * MB) == MTRR_TYPE_WB);
+    
+    // Variable ranges past the count in MTRRCAP are ignored
+    mtrrInit(&state, 0x501, TEST_DEF(MTRR_TYPE_WB), TEST_PHYS_BITS);
+    testSetRange(&state, 1, 2 * GB, GB, MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 2 * GB, GB) == MTRR_TYPE_WB);
+}
+
+/**
+    A mask with a hole matches two separate 4 KB pages
+*/
+static void testSparseMask()
+{
+    MtrrState state;
+    uint64 mask = (((uint64) 1 << TEST_PHYS_BITS) - 1) & ~(uint64) 0xFFF & ~(uint64) 0x200000;
+    
+    mtrrInit(&state, TEST_CAP, TEST_DEF(MTRR_TYPE_WB), TEST_PHYS_BITS);
+    mtrrSetVariable(&state, 0, GB | MTRR_TYPE_UC, mask | 0x800);
+    
+    TEST_CHECK(mtrrRangeType(&state, GB, 4 * KB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, GB + 2 * MB, 4 * KB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, GB + 4 * KB, 4 * KB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, GB, 2 * MB) == MTRR_TYPE_MIXED);
+    TEST_CHECK(mtrrRangeType(&state, GB + 2 * MB, 2 * MB) == MTRR_TYPE_MIXED);
+    TEST_CHECK(mtrrRangeType(&state, GB + 4 * MB, 2 * MB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, GB, GB) == MTRR_TYPE_MIXED);
+    TEST_CHECK(mtrrRangeType(&state, 2 * GB, GB) == MTRR_TYPE_WB);
+}
+
+/**
+    A processor with a wider MAXPHYADDR than TEST_PHYS_BITS has ranges above
+    64 GiB, whose base and mask bits must not be cut off
+*/
+static void testWideAddress()
+{
+    MtrrState state;
+    uint64 mask = (((uint64) 1 << 39) - 1) & ~(GB - 1);
+    
+    mtrrInit(&state, TEST_CAP, TEST_DEF(MTRR_TYPE_WB), 39);
+    mtrrSetVariable(&state, 0, 64 * GB | MTRR_TYPE_UC, mask | 0x800);
+    
+    TEST_CHECK(mtrrRangeType(&state, 64 * GB, GB) == MTRR_TYPE_UC);
+    TEST_CHECK(mtrrRangeType(&state, 64 * GB + GB, GB) == MTRR_TYPE_WB);
+    TEST_CHECK(mtrrRangeType(&state, GB, GB) == MTRR_TYPE_WB);
+}
+
+/**
+    Fills state with a random configuration of aligned ranges below TEST_TOP
+*/
+static void testRandomConfig(MtrrState *state)
+{
+    static const uint8 types[5] = {MTRR_TYPE_UC, MTRR_TYPE_WC, MTRR_TYPE_WT,
+                                   MTRR_TYPE_WP, MTRR_TYPE_WB};
+    uint64 size;
+    uint32 i;
+    
+    mtrrInit(state, TEST_CAP, TEST_DEF(types[rand() % 5]), TEST_PHYS_BITS);
+    for (i = 0; i < MTRR_NUM_FIXED_MSRS; i++)
+    {
+        mtrrSetFixed(state, i, (rand() % 2) ? testFixedAll(types[rand() % 5]) :
+                               ((uint64) rand() << 32) ^ (uint64) rand());
+    }
+    for (i = 0; i < 8; i++)
+    {
+        if (rand() % 4 == 0)
+            continue;
+        size = (uint64) 4 * KB << (rand() % 20);
+        testSetRange(state, i, ((uint64) rand() % (TEST_TOP / size)) * size, size,
+                     types[rand() % 5]);
+    }
+}
+
+/**
+    Compares every 2 MB and 1 GB block of a configuration with the page by
+    page evaluation
+*/
+static void testAgainstPages(const MtrrState *state)
+{
+    uint64 base, addr;
+    uint8 expect, page, gbExpect = 0, got;
+    
+    for (base = 0; base < TEST_TOP; base += 2 * MB)
+    {
+        expect = testPageType(state, base);
+        for (addr = base + 4 * KB; addr < base + 2 * MB && expect != MTRR_TYPE_MIXED; addr += 4 * KB)
+        {
+            page = testPageType(state, addr);
+            if (page != expect)
+                expect = MTRR_TYPE_MIXED;
+        }
+        got = mtrrRangeType(state, base, 2 * MB);
+        if (got != expect)
+        {
+            printf("  2 MB block %llx: expected %x, got %x\n", (unsigned long long) base,
+                   expect, got);
+            testFailures++;
+            return;
+        }
+    
+        if ((base & (GB - 1)) == 0)
+            gbExpect = expect;
+        else if (gbExpect != expect)
+            gbExpect = MTRR_TYPE_MIXED;
+        if (((base + 2 * MB) & (GB - 1)) == 0)
+        {
+            got = mtrrRangeType(state, base & ~(GB - 1), GB);
+            if (got != gbExpect)
+            {
+                printf("  1 GB block %llx: expected %x, got %x\n",
+                       (unsigned long long) (base & ~(GB - 1)), gbExpect, got);
+                testFailures++;
+                return;
+            }
+        }
+    }
+}
+
+int main()
+{
+    MtrrState state;
+    uint32 i;
+    
+    testTypicalLayout();
+    testOverlaps();
+    testDisabled();
+    testSparseMask();
+    testWideAddress();
+    
+    srand(1234);
+    for (i = 0; i < TEST_RANDOM_CONFIGS; i++)
+    {
+        testRandomConfig(&state);
+        testAgainstPages(&state);
+    }
+    
+    return testResult("mtrr_test");
+}
@@ -0,0 +1,186 @@
+/**
+    Unit test for the target policy table
+    
+    Loads blobs with a few policies and with thousands, checks that names
+    match without regard to case and only on their first 14 characters,
+    that duplicates and invalid blobs are handled, and that lookups of
+    unknown names fail
+    
+    @file
+    
+    @authors Assured Information Security, Inc.
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "policy.h"
+#include "test.h"
+
+/** Number of policies in the large table */
+#define TEST_LARGE 3000
+
+/**
+    Writes a little endian 32-bit value
+*/
+static void testWrite32(uint8 *ptr, uint32 value)
+{
+    ptr[0] = (uint8) value;
+    ptr[1] = (uint8) (value >> 8);
+    ptr[2] = (uint8) (value >> 16);
+    ptr[3] = (uint8) (value >> 24);
+}
+
+/**
+    Allocates a blob with room for count entries and writes its header
+*/
+static uint8 * testNewBlob(uint32 count, uint32 *len)
+{
+    uint8 *blob;
+    
+    *len = sizeof(PolicyBlobHeader) + count * sizeof(PolicyBlobEntry);
+    blob = (uint8 *) calloc(1, *len);
+    testWrite32(blob, POLICY_MAGIC);
+    testWrite32(blob + 4, POLICY_VERSION);
+    testWrite32(blob + 8, count);
+    return blob;
+}
+
+/**
+    Writes entry i of a blob
+*/
+static void testSetEntry(uint8 *blob, uint32 i, const char *name, uint32 digest, uint32 options)
+{
+    uint8 *record = blob + sizeof(PolicyBlobHeader) + i * sizeof(PolicyBlobEntry);
+    
+    strncpy((char *) record, name, POLICY_NAME_LEN);
+    testWrite32(record + POLICY_NAME_LEN, digest);
+    testWrite32(record + POLICY_NAME_LEN + 4, options);
+}
+
+/**
+    Loads a blob into a table with freshly allocated storage
+*/
+static uint8 testLoad(PolicyTable *table, uint8 *blob, uint32 len, void **storage)
+{
+    uint32 count = policyBlobEntries(blob, len);
+    
+    *storage = malloc(policyStorageSize(count ? count : 1));
+    return policyLoad(table, blob, len, *storage, policyStorageSize(count));
+}
+
+static void testSmall()
+{
+    PolicyTable table;
+    const PolicyEntry *entry;
+    void *storage;
+    uint32 len;
+    uint8 *blob = testNewBlob(5, &len);
+    
+    printf("small table\n");
+    testSetEntry(blob, 0, "test.exe", 0x1234, POLICY_OPT_MEASURE);
+    testSetEntry(blob, 1, "Notepad.EXE", 0x5678, POLICY_OPT_VERIFY);
+    testSetEntry(blob, 2, "averyveryverylongname.exe", 0, 0);
+    testSetEntry(blob, 3, "TEST.exe", 0x9999, 0);
+    testSetEntry(blob, 4, "fifteenchars.ex", 0x4321, 0);
+    TEST_CHECK(testLoad(&table, blob, len, &storage));
+    TEST_CHECK(table.NumEntries == 4);
+    TEST_CHECK(table.Duplicates == 1);
+    
+    entry = policyLookup(&table, "test.exe");
+    TEST_CHECK(entry != NULL && entry->Digest == 0x1234 && entry->Options == POLICY_OPT_MEASURE);
+    entry = policyLookup(&table, "NOTEPAD.exe");
+    TEST_CHECK(entry != NULL && entry->Digest == 0x5678 && entry->Options == POLICY_OPT_VERIFY);
+    TEST_CHECK(entry != NULL && strcmp(entry->Name, "notepad.exe") == 0);
+    
+    // The kernel only keeps 14 characters of the image name
+    TEST_CHECK(policyLookup(&table, "averyveryveryl") != NULL);
+    TEST_CHECK(policyLookup(&table, "averyveryverylongname.exe") != NULL);
+    TEST_CHECK(policyLookup(&table, "averyveryveryx") == NULL);
+    entry = policyLookup(&table, "fifteenchars.e");
+    TEST_CHECK(entry != NULL && entry->Digest == 0x4321);
+    
+    TEST_CHECK(policyLookup(&table, "test.ex") == NULL);
+    TEST_CHECK(policyLookup(&table, "test.exe2") == NULL);
+    TEST_CHECK(policyLookup(&table, "") == NULL);
+    TEST_CHECK(policyLookup(&table, NULL) == NULL);
+    free(storage);
+    free(blob);
+}
+
+static void testInvalid()
+{
+    PolicyTable table;
+    uint32 storage[256];
+    uint32 len;
+    uint8 *blob = testNewBlob(2, &len);
+    
+    printf("invalid blobs\n");
+    testSetEntry(blob, 0, "a.exe", 0, 0);
+    testSetEntry(blob, 1, "b.exe", 0, 0);
+    TEST_CHECK(policyBlobEntries(blob, len) == 2);
+    TEST_CHECK(policyBlobEntries(blob, len - 1) == 0);
+    TEST_CHECK(policyBlobEntries(blob, sizeof(PolicyBlobHeader) - 1) == 0);
+    TEST_CHECK(policyBlobEntries(NULL, len) == 0);
+    TEST_CHECK(!policyLoad(&table, blob, len, storage, policyStorageSize(2) - 1));
+    TEST_CHECK(policyLookup(&table, "a.exe") == NULL);
+    
+    testWrite32(blob + 4, POLICY_VERSION + 1);
+    TEST_CHECK(policyBlobEntries(blob, len) == 0);
+    testWrite32(blob + 4, POLICY_VERSION);
+    testWrite32(blob, 0);
+    TEST_CHECK(policyBlobEntries(blob, len) == 0);
+    testWrite32(blob, POLICY_MAGIC);
+    testWrite32(blob + 8, POLICY_MAX_ENTRIES + 1);
+    TEST_CHECK(policyBlobEntries(blob, len) == 0);
+    testWrite32(blob + 8, 0);
+    TEST_CHECK(policyBlobEntries(blob, len) == 0);
+    testWrite32(blob + 8, 2);
+    TEST_CHECK(policyLoad(&table, blob, len, storage, sizeof(storage)));
+    TEST_CHECK(policyLookup(&table, "B.EXE") != NULL);
+    free(blob);
+}
+
+static void testLarge()
+{
+    PolicyTable table;
+    const PolicyEntry *entry;
+    void *storage;
+    char name[POLICY_NAME_LEN];
+    uint32 len, i, found = 0;
+    uint8 *blob = testNewBlob(TEST_LARGE, &len);
+    
+    printf("%d policies\n", TEST_LARGE);
+    for (i = 0; i < TEST_LARGE; i++)
+    {
+        sprintf(name, "img%05u.exe", i);
+        testSetEntry(blob, i, name, i, i & 3);
+    }
+    TEST_CHECK(testLoad(&table, blob, len, &storage));
+    TEST_CHECK(table.NumEntries == TEST_LARGE && table.Duplicates == 0);
+    for (i = 0; i < TEST_LARGE; i++)
+    {
+        sprintf(name, "IMG%05u.EXE", i);
+        entry = policyLookup(&table, name);
+        if (entry != NULL && entry->Digest == i && entry->Options == (i & 3))
+            found++;
+    }
+    TEST_CHECK(found == TEST_LARGE);
+    for (i = TEST_LARGE; i < 2 * TEST_LARGE; i++)
+    {
+        sprintf(name, "img%05u.exe", i);
+        if (policyLookup(&table, name) != NULL)
+            found++;
+    }
+    TEST_CHECK(found == TEST_LARGE);
+    free(storage);
+    free(blob);
+}
+
+int main()
+{
+    testSmall();
+    testInvalid();
+    testLarge();
+    return testResult("policy_test");
+}
@@ -0,0 +1,362 @@
+/**
+    Benchmark for the reverse physical to virtual map
+    
+    Builds synthetic 32-bit and PAE page tables, then finds every alias of a
+    set of frames with one full page table walk per frame and with one
+    reverse map build plus a batched lookup, and checks that both agree
+    
+    @file
+    
+    @authors Assured Information Security, Inc.
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rmap.h"
+
+/** Number of present page tables in the synthetic address space */
+#define BENCH_TABLES 512
+/** Number of large page PDEs in the synthetic address space */
+#define BENCH_LARGE_PAGES 32
+/** Number of frames in the synthetic machine (2 GiB) */
+#define BENCH_FRAMES 0x80000
+/** Number of frames in the synthetic PAE machine (64 GiB) */
+#define BENCH_PAE_FRAMES 0x1000000
+/** Default number of frames looked up */
+#define BENCH_QUERIES 256
+/** Number of timed repetitions of each method */
+#define BENCH_REPS 3
+/** Most aliases of a frame the walk records */
+#define BENCH_MAX_ALIASES 64
+
+/** Simulated physical memory holding the page directories and page tables */
+static uint32 *benchMemory;
+
+static uint8 * benchMapTable(void *context, uint64 phys)
+{
+    (void) context;
+    return (uint8 *) benchMemory + phys;
+}
+
+static double benchNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int benchCompareFrames(const void *a, const void *b)
+{
+    uint32 x = *(const uint32 *) a, y = *(const uint32 *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+    Returns the flags an alias has once the directory entry is applied
+*/
+static uint32 benchFlags(uint32 entry, uint32 dir)
+{
+    return entry & 0xFFF & (dir | ~(uint32) (RMAP_VA_WRITE | RMAP_VA_USER));
+}
+
+/**
+    Returns a random PTE flag combination, roughly three quarters present
+*/
+static uint32 benchPteFlags()
+{
+    return ((rand() % 4) ? 0x1 : 0) | (rand() & RMAP_VA_WRITE) | (rand() & RMAP_VA_USER);
+}
+
+/**
+    Builds a page directory at physical 0 and its page tables right after it
+*/
+static void benchBuildTables()
+{
+    uint32 *pd = benchMemory, *pt, i, j, pde, table = 1;
+    
+    // Spread the tables and large pages over the directory
+    for (i = 0; i < BENCH_TABLES + BENCH_LARGE_PAGES; i++)
+    {
+        do
+        {
+            pde = (uint32) rand() % RMAP_TABLE_ENTRIES;
+        } while (pd[pde] != 0);
+    
+        if (i < BENCH_LARGE_PAGES)
+        {
+            pd[pde] = (((uint32) rand() % (BENCH_FRAMES >> 10)) << 22) | 0x81 | benchPteFlags();
+            continue;
+        }
+        pd[pde] = (table << 12) | 0x1 | benchPteFlags();
+        pt = benchMemory + table * RMAP_TABLE_ENTRIES;
+        for (j = 0; j < RMAP_TABLE_ENTRIES; j++)
+        {
+            // Not-present entries keep stale frames
+            pt[j] = (((uint32) rand() % BENCH_FRAMES) << 12) | benchPteFlags();
+        }
+        table++;
+    }
+}
+
+/**
+    Finds every alias of pfn by walking all of the 32-bit page tables
+*/
+static uint32 benchWalk(uint32 pfn, uint32 *vas)
+{
+    uint32 *pd = benchMemory, *pt, i, j, n = 0;
+    
+    for (i = 0; i < RMAP_TABLE_ENTRIES; i++)
+    {
+        if (!(pd[i] & 1))
+            continue;
+        if (pd[i] & 0x80)
+        {
+            if (pfn >> 10 == pd[i] >> 22 && n < BENCH_MAX_ALIASES)
+                vas[n++] = (i << 22) | ((pfn & 0x3FF) << 12) | (pd[i] & 0xFFF);
+            continue;
+        }
+        pt = benchMemory + (pd[i] >> 12) * RMAP_TABLE_ENTRIES;
+        for (j = 0; j < RMAP_TABLE_ENTRIES; j++)
+        {
+            if ((pt[j] & 1) && pt[j] >> 12 == pfn && n < BENCH_MAX_ALIASES)
+                vas[n++] = (i << 22) | (j << 12) | benchFlags(pt[j], pd[i]);
+        }
+    }
+    return n;
+}
+
+/**
+    Builds a PDPT at physical 0, its four directories and their page tables,
+    only half of the directory entries are reachable from user mode
+*/
+static uint32 benchBuildPaeTables()
+{
+    uint32 *pd, *pt, i, j, k, pfn, table = 5, present = 0;
+    
+    for (i = 0; i < 4; i++)
+    {
+        benchMemory[2 * i] = ((1 + i) << 12) | 0x1;
+        pd = benchMemory + (1 + i) * RMAP_TABLE_ENTRIES;
+        for (j = 0; j < RMAP_PAE_ENTRIES; j += 4)
+        {
+            if (j % 64 == 0)
+            {
+                // 2 MiB page
+                pfn = ((uint32) rand() % (BENCH_PAE_FRAMES >> 9)) << 9;
+                pd[2 * j] = (pfn << 12) | 0x81 | benchPteFlags();
+                pd[2 * j + 1] = pfn >> 20;
+                continue;
+            }
+            pd[2 * j] = (table << 12) | 0x1 | benchPteFlags();
+            pt = benchMemory + table * RMAP_TABLE_ENTRIES;
+            for (k = 0; k < RMAP_PAE_ENTRIES; k++)
+            {
+                pfn = (uint32) rand() % BENCH_PAE_FRAMES;
+                pt[2 * k] = (pfn << 12) | benchPteFlags();
+                pt[2 * k + 1] = pfn >> 20;
+            }
+            table++;
+            present++;
+        }
+    }
+    return present;
+}
+
+/**
+    Finds every user alias of pfn by walking all of the PAE page tables
+*/
+static uint32 benchWalkPae(uint32 pfn, uint32 *vas)
+{
+    uint32 *pd, *pt, i, j, k, base, n = 0;
+    
+    for (i = 0; i < 4; i++)
+    {
+        pd = benchMemory + (benchMemory[2 * i] >> 12) * RMAP_TABLE_ENTRIES;
+        for (j = 0; j < RMAP_PAE_ENTRIES; j++)
+        {
+            if (!(pd[2 * j] & 1) || !(pd[2 * j] & RMAP_VA_USER))
+                continue;
+            if (pd[2 * j] & 0x80)
+            {
+                base = (pd[2 * j] >> 12) | (pd[2 * j + 1] << 20);
+                if (pfn - base < RMAP_PAE_ENTRIES && n < BENCH_MAX_ALIASES)
+                    vas[n++] = (i << 30) | (j << 21) | ((pfn - base) << 12) | (pd[2 * j] & 0xFFF);
+                continue;
+            }
+            pt = benchMemory + (pd[2 * j] >> 12) * RMAP_TABLE_ENTRIES;
+            for (k = 0; k < RMAP_PAE_ENTRIES; k++)
+            {
+                if ((pt[2 * k] & 1) && ((pt[2 * k] >> 12) | (pt[2 * k + 1] << 20)) == pfn &&
+                        n < BENCH_MAX_ALIASES)
+                    vas[n++] = (i << 30) | (j << 21) | (k << 12) | benchFlags(pt[2 * k], pd[2 * j]);
+            }
+        }
+    }
+    return n;
+}
+
+/**
+    Returns 0 if the map disagrees with the walk for any query
+*/
+static int benchCheck(ReverseMap *map, uint32 *queries, uint32 numQueries,
+                      uint32 *first, uint32 *count, uint8 pae)
+{
+    uint32 i, j, n, vas[BENCH_MAX_ALIASES];
+    
+    for (i = 0; i < numQueries; i++)
+    {
+        n = pae ? benchWalkPae(queries[i], vas) : benchWalk(queries[i], vas);
+        if (n != count[i])
+        {
+            printf("frame %x: walk found %u aliases, map %u\n", queries[i], n, count[i]);
+            return 0;
+        }
+        for (j = 0; j < n; j++)
+        {
+            if (map->Entries[first[i] + j].Va != vas[j])
+            {
+                printf("frame %x: alias %u differs\n", queries[i], j);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+    Picks frames mapped by the page tables, sorted like a target's frames would be
+*/
+static void benchPickQueries(uint32 *queries, uint32 numQueries, uint32 firstTable,
+                             uint32 numTables, uint8 pae)
+{
+    uint32 i, *pt, k;
+    
+    for (i = 0; i < numQueries; i++)
+    {
+        pt = benchMemory + (firstTable + i % numTables) * RMAP_TABLE_ENTRIES;
+        k = (uint32) rand() % RMAP_PAE_ENTRIES;
+        queries[i] = pae ? (pt[2 * k] >> 12) | (pt[2 * k + 1] << 20) : pt[k] >> 12;
+    }
+    qsort(queries, numQueries, sizeof(uint32), benchCompareFrames);
+}
+
+int main(int argc, char **argv)
+{
+    uint32 numQueries = (argc > 1) ? (uint32) atoi(argv[1]) : BENCH_QUERIES;
+    uint32 *queries, *first, *count, i, rep, vas[BENCH_MAX_ALIASES], total = 0, maxEntries;
+    uint32 pass, paeTables, tables = 1 + BENCH_TABLES;
+    RmapEntry *storage;
+    ReverseMap map;
+    double start, walkTime, buildTime[2] = {0}, scanTime[2] = {0};
+    const char *names[2] = {"scalar", "sse2"};
+    
+    srand(1234);
+    benchMemory = (uint32 *) calloc(tables, 4096);
+    queries = (uint32 *) malloc(numQueries * sizeof(uint32));
+    first = (uint32 *) malloc(numQueries * sizeof(uint32));
+    count = (uint32 *) malloc(numQueries * sizeof(uint32));
+    maxEntries = (BENCH_TABLES + BENCH_LARGE_PAGES) * RMAP_TABLE_ENTRIES;
+    storage = (RmapEntry *) malloc(maxEntries * sizeof(RmapEntry));
+    if (benchMemory == NULL || queries == NULL || first == NULL || count == NULL ||
+            storage == NULL)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+    benchBuildTables();
+    benchPickQueries(queries, numQueries, 1, BENCH_TABLES, 0);
+    printf("%u page tables, %u large pages, %u frames queried\n",
+           BENCH_TABLES, BENCH_LARGE_PAGES, numQueries);
+    
+    // One full walk per frame
+    start = benchNow();
+    for (i = 0; i < numQueries; i++)
+    {
+        total += benchWalk(queries[i], vas);
+    }
+    walkTime = benchNow() - start;
+    printf("  walk per frame:         %9.3f ms  %u aliases\n", walkTime * 1e3, total);
+    
+    for (pass = 0; pass < 2; pass++)
+    {
+#ifndef RMAP_SSE2
+        if (pass == 1)
+            break;
+#endif
+        rmapInit(&map, storage, maxEntries, queries[0], queries[numQueries - 1] + 1,
+                 pass ? RMAP_FLAG_SIMD : 0);
+        for (rep = 0; rep < BENCH_REPS; rep++)
+        {
+            start = benchNow();
+            rmapBuild(&map, 0, benchMapTable, NULL, NULL);
+            rmapLookupBatch(&map, queries, numQueries, first, count);
+            buildTime[pass] += benchNow() - start;
+        }
+        buildTime[pass] /= BENCH_REPS;
+        if (!benchCheck(&map, queries, numQueries, first, count, 0) || map.Dropped != 0)
+        {
+            printf("reverse map (%s) does not match the walk\n", names[pass]);
+            return 1;
+        }
+        printf("  reverse map (%-6s):   %9.3f ms  %u entries  speedup %.1fx\n", names[pass],
+               buildTime[pass] * 1e3, map.NumEntries, walkTime / buildTime[pass]);
+    }
+    
+    // The compare kernel alone, over a narrow range as for a single image
+    for (pass = 0; pass < 2; pass++)
+    {
+        start = benchNow();
+        for (rep = 0; rep < 100; rep++)
+        {
+            for (i = 1; i <= BENCH_TABLES; i++)
+            {
+#ifdef RMAP_SSE2
+                if (pass == 1)
+                    total += rmapScanTableSse2(benchMemory + i * RMAP_TABLE_ENTRIES,
+                                               0x1000, 0x1400, map.Matches);
+                else
+#endif
+                    total += rmapScanTableScalar(benchMemory + i * RMAP_TABLE_ENTRIES,
+                                                 0x1000, 0x1400, map.Matches);
+            }
+        }
+        scanTime[pass] = (benchNow() - start) / 100;
+        printf("  compare kernel (%-6s): %8.3f ms per %u tables\n", names[pass],
+               scanTime[pass] * 1e3, BENCH_TABLES);
+#ifndef RMAP_SSE2
+        break;
+#endif
+    }
+    
+    // PAE tables, with frames above 4 GiB and only the user half indexed
+    memset(benchMemory, 0, tables * 4096);
+    paeTables = benchBuildPaeTables();
+    benchPickQueries(queries, numQueries, 5, paeTables, 1);
+    for (pass = 0; pass < 2; pass++)
+    {
+#ifndef RMAP_SSE2
+        if (pass == 1)
+            break;
+#endif
+        rmapInit(&map, storage, maxEntries, queries[0], queries[numQueries - 1] + 1,
+                 RMAP_FLAG_PAE | RMAP_FLAG_USER | (pass ? RMAP_FLAG_SIMD : 0));
+        rmapBuild(&map, 0, benchMapTable, NULL, NULL);
+        rmapLookupBatch(&map, queries, numQueries, first, count);
+        if (!benchCheck(&map, queries, numQueries, first, count, 1) || map.Dropped != 0)
+        {
+            printf("PAE reverse map (%s) does not match the walk\n", names[pass]);
+            return 1;
+        }
+        printf("  PAE reverse map (%-6s): %u tables, %u entries match the walk\n",
+               names[pass], map.TablesScanned, map.NumEntries);
+    }
+    
+    free(storage);
+    free(count);
+    free(first);
+    free(queries);
+    free(benchMemory);
+    return 0;
+}
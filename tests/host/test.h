@@ -0,0 +1,48 @@
+/**
+    Harness shared by the host unit tests
+    
+    Counts failed checks instead of stopping at the first one, so a run
+    reports every check which failed
+    
+    @file
+    
+    @authors Assured Information Security, Inc.
+************************************************************************/
+
+#ifndef _MORE_TEST_H_
+#define _MORE_TEST_H_
+
+#include <stdio.h>
+
+/** Number of checks which failed so far */
+static int testFailures;
+
+/** Records a failure, with its line, if cond does not hold */
+#define TEST_CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            printf("  FAILED line %d: %s\n", __LINE__, #cond); \
+            testFailures++; \
+        } \
+    } while (0)
+
+/**
+    Prints the outcome of a test program
+    
+    @param name Name of the test program
+    @return Exit code of the test program
+*/
+static int testResult(const char *name)
+{
+    if (testFailures != 0)
+    {
+        printf("%s: %d failures\n", name, testFailures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
+
+#endif // _MORE_TEST_H_
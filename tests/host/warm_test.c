@@ -0,0 +1,158 @@
+/**
+    Unit test for the split setup cache
+    
+    Finds an image only under its full identity, keeps the results stored
+    for an image across stores of the same image, replaces the least
+    recently used image once the cache is full and checks that the digests
+    tell apart buffers and frame lists which differ
+    
+    @file
+    
+    @authors Assured Information Security, Inc.
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "warm.h"
+#include "test.h"
+
+/** Entries in the cache of the test */
+#define TEST_ENTRIES 4
+
+/**
+    Returns the key of a synthetic image
+*/
+static WarmKey testKey(uint32 image)
+{
+    WarmKey key;
+    
+    key.NameHash = 0x1000 + image;
+    key.TimeDateStamp = 0x4F000000;
+    key.HeaderDigest = 0xABCD0000 | image;
+    key.ImageBase = 0x400000;
+    key.SizeOfImage = 0x20000;
+    return key;
+}
+
+static void testIdentity()
+{
+    WarmCache cache;
+    WarmEntry entries[TEST_ENTRIES], *entry;
+    WarmKey key = testKey(1), other;
+    
+    printf("identity\n");
+    warmInit(&cache, entries, TEST_ENTRIES);
+    TEST_CHECK(warmLookup(&cache, &key) == NULL);
+    entry = warmStore(&cache, &key);
+    TEST_CHECK(entry != NULL && entry->Flags == 0 && entry->Used);
+    entry->Flags = WARM_FLAG_VERIFIED;
+    entry->Digest = 0x1234;
+    entry->FrameDigest = 0x5678;
+    
+    // A relaunch of the image finds what was stored, storing again keeps it
+    TEST_CHECK(warmLookup(&cache, &key) == entry);
+    TEST_CHECK(warmStore(&cache, &key) == entry && entry->Digest == 0x1234 &&
+               entry->Flags == WARM_FLAG_VERIFIED);
+    
+    // Any part of the identity which differs is another image
+    other = key;
+    other.TimeDateStamp++;
+    TEST_CHECK(warmLookup(&cache, &other) == NULL);
+    other = key;
+    other.HeaderDigest ^= 1;
+    TEST_CHECK(warmLookup(&cache, &other) == NULL);
+    other = key;
+    other.ImageBase = 0x1000000;
+    TEST_CHECK(warmLookup(&cache, &other) == NULL);
+    other = key;
+    other.SizeOfImage += 0x1000;
+    TEST_CHECK(warmLookup(&cache, &other) == NULL);
+    other = key;
+    other.NameHash = 0;
+    TEST_CHECK(warmLookup(&cache, &other) == NULL);
+    TEST_CHECK(cache.Hits == 1 && cache.Misses == 6);
+}
+
+static void testEviction()
+{
+    WarmCache cache;
+    WarmEntry entries[TEST_ENTRIES], *entry;
+    WarmKey key;
+    uint32 i;
+    
+    printf("eviction\n");
+    warmInit(&cache, entries, TEST_ENTRIES);
+    for (i = 0; i < TEST_ENTRIES; i++)
+    {
+        key = testKey(i);
+        entry = warmStore(&cache, &key);
+        entry->Digest = i;
+    }
+    TEST_CHECK(cache.Evictions == 0);
+    
+    // Image 0 was used last, so image 1 makes room for the new one
+    key = testKey(0);
+    TEST_CHECK(warmLookup(&cache, &key) != NULL);
+    key = testKey(TEST_ENTRIES);
+    entry = warmStore(&cache, &key);
+    TEST_CHECK(entry != NULL && entry->Digest == 0 && entry->Flags == 0);
+    TEST_CHECK(cache.Evictions == 1);
+    key = testKey(1);
+    TEST_CHECK(warmLookup(&cache, &key) == NULL);
+    for (i = 0; i <= TEST_ENTRIES; i++)
+    {
+        key = testKey(i);
+        entry = warmLookup(&cache, &key);
+        TEST_CHECK((entry != NULL) == (i != 1));
+        TEST_CHECK(entry == NULL || i == TEST_ENTRIES || entry->Digest == i);
+    }
+    
+    // A cache without entries stores nothing
+    warmInit(&cache, entries, 0);
+    TEST_CHECK(warmStore(&cache, &key) == NULL && warmLookup(&cache, &key) == NULL);
+}
+
+static void testDigests()
+{
+    uint32 page[1024], frames[64], digest, i, same = 0;
+    
+    printf("digests\n");
+    for (i = 0; i < 1024; i++)
+    {
+        page[i] = (uint32) rand();
+    }
+    digest = warmDigestBuffer((const uint8 *) page, sizeof(page));
+    TEST_CHECK(digest == warmDigestBuffer((const uint8 *) page, sizeof(page)));
+    for (i = 0; i < 1024; i += 37)
+    {
+        page[i] ^= 1 << (i % 32);
+        same += (warmDigestBuffer((const uint8 *) page, sizeof(page)) == digest);
+        page[i] ^= 1 << (i % 32);
+    }
+    TEST_CHECK(same == 0);
+    
+    // The same frames in another order are other frames
+    for (i = 0; i < 64; i++)
+    {
+        frames[i] = 0x1000 + i;
+    }
+    digest = WARM_DIGEST_INIT;
+    for (i = 0; i < 64; i++)
+    {
+        digest = warmDigestAdd(digest, frames[i]);
+    }
+    TEST_CHECK(digest == warmDigestBuffer((const uint8 *) frames, sizeof(frames)));
+    frames[3] = 0x1004;
+    frames[4] = 0x1003;
+    TEST_CHECK(digest != warmDigestBuffer((const uint8 *) frames, sizeof(frames)));
+}
+
+int main()
+{
+    srand(1234);
+    testIdentity();
+    testEviction();
+    testDigests();
+    return testResult("warm_test");
+}
@@ -1,634 +1,1189 @@
-/**
-	@file
-	Code for handling EPT translations in a hypervisor
-		
-	@date 1/17/2012
-***************************************************************/
-
-#include "Ntifs.h"
-#include "Wdm.h"
-#include "ntddk.h"
-#include "..\pe.h"
-#include "procmon.h"
-#include "ept.h"
-#include "..\stack.h"
-#include "..\paging.h"
-#include "hypervisor_loader.h"
-#include "hypervisor.h"
-
-/** Number of EPT PDE pages to allocate, one per GB of memory */
-#define NUM_PD_PAGES 4
-/** Maximum number of EPT page tables */ 
-#define NUM_TABLES 512
-
-/** Pointer to the 512 PDPTEs covering the first 512GB of memory */
-EptPdpteEntry *BkupPdptePtr = NULL;
-/** Array of pointers to free for the PDEs */
-EptPdeEntry2Mb *BkupPdePtrs[NUM_PD_PAGES] = {0};
-uint32 EptPageTableCounter = 0, TableVirtsCounter = 0, ViolationExits = 0, 
-                        ExecExits = 0, DataExits = 0, Thrashes = 0, Thrash = 0;
-EptPteEntry *EptTableArray[NUM_TABLES] = {0};
-EptPteEntry *EptTableVirts[NUM_TABLES] = {0};
-TlbTranslation *splitPages = NULL;
-uint8 ProcessorSupportsType0InvVpid = 0;
-/** Stack to store faulting addresses for TLB split */
-Stack pteStack = {0};
-PagingContext memContext = {0};
-
-void EnableEpt(uint32 Pml4Ptr)
-{
-    uint32 reg = ReadVMCS(SECONDARY_VM_EXEC_CONTROL);
-    EptTablePointer EPTP = {0};
-    PHYSICAL_ADDRESS phys = MmGetPhysicalAddress((void *) Pml4Ptr);
-    
-    // Set up the EPTP
-    EPTP.Bits.PhysAddr = phys.LowPart >> 12;
-    EPTP.Bits.PageWalkLength = 3;
-    WriteVMCS(EPT_POINTER, EPTP.unsignedVal & 0xFFFFFFFF);
-    WriteVMCS(EPT_POINTER_HIGH, 0);
-    
-    // Set the guest VPID to a non-zero value
-    WriteVMCS(VIRTUAL_PROCESSOR_ID, VM_VPID);
-    
-    // Enable the secondary controls VMCS field
-    WriteVMCS(SECONDARY_VM_EXEC_CONTROL, reg | (1 << 5) | (1 << 1) );
-    reg = ReadVMCS(CPU_BASED_VM_EXEC_CONTROL);
-    WriteVMCS(CPU_BASED_VM_EXEC_CONTROL, reg | (1 << 31));
-    InvVpidAllContext();
-}
-
-void DisableEpt()
-{
-    uint32 reg = ReadVMCS(SECONDARY_VM_EXEC_CONTROL);
-    WriteVMCS(SECONDARY_VM_EXEC_CONTROL, reg & ~((1 << 5) | (1 << 1)));
-    
-    // Clear out the EPTP
-    WriteVMCS(EPT_POINTER, 0);
-    WriteVMCS(EPT_POINTER_HIGH, 0);
-}
-
-EptPml4Entry * InitEptIdentityMap()
-{
-    EptPml4Entry *pml4Ptr = NULL;
-    EptPdpteEntry *pdptePtr = NULL;
-    PHYSICAL_ADDRESS phys = {0}, Highest = {0}, Lowest = {0};
-    uint32 i, j, pdeCounter = 0;
-    
-    Highest.LowPart = ~0;
-    
-    // Allocate contiguous, un-cached memory
-    pml4Ptr = (EptPml4Entry *) MmAllocateContiguousMemorySpecifyCache(
-                                                    sizeof(EptPml4Entry) * 512, 
-                                                    Lowest, 
-                                                    Highest, 
-                                                    Lowest, 
-                                                    0);
-    
-    if (pml4Ptr == NULL)
-    {
-        return NULL;
-    }
-    
-    pdptePtr = (EptPdpteEntry *) MmAllocateContiguousMemorySpecifyCache(
-                                                    sizeof(EptPdpteEntry) * 512, 
-                                                    Lowest, 
-                                                    Highest, 
-                                                    Lowest, 
-                                                    0);
-    // Save a copy of the virtual address for later freeing
-    BkupPdptePtr = pdptePtr;
-    if (pdptePtr == NULL)
-    {
-        MmFreeContiguousMemory(pml4Ptr);
-        return NULL;
-    }
-    
-    for (i = 0; i < NUM_PD_PAGES; i++)
-    {
-        BkupPdePtrs[i] = (EptPdeEntry2Mb *) MmAllocateContiguousMemorySpecifyCache(
-                                                sizeof(EptPdeEntry2Mb) * 512, 
-                                                Lowest, 
-                                                Highest, 
-                                                Lowest, 
-                                                0);
-        
-        // Free memory if we fail to allocate the next chunk
-        if (BkupPdePtrs[i] != NULL)
-        {
-            RtlZeroMemory((void *) BkupPdePtrs[i], sizeof(EptPdeEntry2Mb) * 512);
-        } 
-        else
-        {
-            MmFreeContiguousMemory(pml4Ptr);
-            MmFreeContiguousMemory(pdptePtr);
-            for (j = 0; j < i; j++)
-            {
-                MmFreeContiguousMemory(BkupPdePtrs[j]);
-            }
-            return NULL;
-        }
-    }
-    
-    phys = MmGetPhysicalAddress((void *) pdptePtr);
-    
-    // Zero out the pages
-    RtlZeroMemory((void *) pml4Ptr, sizeof(EptPml4Entry) * 512);
-    RtlZeroMemory((void *) pdptePtr, sizeof(EptPdpteEntry) * 512);
-    
-    // Populate our newly created EPT tables!
-    // Only need the first PML4 Entry unless we have more than 512 GB of RAM
-    pml4Ptr->Present = 1;
-    pml4Ptr->Write = 1;
-    pml4Ptr->Execute = 1;
-    pml4Ptr->PhysAddr = phys.LowPart >> 12;
-    
-    // Establish an identity map
-    for (i = 0; i < NUM_PD_PAGES; i++)
-    {
-        phys = MmGetPhysicalAddress((void *) BkupPdePtrs[i]);
-        pdptePtr[i].Present = 1;
-        pdptePtr[i].Write = 1;
-        pdptePtr[i].Execute = 1;
-        pdptePtr[i].PhysAddr = phys.LowPart >> 12;
-        
-        // Populate our 4GBs worth of PDEs
-        for (j = 0; j < 512; j++)
-        {
-            BkupPdePtrs[i][j].Present = 1;
-            BkupPdePtrs[i][j].Write = 1;
-            BkupPdePtrs[i][j].MemoryType = EPT_MEMORY_TYPE_WB;
-            BkupPdePtrs[i][j].Execute = 1;
-            BkupPdePtrs[i][j].Size = 1;
-            BkupPdePtrs[i][j].PhysAddr = pdeCounter;
-            pdeCounter++;
-        }
-    }
-    
-    return pml4Ptr;
-}
-
-void FreeEptIdentityMap(EptPml4Entry * ptr)
-{
-    uint32 i;
-    if (BkupPdptePtr != NULL) MmFreeContiguousMemory((void *) BkupPdptePtr);
-    if (ptr != NULL) MmFreeContiguousMemory((void *) ptr);
-
-    for (i = 0; i < NUM_PD_PAGES; i++)
-    {
-        if (NULL != BkupPdePtrs[i])
-            MmFreeContiguousMemory(BkupPdePtrs[i]);
-    }
-
-    for (i = 0; i < EptPageTableCounter; i++)
-    {
-        if (NULL != (void *) EptTableArray[i])
-            MmFreeContiguousMemory((void *) EptTableArray[i]);
-    }
-}
-
-EptPteEntry * EptMapAddressToPte(uint32 guestPhysicalAddress, EptPml4Entry * pml4Ptr)
-{
-    return EptMapAddressToPteDirql(guestPhysicalAddress, pml4Ptr, NULL);
-}
-
-uint8 EptPtExists(uint32 guestPhysicalAddress)
-{
-    uint32 pdpteOff = ((guestPhysicalAddress >> 30) & 0x3),
-              pdeOff = ((guestPhysicalAddress >> 21) & 0x1FF);
-    EptPdeEntry2Mb *pde = NULL;
-    
-    // Map in correct PDE
-    pde = BkupPdePtrs[pdpteOff];
-    
-    // Determine if this is mapping a large 2MB page or points to a page table    
-    return !(pde[pdeOff].Size);
-}
-
-EptPteEntry * EptMapAddressToPteDirql(uint32 guestPhysicalAddress, 
-                                      EptPml4Entry * pml4Ptr, 
-                                      PagingContext * context)
-{
-    uint32 i, pdpteOff = ((guestPhysicalAddress >> 30) & 0x3),
-              pdeOff = ((guestPhysicalAddress >> 21) & 0x1FF), 
-              pteOff = ((guestPhysicalAddress >> 12) & 0x1FF);
-    EptPdeEntry2Mb *pde = NULL;
-    EptPdpteEntry *pdpte = NULL;
-    EptPteEntry *retVal = NULL, *pageTable = NULL;
-    PHYSICAL_ADDRESS phys = {0};
-    
-    // Map in correct PDE
-    pde = BkupPdePtrs[pdpteOff];
-    
-    // Determine if this is mapping a large 2MB page or points to a page table    
-    if (pde[pdeOff].Size == 1)
-    {
-        // Need to allocate a page table which replaces the 2MB PDE
-        phys.LowPart = ~0;
-        if (context == NULL)
-            pageTable = (EptPteEntry *) MmAllocateContiguousMemory(
-                                                sizeof(EptPteEntry) * 512, phys);
-        else
-            pageTable = (EptPteEntry *) pagingAllocPage(context);
-                
-        if (pageTable == NULL)
-        {
-            goto abort;
-        }
-        // Zero out the new page table
-        RtlZeroMemory((void *) pageTable, sizeof(EptPteEntry) * 512);
-        
-        // Populate the page table
-        for (i = 0; i < 512; i++)
-        {
-            pageTable[i].Present = 1;
-            pageTable[i].Write = 1;
-            pageTable[i].MemoryType = EPT_MEMORY_TYPE_WB;
-            pageTable[i].Execute = 1;
-            pageTable[i].PhysAddr = (((pde[pdeOff].PhysAddr << 21) & 0xFFFFFFFF) >> 12) + i;
-        }
-        
-        pde[pdeOff].Size = 0;
-        pde[pdeOff].IgnorePat = 0;
-        pde[pdeOff].MemoryType = 0;
-        
-        phys = MmGetPhysicalAddress((void *) pageTable);
-        ((EptPdeEntry *) pde)[pdeOff].PhysAddr = phys.LowPart >> 12;      
-        
-        EptTableVirts[TableVirtsCounter] = pageTable;
-        TableVirtsCounter++;
-        
-        if (context == NULL)
-        {
-            EptTableArray[EptPageTableCounter] = pageTable;
-            EptPageTableCounter++;
-        }  
-        
-        return &pageTable[pteOff];
-    }
-
-    // Map in existing PTE to return
-    for (i = 0; i < TableVirtsCounter; i++)
-    {
-        if (EptTableVirts[i][0].PhysAddr << 12 <= guestPhysicalAddress &&
-                    EptTableVirts[i][511].PhysAddr << 12 >= guestPhysicalAddress)
-        {
-            return &EptTableVirts[i][pteOff];
-        }
-    }
-    
-    
-  abort:
-    return retVal;
-}
-
-void EptUnmapPte(EptPteEntry * ptr)
-{
-    EptUnmapPteDirql(ptr, NULL);
-}
-
-void EptUnmapPteDirql(EptPteEntry * ptr, PagingContext * context)
-{
-    if (ptr == NULL)
-        return;
-    MapOutMemory(context, (void *) ptr, sizeof(EptPteEntry));
-}
-
-void MapOutMemory(PagingContext * context, void * ptr, uint32 size)
-{
-    if (context == NULL)
-        MmUnmapIoSpace(ptr, size);
-}
-
-void * MapInMemory(PagingContext * context, PHYSICAL_ADDRESS phys, uint32 size)
-{
-    return MmMapIoSpace(phys, size, 0);
-}
-
-void SetTrapFlag(uint8 value)
-{
-    uint32 eflags = ReadVMCS(GUEST_RFLAGS);
-    if (value == 1)
-    {
-        WriteVMCS(GUEST_RFLAGS, eflags | (1 << 8));
-    }
-    else
-    {
-        WriteVMCS(GUEST_RFLAGS, eflags & ~(1 << 8));
-    }
-}
-
-void exit_reason_dispatch_handler__exec_trap(struct GUEST_STATE * GuestSTATE)
-{
-    EptPteEntry *pteptr = NULL;
-    TlbTranslation *translationPtr = NULL;
-    // Check to see if this is a trap caused by the TLB splitting
-    if (!StackIsEmpty(&pteStack))
-    {
-        translationPtr = (TlbTranslation *) StackPop(&pteStack);
-        if (translationPtr != NULL)
-            pteptr = translationPtr->EptPte;
-            
-        // Mark everything non-present
-        if (pteptr != NULL)
-        {
-            pteptr->Present = 0;
-            pteptr->Write = 0;
-            pteptr->Execute = 0;
-        }
-        SetTrapFlag(0);
-        if (Thrash)
-        {
-            InvVpidIndividualAddress(VM_VPID, translationPtr->VirtualAddress);
-            if (StackPeek(&pteStack) == translationPtr)
-            {
-                StackPop(&pteStack);
-            }
-            else
-            {
-                translationPtr = (TlbTranslation *) StackPop(&pteStack);
-                pteptr = translationPtr->EptPte;
-                pteptr->Present = 0;
-                pteptr->Write = 0;
-                pteptr->Execute = 0;
-                InvVpidIndividualAddress(VM_VPID, translationPtr->VirtualAddress);
-            }
-            Thrash = 0;
-            //InvVpidAllContext();
-        }
-    }
-    else
-    {
-        // @todo Re-inject this interrupt into the guest
-        Beep(1);
-        __asm
-        {
-            CLI
-            HLT
-        }
-    }
-}
-
-void exit_reason_dispatch_handler__exec_ept(struct GUEST_STATE * GuestSTATE)
-{
-    uint32 guestPhysical = (ReadVMCS(GUEST_PHYSICAL_ADDRESS)),
-           exitQualification = ReadVMCS(EXIT_QUALIFICATION),
-           guestLinear = ReadVMCS(GUEST_LINEAR_ADDRESS); 
-    EptPteEntry *pteptr = NULL;       
-    TlbTranslation *translationPtr = getTlbTranslation(splitPages, guestPhysical);
-    
-    // This is a bad sign, it means that it cannot find the proper translation
-    if (translationPtr == NULL)
-    {
-        end_split(splitPages);
-        return;
-    }
-    
-    // @todo Determine the root cause of the stack overflowing
-    // Ensure that there is space on the stack
-    if (StackIsFull(&pteStack))
-        DbgPrint("Overflow!\r\n");
-      
-    // Get the faulting EPT PTE
-    pteptr = translationPtr->EptPte;
-    if (pteptr != NULL && pteptr->Present == 1 && pteptr->Execute == 1)
-    {
-        return;   
-    }
-    
-    if (!StackIsEmpty(&pteStack) && (void *) translationPtr != StackPeek(&pteStack))
-    {
-        ((TlbTranslation *) StackPeek(&pteStack))->EptPte->Present = 1;
-        ((TlbTranslation *) StackPeek(&pteStack))->EptPte->Write = 1;
-        ((TlbTranslation *) StackPeek(&pteStack))->EptPte->Execute = 1;
-    }
-    StackPush(&pteStack, (void *) translationPtr);
-    ViolationExits++;
-    
-    /*if (exitQualification & EPT_MASK_GUEST_LINEAR_VALID)
-    {
-        Log("Guest Linear Address", guestLinear);
-        Log("Guest Physical", guestPhysical);
-        Log("Guest EIP", GuestSTATE->GuestEIP);
-        Log("----------------------------", 0);
-    }*/
-    
-    if (StackNumEntries(&pteStack) >= 2) // Thrashing
-    {
-        PHYSICAL_ADDRESS phys = {0};
-        uint8 *dataPtr, *codePtr;
-        
-        // Check to ensure there has been no instruction corruption
-        if (KeGetCurrentIrql() <= DISPATCH_LEVEL)
-        {
-            phys.LowPart = translationPtr->DataPhys;
-            dataPtr = (uint8 *) MmMapIoSpace(phys, PAGE_SIZE, 0);
-            phys.LowPart = translationPtr->CodePhys;
-            codePtr = (uint8 *) MmMapIoSpace(phys, PAGE_SIZE, 0);
-            if (0 != memcmp(dataPtr + (GuestSTATE->GuestEIP & 0xFFF),
-                            codePtr + (GuestSTATE->GuestEIP & 0xFFF), 
-                            ReadVMCS(VM_EXIT_INSTRUCTION_LEN)))
-            {
-                memcpy(dataPtr + (GuestSTATE->GuestEIP & 0xFFF),
-                        codePtr + (GuestSTATE->GuestEIP & 0xFFF), 
-                        ReadVMCS(VM_EXIT_INSTRUCTION_LEN));
-            }    
-            MmUnmapIoSpace(dataPtr, PAGE_SIZE);
-            MmUnmapIoSpace(codePtr, PAGE_SIZE);
-        }
-        else
-        {
-            //Beep(1);
-        }
-        Thrash = 1;
-        Thrashes++;
-        
-        pteptr->PhysAddr = translationPtr->DataPhys >> 12;
-        pteptr->Execute = 1;
-        pteptr->Present = 1;
-        pteptr->Write = 1;
-    }
-    else
-    {
-        if (exitQualification & EPT_MASK_DATA_EXEC) // Execute access
-        {
-            ExecExits++;
-            pteptr->PhysAddr = translationPtr->CodePhys >> 12;
-            //pteptr->PhysAddr = translationPtr->DataPhys >> 12;
-            pteptr->Execute = 1;
-        }
-        else if (exitQualification & EPT_MASK_DATA_READ || 
-                    exitQualification & EPT_MASK_DATA_WRITE) // Data access
-        {
-            DataExits++;
-            pteptr->PhysAddr = translationPtr->DataPhys >> 12;
-            //pteptr->PhysAddr = translationPtr->CodePhys >> 12;
-            pteptr->Present = 1;
-            pteptr->Write = 1;
-        }
-        else
-        {
-            // Violation that is neither data access nor instruction fetch
-            //Beep(1);
-            __asm
-            {
-                CLI
-                HLT
-            }
-        }   
-    }
-    // Set the trap flag to force another VMEXIT to the trap handler
-    SetTrapFlag(1);
-    //InvEptAllContext();
-    //InvVpidAllContext();
-}
-
-void init_split(TlbTranslation * arrPtr)
-{
-    uint32 i = 0;
-    EptPteEntry *pte = NULL;
-    
-    // (Re)initialize counters and the stack
-    splitPages = arrPtr;
-    StackInitStack(&pteStack);
-    
-    ViolationExits = 0;
-    DataExits = 0;
-    ExecExits = 0;
-    Thrashes = 0;
-    Thrash = 0;
-#ifdef SPLIT_TLB
-    Log("Initializing TLB split", 0);
-    // For all the defined target pages
-    while(arrPtr[i].DataPhys != 0 && i < appsize / PAGE_SIZE)
-    {
-        // Determine which guest physical address is the one to be marked non-present 
-        if (arrPtr[i].CodeOrData == CODE_EPT)
-        {
-            pte = EptMapAddressToPte(arrPtr[i].CodePhys, NULL);
-        }
-        else
-        {
-            pte = EptMapAddressToPte(arrPtr[i].DataPhys, NULL);
-        }
-        pte->Present = 0;
-        pte->Write = 0;
-        pte->Execute = 0;
-        arrPtr[i].EptPte = pte;
-        i++;
-    }
-    // Clear the TLB
-    InvEptAllContext();
-    InvVpidAllContext();
-#endif
-}
-
-void end_split(TlbTranslation * arrPtr)
-{
-    uint32 i = 0;
-    EptPteEntry *pte = NULL;
-#ifdef SPLIT_TLB
-    Log("Tear-down TLB split", 0);
-    DbgPrint("%d Total Violations: %d Data and %d Exec %d Thrashes\r\n",
-            ViolationExits, 
-            DataExits, 
-            ExecExits, 
-            Thrashes);
-    if (arrPtr != NULL)
-    {
-        while(arrPtr[i].DataPhys != 0 && i < appsize / PAGE_SIZE)
-        {
-            // Restore the identity map
-            pte = arrPtr[i].EptPte;
-            if (arrPtr[i].CodeOrData == CODE_EPT)
-            {
-                pte->PhysAddr = arrPtr[i].CodePhys >> 12;
-            }
-            else
-            {
-                pte->PhysAddr = arrPtr[i].DataPhys >> 12;
-            }
-            pte->Present = 1;
-            pte->Write = 1;
-            pte->Execute = 1;
-            i++;
-        }
-        // Invalidate TLB
-        InvEptAllContext();
-        InvVpidAllContext();
-    }
-    else
-    {
-        //Beep(1);
-    }
-#endif
-    splitPages = NULL;
-    StackInitStack(&pteStack);
-}
-
-static void __invVpidAllContext(uint32 invtype, InvVpidDesc desc)
-{
-    __asm
-    {
-        PUSH EAX
-        MOV EAX, invtype
-        PUSH	desc.dwords.dword1
-        PUSH	desc.dwords.dword2
-        PUSH	desc.dwords.dword3
-        PUSH	desc.dwords.dword4
-        
-        _emit 0x66      // INVVPID EAX, [ESP]
-        _emit 0x0F
-        _emit 0x38
-        _emit 0x81
-        _emit 0x04
-        _emit 0x24
-        
-        ADD ESP, 16
-        POP EAX
-    }
-}
-
-void InvVpidAllContext()
-{
-    InvVpidDesc desc = {0};
-    __invVpidAllContext(2, desc);
-}
-
-void InvVpidIndividualAddress(uint16 vpid, uint32 address)
-{
-    InvVpidDesc desc = {0};
-    if (ProcessorSupportsType0InvVpid == 1) // Ensure the process supports this type
-    {
-        desc.bits.LinearAddress = address;
-        desc.bits.Vpid = vpid;
-        __invVpidAllContext(0, desc);
-    }
-    else
-    {
-        __invVpidAllContext(2, desc);
-    }
-}
-
-void InvEptAllContext()
-{
-    __asm
-    {
-        PUSH EAX
-        MOV EAX, 2
-        // Set 128 bits of zeros
-        PUSH	DWORD PTR 0
-        PUSH	DWORD PTR 0
-        PUSH	DWORD PTR 0
-        PUSH	DWORD PTR 0
-        
-        _emit 0x66      // INVEPT EAX, [ESP]
-        _emit 0x0F
-        _emit 0x38
-        _emit 0x80
-        _emit 0x04
-        _emit 0x24
-        
-        ADD ESP, 16
-        POP EAX
-    }
-}
+/**
+	@file
+	Code for handling EPT translations in a hypervisor
+		
+	@date 1/17/2012
+***************************************************************/
+
+#include "Ntifs.h"
+#include "Wdm.h"
+#include "ntddk.h"
+#include "..\pe.h"
+#include "procmon.h"
+#include "ept.h"
+#include "..\stack.h"
+#include "..\paging.h"
+#include "..\mtrr.h"
+#include "hypervisor_loader.h"
+#include "hypervisor.h"
+
+/** Maximum number of EPT PDE pages, one per GB of memory, covered by one PDPT */
+#define EPT_MAX_PD_PAGES 512
+/** Fewest EPT PDE pages, the MMIO below 4 GiB is always mapped */
+#define EPT_MIN_PD_PAGES 4
+/** Maximum number of EPT page tables */ 
+#define NUM_TABLES 512
+/** The PDE page was allocated when the map was built, FreeEptIdentityMap frees it */
+#define EPT_PD_OWN 0
+/** The PDE page belongs to EptTableArray, it goes back to the spares */
+#define EPT_PD_TABLES 1
+/** The PDE page came from memContext's pool */
+#define EPT_PD_POOLED 2
+
+/** Pointer to the 512 PDPTEs covering the first 512GB of memory */
+EptPdpteEntry *BkupPdptePtr = NULL;
+/** Array of pointers to free for the PDEs, NULL while a GB is mapped by a 1 GB PDPTE */
+EptPdeEntry2Mb *BkupPdePtrs[EPT_MAX_PD_PAGES] = {0};
+/** Owner of each of BkupPdePtrs, EPT_PD_* */
+uint8 BkupPdeOwner[EPT_MAX_PD_PAGES] = {0};
+/** Set for the GBs re-promoted during the current promotion pass */
+static uint8 EptPromoted[EPT_MAX_PD_PAGES] = {0};
+/** Number of 1 GB PDPTEs demoted and re-promoted */
+uint32 EptGbDemotions = 0, EptGbPromotions = 0;
+/** Number of 4 KB EPT tables collapsed back into 2 MB pages */
+uint32 EptTablesCollapsed = 0;
+/** Number of GBs covered by the identity map */
+uint32 EptNumPdPages = 0;
+uint32 EptPageTableCounter = 0, TableVirtsCounter = 0, ViolationExits = 0, 
+                        ExecExits = 0, DataExits = 0, Thrashes = 0, Thrash = 0,
+                        SkippedChecks = 0;
+EptPteEntry *EptTableArray[NUM_TABLES] = {0};
+EptPteEntry *EptTableVirts[NUM_TABLES] = {0};
+/** Guest physical address of the 2 MB region each of EptTableVirts maps */
+uint64 EptTableBase[NUM_TABLES] = {0};
+/** Set for the EptTableVirts which came from memContext's pool */
+uint8 EptTablePooled[NUM_TABLES] = {0};
+/** Pages of EptTableArray freed in VMX root, reused before allocating again */
+static void *EptSpareTables[NUM_TABLES] = {0};
+/** Set for the EptTableVirts collapsed during the current coalescing pass */
+static uint8 EptTableCollapsed[NUM_TABLES] = {0};
+static uint32 EptSpareCount = 0;
+/** Copy of the MTRRs the identity map takes its memory types from */
+MtrrState EptMtrrs = {0};
+/** Number of 2 MB regions mapped by a page table since they hold more than one memory type */
+uint32 EptMtrrTables = 0;
+uint8 ProcessorSupportsType0InvVpid = 0;
+/** Set if EPT PDPTEs can map 1 GB pages */
+uint8 ProcessorSupportsEpt1GbPages = 0;
+/** Set if the VMX preemption timer can be activated and its value saved on exit */
+uint8 ProcessorSupportsPreemptionTimer = 0;
+/** The preemption timer counts down once every 2^PreemptionTimerShift TSC ticks */
+uint8 PreemptionTimerShift = 0;
+/** Stack to store faulting addresses for TLB split */
+Stack pteStack = {0};
+PagingContext memContext = {0};
+
+void EnableEpt(uint32 Pml4Ptr)
+{
+    uint32 reg = ReadVMCS(SECONDARY_VM_EXEC_CONTROL);
+    EptTablePointer EPTP = {0};
+    PHYSICAL_ADDRESS phys = MmGetPhysicalAddress((void *) Pml4Ptr);
+    
+    // Set up the EPTP
+    EPTP.Bits.PhysAddr = phys.LowPart >> 12;
+    EPTP.Bits.PageWalkLength = 3;
+    WriteVMCS(EPT_POINTER, EPTP.unsignedVal & 0xFFFFFFFF);
+    WriteVMCS(EPT_POINTER_HIGH, 0);
+    
+    // Set the guest VPID to a non-zero value
+    WriteVMCS(VIRTUAL_PROCESSOR_ID, VM_VPID);
+    
+    // Enable the secondary controls VMCS field
+    WriteVMCS(SECONDARY_VM_EXEC_CONTROL, reg | (1 << 5) | (1 << 1) );
+    reg = ReadVMCS(CPU_BASED_VM_EXEC_CONTROL);
+    WriteVMCS(CPU_BASED_VM_EXEC_CONTROL, reg | (1 << 31));
+    InvVpidAllContext();
+}
+
+void DisableEpt()
+{
+    uint32 reg = ReadVMCS(SECONDARY_VM_EXEC_CONTROL);
+    WriteVMCS(SECONDARY_VM_EXEC_CONTROL, reg & ~((1 << 5) | (1 << 1)));
+    
+    // Clear out the EPTP
+    WriteVMCS(EPT_POINTER, 0);
+    WriteVMCS(EPT_POINTER_HIGH, 0);
+}
+
+/**
+    Allocates a zeroed page for an EPT paging structure, from the spares, the
+    paging context's pool or contiguous memory
+    
+    @param pooled Set if the page came from the context's pool
+    @return Pointer to the page, or NULL
+*/
+static void * EptAllocPage(PagingContext *context, uint8 *pooled)
+{
+    PHYSICAL_ADDRESS highest = {0};
+    void *page = NULL;
+    
+    *pooled = 0;
+    if (EptSpareCount > 0)
+    {
+        EptSpareCount--;
+        page = EptSpareTables[EptSpareCount];
+    }
+    else if (context != NULL)
+    {
+        page = pagingAllocPage(context);
+        *pooled = 1;
+    }
+    else if (EptPageTableCounter < NUM_TABLES)
+    {
+        highest.LowPart = ~0;
+        page = MmAllocateContiguousMemory(PAGE_SIZE, highest);
+        // EptTableArray owns the page until the identity map is freed
+        if (page != NULL)
+        {
+            EptTableArray[EptPageTableCounter] = (EptPteEntry *) page;
+            EptPageTableCounter++;
+        }
+    }
+    if (page != NULL)
+        RtlZeroMemory(page, PAGE_SIZE);
+    return page;
+}
+
+/**
+    Gives back a page from EptAllocPage, contiguous pages are kept as spares
+    since they cannot be freed in VMX root
+*/
+static void EptReleasePage(void *page, uint8 pooled, PagingContext *context)
+{
+    if (pooled)
+    {
+        pagingFreePage(context, page);
+    }
+    else
+    {
+        EptSpareTables[EptSpareCount] = page;
+        EptSpareCount++;
+    }
+}
+
+/**
+    Returns MAXPHYADDR, the physical address width the variable MTRR masks
+    are sized to, from CPUID 0x80000008
+*/
+static uint32 EptPhysicalAddressWidth()
+{
+    uint32 maxLeaf, width;
+    
+    __asm
+    {
+        PUSHAD
+        MOV EAX, 0x80000000
+        CPUID
+        MOV maxLeaf, EAX
+        POPAD
+    }
+    if (maxLeaf < 0x80000008)
+        return PHYSICAL_ADDRESS_WIDTH;
+    __asm
+    {
+        PUSHAD
+        MOV EAX, 0x80000008
+        CPUID
+        MOV width, EAX
+        POPAD
+    }
+    width &= 0xFF;
+    return (width != 0) ? width : PHYSICAL_ADDRESS_WIDTH;
+}
+
+/**
+    Copies the fixed and variable MTRRs of the processor into EptMtrrs
+*/
+static void EptReadMtrrs()
+{
+    uint64 cap, defType, base;
+    uint32 i;
+    
+    ReadMSR(MTRR_MSR_CAP);
+    cap = ((uint64) msr.Hi << 32) | msr.Lo;
+    ReadMSR(MTRR_MSR_DEF_TYPE);
+    defType = ((uint64) msr.Hi << 32) | msr.Lo;
+    mtrrInit(&EptMtrrs, cap, defType, EptPhysicalAddressWidth());
+    
+    for (i = 0; i < MTRR_NUM_FIXED_MSRS && EptMtrrs.FixedEnabled; i++)
+    {
+        ReadMSR(mtrrFixedMsrs[i]);
+        mtrrSetFixed(&EptMtrrs, i, ((uint64) msr.Hi << 32) | msr.Lo);
+    }
+    for (i = 0; i < EptMtrrs.NumVariable; i++)
+    {
+        ReadMSR(MTRR_MSR_PHYSBASE(i));
+        base = ((uint64) msr.Hi << 32) | msr.Lo;
+        ReadMSR(MTRR_MSR_PHYSMASK(i));
+        mtrrSetVariable(&EptMtrrs, i, base, ((uint64) msr.Hi << 32) | msr.Lo);
+    }
+}
+
+/**
+    Makes a PDPTE of the identity map a 1 GB page of memory type type
+*/
+static void EptSetGbPage(uint32 pdpteOff, uint8 type)
+{
+    EptPdpteEntry1Gb large = {0};
+    
+    large.Present = 1;
+    large.Write = 1;
+    large.Execute = 1;
+    large.MemoryType = type;
+    large.Size = 1;
+    large.PhysAddr = pdpteOff;
+    ((EptPdpteEntry1Gb *) BkupPdptePtr)[pdpteOff] = large;
+}
+
+/**
+    Replaces a 1 GB page of the identity map with 512 2 MB pages
+    
+    @return Pointer to the new PDEs, or NULL if no page was available
+*/
+static EptPdeEntry2Mb * EptDemoteGbPage(uint32 pdpteOff, PagingContext *context)
+{
+    EptPdpteEntry1Gb large = ((EptPdpteEntry1Gb *) BkupPdptePtr)[pdpteOff];
+    EptPdpteEntry entry = {0};
+    EptPdeEntry2Mb *pd = NULL;
+    PHYSICAL_ADDRESS phys = {0};
+    uint32 j;
+    uint8 pooled;
+    
+    if (pdpteOff >= EptNumPdPages || large.Size == 0)
+        return NULL;
+    pd = (EptPdeEntry2Mb *) EptAllocPage(context, &pooled);
+    if (pd == NULL)
+        return NULL;
+    
+    for (j = 0; j < 512; j++)
+    {
+        pd[j].Present = 1;
+        pd[j].Write = 1;
+        pd[j].Execute = 1;
+        pd[j].MemoryType = large.MemoryType;
+        pd[j].Size = 1;
+        pd[j].PhysAddr = (pdpteOff << 9) + j;
+    }
+    BkupPdePtrs[pdpteOff] = pd;
+    BkupPdeOwner[pdpteOff] = pooled ? EPT_PD_POOLED : EPT_PD_TABLES;
+    
+    // The translations are unchanged, the TLB is flushed once a PTE changes
+    phys = MmGetPhysicalAddress((void *) pd);
+    entry.Present = 1;
+    entry.Write = 1;
+    entry.Execute = 1;
+    entry.PhysAddr = phys.LowPart >> 12;
+    BkupPdptePtr[pdpteOff] = entry;
+    EptGbDemotions++;
+    return pd;
+}
+
+/**
+    Returns the EPT page table which maps the 2 MB region holding 
+    guestPhysicalAddress, or NULL
+*/
+static EptPteEntry * EptFindTable(uint32 guestPhysicalAddress)
+{
+    uint32 i;
+    
+    for (i = 0; i < TableVirtsCounter; i++)
+    {
+        if (EptTableBase[i] == (guestPhysicalAddress & 0xFFE00000))
+            return EptTableVirts[i];
+    }
+    return NULL;
+}
+
+/**
+    Returns 1 if every entry of an EPT page table maps its own frame with 
+    full access and memory type type again
+*/
+static uint8 EptTableIsIdentity(EptPteEntry *table, uint32 firstPfn, uint8 type)
+{
+    uint32 j;
+    
+    for (j = 0; j < 512; j++)
+    {
+        if (!table[j].Present || !table[j].Write || !table[j].Execute || 
+                table[j].MemoryType != type || table[j].PhysAddr != firstPfn + j)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+    Makes a PDE of the identity map a 2 MB page of memory type type
+*/
+static void EptSetLargePage(EptPdeEntry2Mb *pde, uint32 regionPfn, uint8 type)
+{
+    EptPdeEntry2Mb large = {0};
+    
+    large.Present = 1;
+    large.Write = 1;
+    large.Execute = 1;
+    large.MemoryType = type;
+    large.Size = 1;
+    large.PhysAddr = regionPfn >> 9;
+    *pde = large;
+}
+
+/**
+    Returns 1 if a PDE is a 2 MB page of the identity map of memory type type
+*/
+static uint8 EptLargePageIsIdentity(EptPdeEntry2Mb *pde, uint32 regionPfn, uint8 type)
+{
+    return pde->Size && pde->Present && pde->Write && pde->Execute &&
+           pde->MemoryType == type && pde->PhysAddr == regionPfn >> 9;
+}
+
+/**
+    Replaces a 2 MB page of the identity map with a page table
+    
+    @param pde PDE of the region, need not be present yet
+    @param regionPfn First frame of the region
+    @param type Memory type of every page, or MTRR_TYPE_MIXED to look each 
+                page's type up in the MTRRs
+    @param context Paging context to take the page from, NULL at IRQL = 0
+    @return Pointer to the new page table, or NULL if no page was available
+*/
+static EptPteEntry * EptSplitLargePage(EptPdeEntry2Mb *pde, uint32 regionPfn, uint8 type,
+                                       PagingContext *context)
+{
+    EptPteEntry *pageTable = NULL;
+    PHYSICAL_ADDRESS phys = {0};
+    uint32 i;
+    uint8 pooled;
+    
+    pageTable = (EptPteEntry *) EptAllocPage(context, &pooled);
+    if (pageTable == NULL || TableVirtsCounter == NUM_TABLES)
+    {
+        if (pageTable != NULL)
+            EptReleasePage((void *) pageTable, pooled, context);
+        return NULL;
+    }
+    
+    // Populate the page table
+    for (i = 0; i < 512; i++)
+    {
+        pageTable[i].Present = 1;
+        pageTable[i].Write = 1;
+        pageTable[i].MemoryType = (type != MTRR_TYPE_MIXED) ? type : 
+                            mtrrRangeType(&EptMtrrs, (uint64) (regionPfn + i) << 12, PAGE_SIZE);
+        pageTable[i].Execute = 1;
+        pageTable[i].PhysAddr = regionPfn + i;
+    }
+    
+    pde->Present = 1;
+    pde->Write = 1;
+    pde->Execute = 1;
+    pde->Size = 0;
+    pde->IgnorePat = 0;
+    pde->MemoryType = 0;
+    
+    phys = MmGetPhysicalAddress((void *) pageTable);
+    ((EptPdeEntry *) pde)->PhysAddr = phys.LowPart >> 12;      
+    
+    EptTableVirts[TableVirtsCounter] = pageTable;
+    EptTableBase[TableVirtsCounter] = (uint64) regionPfn << 12;
+    EptTablePooled[TableVirtsCounter] = pooled;
+    TableVirtsCounter++;
+    return pageTable;
+}
+
+uint32 EptCoalesceIdentityMap(PagingContext *context)
+{
+    EptPdeEntry2Mb *pd;
+    uint64 base;
+    uint32 i, j, collapsed = 0, promoted = 0;
+    uint8 identity, type;
+    
+    // 4 KB tables which map their 2 MB region unchanged become 2 MB pages,
+    // unless the region holds more than one memory type
+    for (i = 0; i < TableVirtsCounter; i++)
+    {
+        EptTableCollapsed[i] = 0;
+        base = EptTableBase[i];
+        pd = BkupPdePtrs[base >> 30];
+        type = mtrrRangeType(&EptMtrrs, base, 1 << 21);
+        if (pd == NULL || type == MTRR_TYPE_MIXED || 
+                !EptTableIsIdentity(EptTableVirts[i], (uint32) (base >> 12), type))
+            continue;
+        EptSetLargePage(&pd[(base >> 21) & 0x1FF], (uint32) (base >> 12), type);
+        EptTableCollapsed[i] = 1;
+        collapsed++;
+    }
+    
+    // GBs made only of 2 MB identity pages become 1 GB pages
+    for (i = 0; i < EptNumPdPages && ProcessorSupportsEpt1GbPages; i++)
+    {
+        EptPromoted[i] = 0;
+        pd = BkupPdePtrs[i];
+        // A page of the map's own cannot be freed in VMX root, nor kept as
+        // a spare since EptSpareTables only has room for EptTableArray
+        if (pd == NULL || BkupPdeOwner[i] == EPT_PD_OWN)
+            continue;
+        type = mtrrRangeType(&EptMtrrs, (uint64) i << 30, 1 << 30);
+        identity = (type != MTRR_TYPE_MIXED);
+        for (j = 0; j < 512 && identity; j++)
+        {
+            identity = EptLargePageIsIdentity(&pd[j], (i << 18) + (j << 9), type);
+        }
+        if (!identity)
+            continue;
+        EptSetGbPage(i, type);
+        EptPromoted[i] = 1;
+        promoted++;
+    }
+    if (collapsed == 0 && promoted == 0)
+        return 0;
+    
+    // One flush for the whole batch, nothing may cache the old tables once 
+    // they are handed back
+    InvEptAllContext();
+    
+    // Walk down so the entry moved into a freed slot was already looked at
+    for (i = TableVirtsCounter; i > 0; i--)
+    {
+        if (!EptTableCollapsed[i - 1])
+            continue;
+        EptReleasePage((void *) EptTableVirts[i - 1], EptTablePooled[i - 1], context);
+        TableVirtsCounter--;
+        EptTableVirts[i - 1] = EptTableVirts[TableVirtsCounter];
+        EptTableBase[i - 1] = EptTableBase[TableVirtsCounter];
+        EptTablePooled[i - 1] = EptTablePooled[TableVirtsCounter];
+        EptTableCollapsed[i - 1] = EptTableCollapsed[TableVirtsCounter];
+    }
+    for (i = 0; i < EptNumPdPages && ProcessorSupportsEpt1GbPages; i++)
+    {
+        if (!EptPromoted[i])
+            continue;
+        EptReleasePage((void *) BkupPdePtrs[i], BkupPdeOwner[i] == EPT_PD_POOLED, context);
+        BkupPdePtrs[i] = NULL;
+        BkupPdeOwner[i] = EPT_PD_OWN;
+    }
+    
+    EptTablesCollapsed += collapsed;
+    EptGbPromotions += promoted;
+    return collapsed + promoted;
+}
+
+/**
+    Returns the number of GBs the identity map must cover to reach the end of 
+    the highest range of physical memory
+*/
+static uint32 EptCountPdPages()
+{
+    PPHYSICAL_MEMORY_RANGE ranges = MmGetPhysicalMemoryRanges();
+    uint64 end, top = 0;
+    uint32 i, count;
+    
+    if (ranges == NULL)
+        return EPT_MIN_PD_PAGES;
+    // The list ends with a zeroed entry
+    for (i = 0; ranges[i].BaseAddress.QuadPart != 0 || ranges[i].NumberOfBytes.QuadPart != 0; i++)
+    {
+        end = (uint64) ranges[i].BaseAddress.QuadPart + (uint64) ranges[i].NumberOfBytes.QuadPart;
+        if (end > top)
+            top = end;
+    }
+    ExFreePool(ranges);
+    
+    count = (uint32) ((top + (1 << 30) - 1) >> 30);
+    if (count < EPT_MIN_PD_PAGES)
+        count = EPT_MIN_PD_PAGES;
+    if (count > EPT_MAX_PD_PAGES)
+        count = EPT_MAX_PD_PAGES;
+    return count;
+}
+
+EptPml4Entry * InitEptIdentityMap()
+{
+    EptPml4Entry *pml4Ptr = NULL;
+    EptPdpteEntry *pdptePtr = NULL;
+    PHYSICAL_ADDRESS phys = {0}, Highest = {0}, Lowest = {0};
+    uint32 i, j, regionPfn;
+    uint8 gbType, type, pooled;
+    
+    Highest.LowPart = ~0;
+    EptNumPdPages = EptCountPdPages();
+    EptReadMtrrs();
+    
+    // Allocate contiguous, un-cached memory
+    pml4Ptr = (EptPml4Entry *) MmAllocateContiguousMemorySpecifyCache(
+                                                    sizeof(EptPml4Entry) * 512, 
+                                                    Lowest, 
+                                                    Highest, 
+                                                    Lowest, 
+                                                    0);
+    
+    if (pml4Ptr == NULL)
+    {
+        return NULL;
+    }
+    
+    pdptePtr = (EptPdpteEntry *) MmAllocateContiguousMemorySpecifyCache(
+                                                    sizeof(EptPdpteEntry) * 512, 
+                                                    Lowest, 
+                                                    Highest, 
+                                                    Lowest, 
+                                                    0);
+    // Save a copy of the virtual address for later freeing
+    BkupPdptePtr = pdptePtr;
+    if (pdptePtr == NULL)
+    {
+        MmFreeContiguousMemory(pml4Ptr);
+        return NULL;
+    }
+    
+    // With 1 GB pages the PDE pages are only allocated when a GB is demoted
+    for (i = 0; i < EptNumPdPages && !ProcessorSupportsEpt1GbPages; i++)
+    {
+        BkupPdePtrs[i] = (EptPdeEntry2Mb *) MmAllocateContiguousMemorySpecifyCache(
+                                                sizeof(EptPdeEntry2Mb) * 512, 
+                                                Lowest, 
+                                                Highest, 
+                                                Lowest, 
+                                                0);
+        
+        BkupPdeOwner[i] = EPT_PD_OWN;
+        // Free memory if we fail to allocate the next chunk
+        if (BkupPdePtrs[i] != NULL)
+        {
+            RtlZeroMemory((void *) BkupPdePtrs[i], sizeof(EptPdeEntry2Mb) * 512);
+        } 
+        else
+        {
+            MmFreeContiguousMemory(pml4Ptr);
+            MmFreeContiguousMemory(pdptePtr);
+            for (j = 0; j < i; j++)
+            {
+                MmFreeContiguousMemory(BkupPdePtrs[j]);
+                BkupPdePtrs[j] = NULL;
+            }
+            return NULL;
+        }
+    }
+    
+    phys = MmGetPhysicalAddress((void *) pdptePtr);
+    
+    // Zero out the pages
+    RtlZeroMemory((void *) pml4Ptr, sizeof(EptPml4Entry) * 512);
+    RtlZeroMemory((void *) pdptePtr, sizeof(EptPdpteEntry) * 512);
+    
+    // Populate our newly created EPT tables!
+    // Only need the first PML4 Entry unless we have more than 512 GB of RAM
+    pml4Ptr->Present = 1;
+    pml4Ptr->Write = 1;
+    pml4Ptr->Execute = 1;
+    pml4Ptr->PhysAddr = phys.LowPart >> 12;
+    
+    // Establish an identity map, splitting only where the memory type changes
+    for (i = 0; i < EptNumPdPages; i++)
+    {
+        gbType = mtrrRangeType(&EptMtrrs, (uint64) i << 30, 1 << 30);
+        if (ProcessorSupportsEpt1GbPages)
+        {
+            if (gbType != MTRR_TYPE_MIXED)
+            {
+                EptSetGbPage(i, gbType);
+                continue;
+            }
+            BkupPdePtrs[i] = (EptPdeEntry2Mb *) EptAllocPage(NULL, &pooled);
+            BkupPdeOwner[i] = EPT_PD_TABLES;
+            if (BkupPdePtrs[i] == NULL)
+                goto fail;
+        }
+        phys = MmGetPhysicalAddress((void *) BkupPdePtrs[i]);
+        pdptePtr[i].Present = 1;
+        pdptePtr[i].Write = 1;
+        pdptePtr[i].Execute = 1;
+        pdptePtr[i].PhysAddr = phys.LowPart >> 12;
+        
+        // Populate this GB's worth of PDEs
+        for (j = 0; j < 512; j++)
+        {
+            regionPfn = (i << 18) + (j << 9);
+            type = (gbType != MTRR_TYPE_MIXED) ? gbType : 
+                        mtrrRangeType(&EptMtrrs, (uint64) regionPfn << 12, 1 << 21);
+            if (type != MTRR_TYPE_MIXED)
+            {
+                EptSetLargePage(&BkupPdePtrs[i][j], regionPfn, type);
+                continue;
+            }
+            if (EptSplitLargePage(&BkupPdePtrs[i][j], regionPfn, MTRR_TYPE_MIXED, NULL) == NULL)
+                goto fail;
+            EptMtrrTables++;
+        }
+    }
+    
+    DbgPrint("EPT identity map covers %d GB, %d 2 MB regions split at MTRR boundaries\r\n", 
+             EptNumPdPages, EptMtrrTables);
+    return pml4Ptr;
+    
+  fail:
+    FreeEptIdentityMap(pml4Ptr);
+    return NULL;
+}
+
+void FreeEptIdentityMap(EptPml4Entry * ptr)
+{
+    uint32 i;
+    if (BkupPdptePtr != NULL) MmFreeContiguousMemory((void *) BkupPdptePtr);
+    if (ptr != NULL) MmFreeContiguousMemory((void *) ptr);
+
+    for (i = 0; i < EptNumPdPages; i++)
+    {
+        // Other pages belong to EptTableArray or memContext's pool
+        if (NULL != BkupPdePtrs[i] && BkupPdeOwner[i] == EPT_PD_OWN)
+            MmFreeContiguousMemory(BkupPdePtrs[i]);
+        BkupPdePtrs[i] = NULL;
+        BkupPdeOwner[i] = EPT_PD_OWN;
+    }
+    EptNumPdPages = 0;
+
+    for (i = 0; i < EptPageTableCounter; i++)
+    {
+        if (NULL != (void *) EptTableArray[i])
+            MmFreeContiguousMemory((void *) EptTableArray[i]);
+    }
+    EptPageTableCounter = 0;
+    TableVirtsCounter = 0;
+    EptSpareCount = 0;
+    EptMtrrTables = 0;
+}
+
+EptPteEntry * EptMapAddressToPte(uint32 guestPhysicalAddress, EptPml4Entry * pml4Ptr)
+{
+    return EptMapAddressToPteDirql(guestPhysicalAddress, pml4Ptr, NULL);
+}
+
+uint8 EptPtExists(uint32 guestPhysicalAddress)
+{
+    uint32 pdpteOff = ((guestPhysicalAddress >> 30) & 0x3),
+              pdeOff = ((guestPhysicalAddress >> 21) & 0x1FF);
+    EptPdeEntry2Mb *pde = NULL;
+    
+    // Map in correct PDE
+    pde = BkupPdePtrs[pdpteOff];
+    if (pde == NULL)
+        return 0;
+    
+    // Determine if this is mapping a large 2MB page or points to a page table    
+    return !(pde[pdeOff].Size);
+}
+
+EptPteEntry * EptMapAddressToPteDirql(uint32 guestPhysicalAddress, 
+                                      EptPml4Entry * pml4Ptr, 
+                                      PagingContext * context)
+{
+    uint32 pdpteOff = ((guestPhysicalAddress >> 30) & 0x3),
+              pdeOff = ((guestPhysicalAddress >> 21) & 0x1FF), 
+              pteOff = ((guestPhysicalAddress >> 12) & 0x1FF);
+    EptPdeEntry2Mb *pde = NULL;
+    EptPdpteEntry *pdpte = NULL;
+    EptPteEntry *retVal = NULL, *pageTable = NULL;
+    
+    // Map in correct PDE, splitting a 1 GB page first
+    pde = BkupPdePtrs[pdpteOff];
+    if (pde == NULL)
+        pde = EptDemoteGbPage(pdpteOff, context);
+    if (pde == NULL)
+        goto abort;
+    
+    // Determine if this is mapping a large 2MB page or points to a page table    
+    if (pde[pdeOff].Size == 1)
+    {
+        // Need to allocate a page table which replaces the 2MB PDE, a 2 MB
+        // page only ever holds one memory type
+        pageTable = EptSplitLargePage(&pde[pdeOff], (uint32) pde[pdeOff].PhysAddr << 9, 
+                                      (uint8) pde[pdeOff].MemoryType, context);
+        if (pageTable == NULL)
+            goto abort;
+        return &pageTable[pteOff];
+    }
+
+    // Map in existing PTE to return
+    pageTable = EptFindTable(guestPhysicalAddress);
+    if (pageTable != NULL)
+        return &pageTable[pteOff];
+    
+    
+  abort:
+    return retVal;
+}
+
+void EptUnmapPte(EptPteEntry * ptr)
+{
+    EptUnmapPteDirql(ptr, NULL);
+}
+
+void EptUnmapPteDirql(EptPteEntry * ptr, PagingContext * context)
+{
+    if (ptr == NULL)
+        return;
+    MapOutMemory(context, (void *) ptr, sizeof(EptPteEntry));
+}
+
+void MapOutMemory(PagingContext * context, void * ptr, uint32 size)
+{
+    if (context == NULL)
+        MmUnmapIoSpace(ptr, size);
+    else
+        pagingMapOutPhys(context, ptr, size);
+}
+
+void * MapInMemory(PagingContext * context, PHYSICAL_ADDRESS phys, uint32 size)
+{
+    if (context == NULL)
+        return MmMapIoSpace(phys, size, 0);
+    return pagingMapInPhys(context, phys, size);
+}
+
+void SetTrapFlag(uint8 value)
+{
+    uint32 eflags = ReadVMCS(GUEST_RFLAGS);
+    if (value == 1)
+    {
+        WriteVMCS(GUEST_RFLAGS, eflags | (1 << 8));
+    }
+    else
+    {
+        WriteVMCS(GUEST_RFLAGS, eflags & ~(1 << 8));
+    }
+}
+
+void SetPreemptionTimer(uint32 value)
+{
+    if (ProcessorSupportsPreemptionTimer == 0)
+        return;
+    // The saved value must be used by the next entry, otherwise every exit
+    // would reload the timer and it would never expire on a busy guest
+    WriteVMCS(VMX_PREEMPTION_TIMER_VALUE, value);
+    WriteVMCS(PIN_BASED_VM_EXEC_CONTROL, ReadVMCS(PIN_BASED_VM_EXEC_CONTROL) | (1 << 6));
+    WriteVMCS(VM_EXIT_CONTROLS, ReadVMCS(VM_EXIT_CONTROLS) | (1 << 22));
+}
+
+void DisablePreemptionTimer()
+{
+    if (ProcessorSupportsPreemptionTimer == 0)
+        return;
+    // Saving the timer value is only valid while the timer is active
+    WriteVMCS(PIN_BASED_VM_EXEC_CONTROL, ReadVMCS(PIN_BASED_VM_EXEC_CONTROL) & ~(1 << 6));
+    WriteVMCS(VM_EXIT_CONTROLS, ReadVMCS(VM_EXIT_CONTROLS) & ~(1 << 22));
+}
+
+void exit_reason_dispatch_handler__exec_trap(struct GUEST_STATE * GuestSTATE)
+{
+    EptPteEntry *pteptr = NULL;
+    SplitTarget *target = NULL;
+    void *ref = NULL;
+    uint32 index = 0;
+    // Check to see if this is a trap caused by the TLB splitting
+    if (!StackIsEmpty(&pteStack))
+    {
+        ref = StackPop(&pteStack);
+        if ((target = splitRefTarget(ref, &index)) != NULL)
+            pteptr = target->Translations.EptPte[index];
+            
+        // Mark everything non-present
+        if (pteptr != NULL)
+        {
+            pteptr->Present = 0;
+            pteptr->Write = 0;
+            pteptr->Execute = 0;
+        }
+        SetTrapFlag(0);
+        if (Thrash)
+        {
+            if (target != NULL)
+                InvVpidIndividualAddress(VM_VPID, splitTranslationVa(target, index));
+            if (StackPeek(&pteStack) == ref)
+            {
+                StackPop(&pteStack);
+            }
+            else if ((target = splitRefTarget(StackPop(&pteStack), &index)) != NULL)
+            {
+                pteptr = target->Translations.EptPte[index];
+                if (pteptr != NULL)
+                {
+                    pteptr->Present = 0;
+                    pteptr->Write = 0;
+                    pteptr->Execute = 0;
+                }
+                InvVpidIndividualAddress(VM_VPID, splitTranslationVa(target, index));
+            }
+            Thrash = 0;
+            //InvVpidAllContext();
+        }
+    }
+    else
+    {
+        // @todo Re-inject this interrupt into the guest
+        Beep(1);
+        __asm
+        {
+            CLI
+            HLT
+        }
+    }
+}
+
+void exit_reason_dispatch_handler__exec_ept(struct GUEST_STATE * GuestSTATE)
+{
+    uint32 guestPhysical = (ReadVMCS(GUEST_PHYSICAL_ADDRESS)),
+           exitQualification = ReadVMCS(EXIT_QUALIFICATION),
+           guestLinear = ReadVMCS(GUEST_LINEAR_ADDRESS); 
+    EptPteEntry *pteptr = NULL, *prevPte;       
+    SplitTarget *target = NULL, *prevTarget;
+    TlbTranslations *tlb;
+    uint32 prevIndex, index = splitFindTranslation(ReadVMCS(GUEST_CR3), 
+                                                   guestPhysical, &target);
+    void *ref;
+    
+    // This is a bad sign, it means that it cannot find the proper translation,
+    // end every split since the stray PTE may belong to any of them
+    if (index == TLB_NONE)
+    {
+        while ((target = splitNextTarget(NULL)) != NULL)
+        {
+            end_split(target);
+        }
+        return;
+    }
+    tlb = &target->Translations;
+    ref = splitTranslationRef(target, index);
+    
+    // @todo Determine the root cause of the stack overflowing
+    // Ensure that there is space on the stack
+    if (StackIsFull(&pteStack))
+        DbgPrint("Overflow!\r\n");
+      
+    // Get the faulting EPT PTE
+    pteptr = tlb->EptPte[index];
+    if (pteptr == NULL || (pteptr->Present == 1 && pteptr->Execute == 1))
+    {
+        return;   
+    }
+    
+    // First execute or read of a lazily armed page, make its copy now or
+    // leave the page unsplit if there is no memory for it
+    if (tlb->DataPfn[index] == 0 && !splitLazyPage(target, index))
+    {
+        pteptr->PhysAddr = tlb->CodePfn[index];
+        pteptr->Present = 1;
+        pteptr->Write = 1;
+        pteptr->Execute = 1;
+        return;
+    }
+    
+    if (!StackIsEmpty(&pteStack) && ref != StackPeek(&pteStack))
+    {
+        prevTarget = splitRefTarget(StackPeek(&pteStack), &prevIndex);
+        prevPte = (prevTarget != NULL) ? prevTarget->Translations.EptPte[prevIndex] : NULL;
+        if (prevPte != NULL)
+        {
+            prevPte->Present = 1;
+            prevPte->Write = 1;
+            prevPte->Execute = 1;
+        }
+    }
+    StackPush(&pteStack, ref);
+    ViolationExits++;
+    
+    /*if (exitQualification & EPT_MASK_GUEST_LINEAR_VALID)
+    {
+        Log("Guest Linear Address", guestLinear);
+        Log("Guest Physical", guestPhysical);
+        Log("Guest EIP", GuestSTATE->GuestEIP);
+        Log("----------------------------", 0);
+    }*/
+    
+    if (StackNumEntries(&pteStack) >= 2) // Thrashing
+    {
+        PHYSICAL_ADDRESS phys = {0};
+        uint8 *dataPtr, *codePtr;
+        
+        // Check to ensure there has been no instruction corruption, the window
+        // mappings are safe at any IRQL
+        phys.LowPart = tlb->DataPfn[index] << 12;
+        dataPtr = (uint8 *) MapInMemory(&memContext, phys, PAGE_SIZE);
+        phys.LowPart = tlb->CodePfn[index] << 12;
+        codePtr = (uint8 *) MapInMemory(&memContext, phys, PAGE_SIZE);
+        if (dataPtr != NULL && codePtr != NULL)
+        {
+            if (0 != memcmp(dataPtr + (GuestSTATE->GuestEIP & 0xFFF),
+                            codePtr + (GuestSTATE->GuestEIP & 0xFFF), 
+                            ReadVMCS(VM_EXIT_INSTRUCTION_LEN)))
+            {
+                memcpy(dataPtr + (GuestSTATE->GuestEIP & 0xFFF),
+                        codePtr + (GuestSTATE->GuestEIP & 0xFFF), 
+                        ReadVMCS(VM_EXIT_INSTRUCTION_LEN));
+            }
+        }
+        else
+        {
+            SkippedChecks++;
+        }
+        MapOutMemory(&memContext, dataPtr, PAGE_SIZE);
+        MapOutMemory(&memContext, codePtr, PAGE_SIZE);
+        Thrash = 1;
+        Thrashes++;
+        measureSchedNoteActivity(&target->Sched, 
+                                 splitTranslationVa(target, index) - target->ImageInfo.ImageBase);
+        
+        pteptr->PhysAddr = tlb->DataPfn[index];
+        pteptr->Execute = 1;
+        pteptr->Present = 1;
+        pteptr->Write = 1;
+    }
+    else
+    {
+        if (exitQualification & EPT_MASK_DATA_EXEC) // Execute access
+        {
+            ExecExits++;
+            measureSchedNoteActivity(&target->Sched, 
+                                     splitTranslationVa(target, index) - target->ImageInfo.ImageBase);
+            pteptr->PhysAddr = tlb->CodePfn[index];
+            //pteptr->PhysAddr = tlb->DataPfn[index];
+            pteptr->Execute = 1;
+        }
+        else if (exitQualification & EPT_MASK_DATA_READ || 
+                    exitQualification & EPT_MASK_DATA_WRITE) // Data access
+        {
+            DataExits++;
+            if (exitQualification & EPT_MASK_DATA_WRITE)
+            {
+                measureSchedNoteActivity(&target->Sched, 
+                                     splitTranslationVa(target, index) - target->ImageInfo.ImageBase);
+            }
+            pteptr->PhysAddr = tlb->DataPfn[index];
+            //pteptr->PhysAddr = tlb->CodePfn[index];
+            pteptr->Present = 1;
+            pteptr->Write = 1;
+        }
+        else
+        {
+            // Violation that is neither data access nor instruction fetch
+            //Beep(1);
+            __asm
+            {
+                CLI
+                HLT
+            }
+        }   
+    }
+    // Set the trap flag to force another VMEXIT to the trap handler
+    SetTrapFlag(1);
+    //InvEptAllContext();
+    //InvVpidAllContext();
+}
+
+/**
+    Matches the references on the PTE stack to the translations of a target
+*/
+static uint8 EptRefOfTarget(void *ref, void *target)
+{
+    uint32 index;
+    
+    return splitRefTarget(ref, &index) == (SplitTarget *) target;
+}
+
+void init_split(SplitTarget * target)
+{
+    uint32 i = 0;
+    EptPteEntry *pte = NULL;
+    TlbTranslations *tlb = &target->Translations;
+    
+    if (target->Active)
+        return;
+    // (Re)initialize counters and the stack when the first target is split
+    if (SplitActiveTargets == 0)
+    {
+        StackInitStack(&pteStack);
+        
+        ViolationExits = 0;
+        DataExits = 0;
+        ExecExits = 0;
+        Thrashes = 0;
+        Thrash = 0;
+        SkippedChecks = 0;
+    }
+    splitTargetInsert(target);
+    target->Active = 1;
+#ifdef SPLIT_TLB
+    Log("Initializing TLB split", target->CR3);
+    // For all the defined target pages
+    for (i = 0; i < tlb->Count; i++)
+    {
+        // Determine which guest physical address is the one to be marked non-present,
+        // pages which are not present yet are armed once they show up
+        pte = NULL;
+        if (tlb->Flags[i] == CODE_EPT && tlb->CodePfn[i] != 0)
+        {
+            pte = EptMapAddressToPte(tlb->CodePfn[i] << 12, NULL);
+        }
+        else if (tlb->Flags[i] == DATA_EPT)
+        {
+            pte = EptMapAddressToPte(tlb->DataPfn[i] << 12, NULL);
+        }
+        if (pte != NULL)
+        {
+            pte->Present = 0;
+            pte->Write = 0;
+            pte->Execute = 0;
+        }
+        tlb->EptPte[i] = pte;
+    }
+    // Clear the TLB
+    InvEptAllContext();
+    InvVpidAllContext();
+#endif
+    startPeriodicMeasure(target);
+}
+
+void end_split(SplitTarget * target)
+{
+    uint32 i = 0;
+    EptPteEntry *pte = NULL;
+    SplitTarget *other = NULL;
+    TlbTranslations *tlb = (target != NULL) ? &target->Translations : NULL;
+    
+    if (target == NULL || !target->Active)
+        return;
+    // References left on the stack must not outlive the target, its slot 
+    // may be reused
+    StackRemoveIf(&pteStack, EptRefOfTarget, (void *) target);
+    splitTargetRemove(target);
+    target->Active = 0;
+#ifdef SPLIT_TLB
+    Log("Tear-down TLB split", target->CR3);
+    DbgPrint("%d Total Violations: %d Data and %d Exec %d Thrashes (%d unchecked)\r\n",
+            ViolationExits, 
+            DataExits, 
+            ExecExits, 
+            Thrashes,
+            SkippedChecks);
+    if (tlb->EptPte != NULL)
+    {
+        for (i = 0; i < tlb->Count; i++)
+        {
+            // Restore the identity map
+            pte = tlb->EptPte[i];
+            if (pte == NULL)
+                continue;
+            pte->PhysAddr = (tlb->Flags[i] == CODE_EPT) ? tlb->CodePfn[i] : tlb->DataPfn[i];
+            pte->Present = 1;
+            pte->Write = 1;
+            pte->Execute = 1;
+        }
+#ifdef LAZY_SPLIT
+        // Nothing maps this target's copies any more, the copies the other
+        // targets share stay
+        splitReleaseCopies(target);
+#endif
+        // Instances of the same image share frames, arm the ones the other
+        // targets still split again
+        while ((other = splitNextTarget(other)) != NULL)
+        {
+            for (i = 0; i < other->Translations.Count; i++)
+            {
+                pte = other->Translations.EptPte[i];
+                if (pte == NULL)
+                    continue;
+                pte->Present = 0;
+                pte->Write = 0;
+                pte->Execute = 0;
+            }
+        }
+        // Invalidate TLB
+        InvEptAllContext();
+        InvVpidAllContext();
+        // Go back to large pages once nothing is split any more, an armed PTE
+        // of a live target may look like the identity map, e.g. a page left 
+        // unsplit, and its table must stay
+        if (SplitActiveTargets == 0)
+        {
+            EptCoalesceIdentityMap(&memContext);
+            DbgPrint("EPT: %d tables collapsed, %d 1 GB pages demoted, %d re-promoted\r\n", 
+                     EptTablesCollapsed, EptGbDemotions, EptGbPromotions);
+        }
+    }
+    else
+    {
+        //Beep(1);
+    }
+#endif
+    if (SplitActiveTargets == 0)
+    {
+        stopPeriodicMeasure();
+        StackInitStack(&pteStack);
+    }
+}
+
+static void __invVpidAllContext(uint32 invtype, InvVpidDesc desc)
+{
+    __asm
+    {
+        PUSH EAX
+        MOV EAX, invtype
+        PUSH	desc.dwords.dword1
+        PUSH	desc.dwords.dword2
+        PUSH	desc.dwords.dword3
+        PUSH	desc.dwords.dword4
+        
+        _emit 0x66      // INVVPID EAX, [ESP]
+        _emit 0x0F
+        _emit 0x38
+        _emit 0x81
+        _emit 0x04
+        _emit 0x24
+        
+        ADD ESP, 16
+        POP EAX
+    }
+}
+
+void InvVpidAllContext()
+{
+    InvVpidDesc desc = {0};
+    __invVpidAllContext(2, desc);
+}
+
+void InvVpidIndividualAddress(uint16 vpid, uint32 address)
+{
+    InvVpidDesc desc = {0};
+    if (ProcessorSupportsType0InvVpid == 1) // Ensure the process supports this type
+    {
+        desc.bits.LinearAddress = address;
+        desc.bits.Vpid = vpid;
+        __invVpidAllContext(0, desc);
+    }
+    else
+    {
+        __invVpidAllContext(2, desc);
+    }
+}
+
+void InvEptAllContext()
+{
+    __asm
+    {
+        PUSH EAX
+        MOV EAX, 2
+        // Set 128 bits of zeros
+        PUSH	DWORD PTR 0
+        PUSH	DWORD PTR 0
+        PUSH	DWORD PTR 0
+        PUSH	DWORD PTR 0
+        
+        _emit 0x66      // INVEPT EAX, [ESP]
+        _emit 0x0F
+        _emit 0x38
+        _emit 0x80
+        _emit 0x04
+        _emit 0x24
+        
+        ADD ESP, 16
+        POP EAX
+    }
+}
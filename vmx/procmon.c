@@ -1,455 +1,1666 @@
-/**
-	@file
-	Code for monitoring processes and splitting the TLB for target 
-    applications
-		
-	@date 1/24/2012
-***************************************************************/
-
-#include "Ntifs.h"
-#include "Wdm.h"
-#include "ntddk.h"
-#include "..\pe.h"
-#include "..\paging.h"
-#include "hypervisor_loader.h"
-#include "ept.h"
-#include "hypervisor.h"
-#include "procmon.h"
-
-/** Enable verbose debugging output */
-#define VDEBUG 1
-/** 8.3 target executable name */
-char TargetAppName[] = "test.exe";
-
-/** Stack storage for the APC state */
-KAPC_STATE apcstate;
-uint8 *appCopy = NULL;
-/** MDL for probe and locking physical pages into memory */
-PMDLX LockedMdl = NULL;
-/** PHYSICAL_ADDRESS used to allow allocation anywhere in the 4GB range */
-PHYSICAL_ADDRESS highestMemoryAddress = {0};
-/** Pointer to the TlbTranslation array used by the EPT violation handler to split the TLB */
-TlbTranslation *translationArr = NULL;
-
-PHYSICAL_ADDRESS *targetPhys;
-
-uint32 appsize = 0, targetCR3 = 0;
-
-PHYSICAL_ADDRESS targetPePhys = {0};
-void *targetPeVirt = NULL;
-uint8 *targetPePtr = NULL;
-PEPROCESS targetProc = NULL;
-PageTableEntry **targetPtes;
-
-/* Periodic Measurement Thread control (Created in entry, used in thread and unload) */
-/** Thread object */
-static VOID * periodicMeasureThread = NULL;
-/** Thread body loop control variable */
-static UCHAR periodicMeasureThreadExecute = 0;
-/** Raise this event to abort the loop delay */
-static KEVENT periodicMeasureThreadWakeUp = {0};
-
-// This runs at a lower IRQL, so it can use the kernel memory functions
-void processCreationMonitor(HANDLE ParentId, HANDLE ProcessId, BOOLEAN Create)
-{
-    PEPROCESS proc = NULL;
-    void *PeHeaderVirt = NULL;
-    uint16 numExecSections = 0;
-    uint8 *pePtr = NULL;
-    PHYSICAL_ADDRESS phys = {0};
-    char *procName;
-    uint32 imageSize, translations = (uint32) translationArr;
-    
-    NTSTATUS status = STATUS_SUCCESS;
-    HANDLE periodMeasureThreadHandle = NULL;
-    OBJECT_ATTRIBUTES objectAttributes = {0};
-    
-    // Set to anywhere inthe 4GB range
-    highestMemoryAddress.LowPart = ~0;
-    
-    // Get the 8.3 image name
-    PsLookupProcessByProcessId(ProcessId, &proc);
-    procName = PsGetProcessImageFileName(proc);
-    
-    // Check if this is the target process
-    if(strncmp(TargetAppName, procName, strlen(TargetAppName)) == 0)
-    {
-        if (Create && VDEBUG) DbgPrint("New Process Created! %s\r\n", procName); 
-        if (!Create && VDEBUG) DbgPrint("Application quitting %s\r\n", procName);   
-            
-        // Retrieve virtual pointer to the PE header for target application (in PE context)
-        PeHeaderVirt = PsGetProcessSectionBaseAddress(proc);
-        //DbgPrint("Virt: %x", PeHeaderVirt);
-        
-        // Begin critical section
-        // Attach to the target process and grab its CR3 value to use later
-        KeStackAttachProcess(proc, &apcstate); 
-        
-        if (Create)
-        {
-            __asm
-            {
-                push eax
-                mov eax, cr3
-                mov targetCR3, eax
-                pop eax
-            }   
-        }
-        
-        phys = MmGetPhysicalAddress(PeHeaderVirt);            
-        KeUnstackDetachProcess(&apcstate);
-        // End critical section
-        
-        targetPePhys = phys;
-        targetPeVirt = PeHeaderVirt;
-        targetProc = proc;
-        
-        if (Create)
-        {
-            targetPePtr = peMapInImageHeader(phys);
-            imageSize = peGetImageSize(targetPePtr);
-            if (VDEBUG) DbgPrint("Image Size: %x bytes Num Entries %d\r\n", imageSize, sizeof(TlbTranslation) * (imageSize / PAGE_SIZE));
-            DbgPrint("Virt %x - %x %x\r\n", PeHeaderVirt, (uint32) PeHeaderVirt + imageSize, targetCR3);
-        
-            // Ensure Windows doesn't reuse the physical pages
-            LockedMdl = pagingLockProcessMemory(PeHeaderVirt, imageSize, proc, &apcstate);
-            if(LockedMdl == NULL && VDEBUG)
-            {
-                DbgPrint("Unable to lock memory\r\n");
-            }
-            appsize = imageSize;
-            appCopy = (uint8 *) MmAllocateContiguousMemory(imageSize, highestMemoryAddress);
-            RtlZeroMemory((void *) appCopy, imageSize);
-            copyPe(proc, &apcstate, PeHeaderVirt, appCopy, imageSize);
-            translationArr = allocateAndFillTranslationArray(PeHeaderVirt, 
-                                                             appCopy, 
-                                                             imageSize, 
-                                                             proc, 
-                                                             &apcstate);
-                                                             
-            translations = (uint32) translationArr;
-            // VMCALL to start the TLB splitting
-        	__asm
-        	{
-        		PUSHAD
-        		MOV		EAX, VMCALL_INIT_SPLIT
-                MOV     EBX, translations
-        
-        		_emit 0x0F		// VMCALL
-        		_emit 0x01
-        		_emit 0xC1
-        
-        		POPAD
-        	}
-            
-            if (VDEBUG) DbgPrint("Checksum of proc: %x\r\n", 
-                             peChecksumExecSections(targetPePtr, PeHeaderVirt, 
-                                                    proc, &apcstate, targetPhys));
-                             
-            //pePrintSections(pePtr);
-                             
-#ifdef PERIODIC_MEASURE
-            /* Set up periodic measurement thread */
-            KeInitializeEvent(&periodicMeasureThreadWakeUp, NotificationEvent, FALSE); //returns void
-            InitializeObjectAttributes(&objectAttributes, NULL, OBJ_KERNEL_HANDLE, NULL, NULL); //returns void
-        
-            periodicMeasureThreadExecute = 1; //allows thread to execute
-            status = PsCreateSystemThread(&periodMeasureThreadHandle,
-                            THREAD_ALL_ACCESS, &objectAttributes, NULL, NULL,
-                            periodicMeasurePe, NULL);
-            status = ObReferenceObjectByHandle(periodMeasureThreadHandle, 0, NULL,
-                                               KernelMode, &periodicMeasureThread, NULL);
-            ZwClose(periodMeasureThreadHandle); //don't need the handle anymore, ref will remain valid
-#endif
-
-        }
-        else
-        {
-            translations = (uint32) translationArr;
-            // VMCALL to stop TLB splitting
-        	__asm
-        	{
-        		PUSHAD
-        		MOV		EAX, VMCALL_END_SPLIT
-                MOV     EBX, translations
-        
-        		_emit 0x0F		// VMCALL
-        		_emit 0x01
-        		_emit 0xC1
-        
-        		POPAD
-        	}
-            if (LockedMdl != NULL)
-            {
-               pagingUnlockProcessMemory(proc, &apcstate, LockedMdl);
-            }
-            
-            if (appCopy != NULL)
-            {
-                MmFreeContiguousMemory((PVOID) appCopy);
-            }
-            
-            if (translationArr != NULL)
-            {
-                freeTranslationArray(translationArr);
-            }
-
-            targetCR3 = 0;
-            
-#ifdef PERIODIC_MEASURE
-            /* Stop the periodic measurement thread */
-            periodicMeasureThreadExecute = 0; // Apply brakes
-            KeSetEvent(&periodicMeasureThreadWakeUp, 0, TRUE); // Cancel any current wait in the thread
-            /* Wait for thread to stop */
-            KeWaitForSingleObject(periodicMeasureThread, 
-                                  Executive, 
-                                  KernelMode, 
-                                  FALSE, 
-                                  NULL); 
-        
-            ObDereferenceObject(periodicMeasureThread);
-#endif
-            peMapOutImageHeader(targetPePtr);
-            targetPeVirt = NULL;
-        }
-        return;        
-    }
-}
-
-void periodicMeasurePe(PVOID context)
-{
-    LARGE_INTEGER measurementFrequency = {0}; // How long to delay
-
-    measurementFrequency.QuadPart = -10000000; // 1 second / 100 nanoseconds
-    while (periodicMeasureThreadExecute) {
-        measurePe(targetPePhys, targetPeVirt);
-        KeWaitForSingleObject(&periodicMeasureThreadWakeUp, Executive,
-                              KernelMode, TRUE, &measurementFrequency); 
-    }
-}
-
-void measurePe(PHYSICAL_ADDRESS phys, void * peHeaderVirt)
-{
-    uint32 b, c;
-    if (peHeaderVirt == NULL)
-        return;
-    b = phys.LowPart;
-    c = (uint32) peHeaderVirt;
-    // VMCALL to stop measure without the EPT TLB splitting
-	__asm
-	{
-		PUSHAD
-		MOV		EAX, VMCALL_MEASURE
-        MOV     EBX, b
-        MOV     ECX, c
-
-		_emit 0x0F		// VMCALL
-		_emit 0x01
-		_emit 0xC1
-
-		POPAD
-	}
-    
-}
-
-void copyPe(PEPROCESS proc, PKAPC_STATE apc, uint8 *srcPtr, uint8 *targetPtr, uint32 len)
-{
-    if (srcPtr == NULL || targetPtr == NULL)
-        return;
-        
-    // Attach to the process and copy the image to the passed buffer
-    KeStackAttachProcess(proc, apc); 
-    
-    memcpy(targetPtr, srcPtr, len);
-    
-    KeUnstackDetachProcess(apc);
-}
-
-TlbTranslation * allocateAndFillTranslationArray(uint8 *codePtr,
-                                                 uint8 *dataPtr, 
-                                                 uint32 len, 
-                                                 PEPROCESS proc,
-                                                 PKAPC_STATE apc)
-{
-    const uint32 tag = '3gaT';
-    uint32 i = 0, numPages = len / 0x1000;
-    TlbTranslation *arr = (TlbTranslation *) ExAllocatePoolWithTag(NonPagedPool,
-                                                 (numPages + 1) * sizeof(TlbTranslation),
-                                                 tag);
-                                                 
-    PHYSICAL_ADDRESS tmpPhys = {0};
-    TlbTranslation nullTranslation = {0};                                             
-                                                 
-    targetPhys = (PHYSICAL_ADDRESS *) ExAllocatePoolWithTag(NonPagedPool,
-                                                 (numPages + 1) * sizeof(PHYSICAL_ADDRESS),
-                                                 tag);
-    targetPtes = (PageTableEntry **) ExAllocatePoolWithTag(NonPagedPool,
-                                                 (numPages + 1) * sizeof(PageTableEntry *),
-                                                 tag);                                             
-
-    if (arr == NULL || targetPtes == NULL || targetPhys == NULL)
-    {
-        while (1) {};
-    }
-    
-    RtlZeroMemory(arr, (numPages + 1) * sizeof(TlbTranslation));    
-    // Loop through the VA space of the PE image and get the physical addresses
-    for (i = 0; i < numPages; i++)
-    {
-        KeStackAttachProcess(proc, apc);
-        tmpPhys = MmGetPhysicalAddress((PVOID) ((uint32) codePtr + (i * PAGE_SIZE)));
-        KeUnstackDetachProcess(apc);
-        targetPtes[i] = pagingMapInPte(targetCR3, (uint8 *) codePtr + (i * PAGE_SIZE));
-        arr[i].CodePhys = tmpPhys.LowPart;
-        targetPhys[i] = tmpPhys;
-        //arr[i].DataPhys = tmpPhys.LowPart;
-        arr[i].CodeOrData = CODE_EPT;
-        
-        arr[i].VirtualAddress = ((uint32) codePtr + (i * PAGE_SIZE));
-        
-        tmpPhys = MmGetPhysicalAddress((PVOID) ((uint32) dataPtr + (i * PAGE_SIZE)));
-        arr[i].DataPhys = tmpPhys.LowPart;
-        //arr[i].CodePhys = tmpPhys.LowPart;
-        //DbgPrint("Code %x Data %x\r\n", arr[i].CodePhys, arr[i].DataPhys);
-    }
-
-    arr[numPages] = nullTranslation; // Zero out the last element
-    return arr;
-}
-
-void freeTranslationArray(TlbTranslation *arr)
-{
-    const uint32 tag = '3gaT';
-    uint32 i = 0;
-    
-    for (i = 0; i < appsize / 0x1000; i++)
-    {
-        pagingMapOutEntry(targetPtes[i]);
-    }
-    ExFreePoolWithTag(arr, tag);
-}
-
-TlbTranslation * getTlbTranslation(TlbTranslation * transArr, uint32 guestPhysical)
-{
-    uint32 i = 0;
-    guestPhysical &= 0xFFFFF000;
-    if (transArr == NULL)
-        return NULL;
-    // Look for the correct TlbTranslation
-    while (transArr[i].DataPhys != 0)
-    {
-        if ((transArr[i].CodeOrData == DATA_EPT && guestPhysical == transArr[i].DataPhys) ||
-                (transArr[i].CodeOrData == CODE_EPT && guestPhysical == transArr[i].CodePhys))
-            return &transArr[i];
-        i++;
-    }
-    return NULL;
-}
-
-// This function runs at DIRQL, and must NOT cause any page faults
-// TODO Check for CodeOrData field
-void AppendTlbTranslation(TlbTranslation * transArr, uint32 phys, uint8 * virt)
-{
-    uint32 i = 0;
-    EptPteEntry *pte;
-    while (transArr[i].VirtualAddress != (uint32) virt && transArr[i].DataPhys != 0)
-    {
-        i++;
-    }
-    if (transArr[i].VirtualAddress == (uint32) virt)
-    {
-        pte = transArr[i].EptPte;
-        pte->Present = 1;
-        pte->Write = 1;
-        pte->Execute = 1;
-        pte->PhysAddr = (transArr[i].CodeOrData == CODE_EPT) ? 
-                            transArr[i].CodePhys >> 12 : 
-                            transArr[i].DataPhys >> 12;
-        transArr[i].DataPhys = phys;
-        transArr[i].CodeOrData = DATA_EPT;
-        pte = EptMapAddressToPteDirql(phys, NULL, &memContext);
-        if (pte != NULL)
-        {
-            pte->Present = 0;
-            pte->Write = 0;
-            pte->Execute = 0;
-            transArr[i].EptPte = pte;
-        }
-        else
-        {
-            //Beep(1);
-            while(1) {}
-        }
-    }
-    
-}
-
-uint8 *dataPage, *codePage;
-TlbTranslation smallArr[2] = {0};
-void splitPage()
-{
-    const uint32 tag = '3gaT';
-    PHYSICAL_ADDRESS phys = {0};
-    TlbTranslation *tlbptr = smallArr;
-    
-    dataPage = (uint8 *) ExAllocatePoolWithTag(NonPagedPool, 2 * PAGE_SIZE, tag);
-    codePage = dataPage + PAGE_SIZE;
-    
-    dataPage[0] = 0xFF;
-    codePage[0] = 0xC3;
-    
-    phys = MmGetPhysicalAddress((void *) dataPage);
-    smallArr[0].DataPhys = phys.LowPart;
-    phys = MmGetPhysicalAddress((void *) codePage);
-    smallArr[0].CodePhys = phys.LowPart;
-    
-    __asm
-	{
-		PUSHAD
-		MOV		EAX, VMCALL_INIT_SPLIT
-        MOV     EBX, tlbptr
-
-		_emit 0x0F		// VMCALL
-		_emit 0x01
-		_emit 0xC1
-
-		POPAD
-	}
-    
-    Log("Found", codePage[0]);
-    codePage[0] = 0xFE;
-    Log("Found", codePage[0]);
-    
-    __asm 
-    {
-        PUSH EAX
-        MOV EAX, codePage
-        CALL EAX
-        POP EAX
-    }
-    
-    __asm
-	{
-		PUSHAD
-		MOV		EAX, VMCALL_END_SPLIT
-        MOV     EBX, tlbptr
-
-		_emit 0x0F		// VMCALL
-		_emit 0x01
-		_emit 0xC1
-
-		POPAD
-	}
-    
-    ExFreePoolWithTag(dataPage, tag);
-}
-
-uint32 checksumBuffer(uint8 * ptr, uint32 len)
-{
-    uint32 i, sum = 0;
-    for (i = 0; i < len; i++)
-    {
-        sum += ptr[i];
-    }
-    return sum;
-}
+/**
+	@file
+	Code for monitoring processes and splitting the TLB for target 
+    applications
+		
+	@date 1/24/2012
+***************************************************************/
+
+#include "Ntifs.h"
+#include "Wdm.h"
+#include "ntddk.h"
+#include "..\pe.h"
+#include "..\paging.h"
+#include "..\measure.h"
+#include "..\policy.h"
+#include "..\dedup.h"
+#include "..\warm.h"
+#include "hypervisor_loader.h"
+#include "ept.h"
+#include "hypervisor.h"
+#include "procmon.h"
+
+/** Enable verbose debugging output */
+#define VDEBUG 1
+/** 8.3 target executable name, the only policy when none is configured */
+char TargetAppName[] = "test.exe";
+/** Registry value under the driver's service key holding the policy blob */
+#define POLICY_REG_VALUE L"Policy"
+
+/** Policies of the images to split, matched against every new process */
+static PolicyTable SplitPolicy = {0};
+static void *SplitPolicyStorage = NULL;
+
+/** Most copies made on first use alive at once, shared by all targets */
+#define SPLIT_COPY_ENTRIES 4096
+/** Buckets of the copy store */
+#define SPLIT_COPY_BUCKETS 1024
+
+/** Copies made on first use, instances of an image share the copy of a frame */
+static DedupStore SplitCopyStore;
+static DedupEntry SplitCopyEntries[SPLIT_COPY_ENTRIES];
+static uint32 SplitCopyBuckets[SPLIT_COPY_BUCKETS];
+
+/** Images whose setup results are kept across launches */
+#define SPLIT_WARM_ENTRIES 8
+
+/** Setup results of the images launched last, looked up by image identity */
+static WarmCache SplitWarm;
+static WarmEntry SplitWarmEntries[SPLIT_WARM_ENTRIES];
+/** Parsed headers of each cached image */
+static PeImageInfo SplitWarmInfo[SPLIT_WARM_ENTRIES];
+/** Reference checksums of each cached image, and their number */
+static uint32 *SplitWarmReference[SPLIT_WARM_ENTRIES];
+static uint32 SplitWarmReferencePages[SPLIT_WARM_ENTRIES];
+/** Serializes the setup workers' use of the warm cache */
+static FAST_MUTEX SplitWarmLock;
+
+/** PHYSICAL_ADDRESS used to allow allocation anywhere in the 4GB range */
+PHYSICAL_ADDRESS highestMemoryAddress = {0};
+
+/** Context of each process split or being set up */
+static SplitTarget SplitTargets[SPLIT_MAX_TARGETS];
+/** Set for the slots of SplitTargets which hold a process */
+static volatile LONG SplitTargetUsed[SPLIT_MAX_TARGETS] = {0};
+/** Split targets chained by the hash of their CR3, only changed in VMX root */
+static SplitTarget *SplitTargetTable[SPLIT_TARGET_BUCKETS] = {0};
+/** Number of targets in SplitTargetTable */
+uint32 SplitActiveTargets = 0;
+/** Share of one core the periodic measurement may use (percent) */
+uint32 MeasureBudgetPercent = MEASURE_DEFAULT_BUDGET;
+/** Length of a measurement interval in TSC ticks */
+static uint64 measureIntervalTicks = 0;
+/** Target the next preemption timer exit measures a slice of */
+static SplitTarget *measureNext = NULL;
+
+/**
+    Reads the time-stamp counter, the clock the preemption timer counts in
+*/
+static uint64 readTsc()
+{
+    uint32 lo, hi;
+    __asm
+    {
+        RDTSC
+        MOV lo, EAX
+        MOV hi, EDX
+    }
+    return ((uint64) hi << 32) | lo;
+}
+
+/**
+    Returns the number of TSC ticks in 100ns
+*/
+static uint64 calibrateTsc()
+{
+    uint64 start = readTsc(), ticks;
+    
+    KeStallExecutionProcessor(1000);
+    ticks = (readTsc() - start) / 10000;
+    return (ticks == 0) ? 1 : ticks;
+}
+
+/**
+    Records the time since *last as the latency of a setup stage of a target
+    and moves *last on to now
+*/
+static void splitStageDone(SplitTarget *target, uint32 stage, LARGE_INTEGER *last)
+{
+    LARGE_INTEGER freq, now = KeQueryPerformanceCounter(&freq);
+    
+    target->SetupMicros[stage] = (uint32) ((now.QuadPart - last->QuadPart) * 1000000 /
+                                           freq.QuadPart);
+    *last = now;
+}
+
+/**
+    Returns the bucket of a CR3 value, PAE CR3 values are only 32-byte aligned
+*/
+static uint32 splitTargetHash(uint32 cr3)
+{
+    return ((cr3 >> 5) * 0x9E3779B1) >> (32 - SPLIT_TARGET_HASH_BITS);
+}
+
+void splitTargetInsert(SplitTarget *target)
+{
+    uint32 bucket = splitTargetHash(target->CR3);
+    
+    target->Next = SplitTargetTable[bucket];
+    SplitTargetTable[bucket] = target;
+    SplitActiveTargets++;
+}
+
+void splitTargetRemove(SplitTarget *target)
+{
+    SplitTarget **link = &SplitTargetTable[splitTargetHash(target->CR3)];
+    
+    while (*link != NULL && *link != target)
+    {
+        link = &(*link)->Next;
+    }
+    if (*link == NULL)
+        return;
+    *link = target->Next;
+    target->Next = NULL;
+    SplitActiveTargets--;
+    if (measureNext == target)
+        measureNext = NULL;
+}
+
+SplitTarget * splitTargetLookup(uint32 cr3)
+{
+    SplitTarget *target = SplitTargetTable[splitTargetHash(cr3)];
+    
+    while (target != NULL && target->CR3 != cr3)
+    {
+        target = target->Next;
+    }
+    return target;
+}
+
+SplitTarget * splitNextTarget(SplitTarget *prev)
+{
+    uint32 bucket = 0;
+    
+    if (prev != NULL)
+    {
+        if (prev->Next != NULL)
+            return prev->Next;
+        bucket = splitTargetHash(prev->CR3) + 1;
+    }
+    for (; bucket < SPLIT_TARGET_BUCKETS; bucket++)
+    {
+        if (SplitTargetTable[bucket] != NULL)
+            return SplitTargetTable[bucket];
+    }
+    return NULL;
+}
+
+uint32 splitFindTranslation(uint32 cr3, uint32 guestPhysical, SplitTarget **target)
+{
+    SplitTarget *current = splitTargetLookup(cr3), *other = NULL;
+    uint32 translation;
+    
+    if (current != NULL)
+    {
+        translation = getTlbTranslation(&current->Translations, guestPhysical);
+        if (translation != TLB_NONE)
+        {
+            *target = current;
+            return translation;
+        }
+    }
+    // The access was made from another address space, e.g. by the kernel
+    while ((other = splitNextTarget(other)) != NULL)
+    {
+        if (other == current)
+            continue;
+        translation = getTlbTranslation(&other->Translations, guestPhysical);
+        if (translation != TLB_NONE)
+        {
+            *target = other;
+            return translation;
+        }
+    }
+    *target = NULL;
+    return TLB_NONE;
+}
+
+/**
+    Looks the image of a target up in the warm cache, taking its parsed 
+    headers and a copy of its entry and reference checksums
+    
+    @note Must be called at IRQL = 0, once the header is mapped in
+    @param target Pointer to the target
+    @param imageSize Number of bytes in the image
+    @return 1 if the image was cached
+*/
+static uint8 splitWarmLookup(SplitTarget *target, uint32 imageSize)
+{
+    WarmEntry *entry;
+    uint32 slot;
+    
+    target->Warm.TimeDateStamp = peGetTimeDateStamp(target->PePtr);
+    target->Warm.HeaderDigest = warmDigestBuffer(target->PePtr, PAGE_SIZE);
+    target->Warm.ImageBase = (uint32) target->PeVirt;
+    target->Warm.SizeOfImage = imageSize;
+    
+    ExAcquireFastMutex(&SplitWarmLock);
+    entry = warmLookup(&SplitWarm, &target->Warm);
+    if (entry != NULL)
+    {
+        slot = entry - SplitWarmEntries;
+        target->ImageInfo = SplitWarmInfo[slot];
+        target->WarmCached = *entry;
+        if ((entry->Flags & WARM_FLAG_REFERENCE) && SplitWarmReference[slot] != NULL)
+        {
+            target->WarmReference = (uint32 *) ExAllocatePoolWithTag(NonPagedPool,
+                                        SplitWarmReferencePages[slot] * sizeof(uint32), 
+                                        '8gaT');
+        }
+        if (target->WarmReference != NULL)
+        {
+            RtlCopyMemory(target->WarmReference, SplitWarmReference[slot],
+                          SplitWarmReferencePages[slot] * sizeof(uint32));
+            target->WarmReferencePages = SplitWarmReferencePages[slot];
+        }
+    }
+    ExReleaseFastMutex(&SplitWarmLock);
+    return entry != NULL;
+}
+
+/**
+    Records the setup results of a target's image in the warm cache, for the
+    next launch of the image
+    
+    @note Must be called at IRQL = 0, once the measurement is prepared
+    @param target Pointer to the target, its FrameDigest must be set
+    @param verified Set if the image was verified against its policy's digest
+*/
+static void splitWarmStore(SplitTarget *target, uint8 verified)
+{
+    WarmEntry *entry;
+    uint32 slot, numPages = target->ExecJob.NumPages;
+    
+    ExAcquireFastMutex(&SplitWarmLock);
+    entry = warmStore(&SplitWarm, &target->Warm);
+    if (entry == NULL)
+    {
+        ExReleaseFastMutex(&SplitWarmLock);
+        return;
+    }
+    slot = entry - SplitWarmEntries;
+    SplitWarmInfo[slot] = target->ImageInfo;
+    // What was found out on other frames no longer holds
+    if (entry->FrameDigest != target->FrameDigest)
+        entry->Flags = 0;
+    entry->FrameDigest = target->FrameDigest;
+    if (verified)
+    {
+        entry->Flags |= WARM_FLAG_VERIFIED;
+        entry->Digest = target->Digest;
+    }
+    
+    if (target->SchedStorage != NULL && !(entry->Flags & WARM_FLAG_REFERENCE))
+    {
+        if (SplitWarmReferencePages[slot] != numPages && SplitWarmReference[slot] != NULL)
+        {
+            ExFreePoolWithTag(SplitWarmReference[slot], '8gaT');
+            SplitWarmReference[slot] = NULL;
+        }
+        if (SplitWarmReference[slot] == NULL)
+        {
+            SplitWarmReference[slot] = (uint32 *) ExAllocatePoolWithTag(NonPagedPool,
+                                            numPages * sizeof(uint32), '8gaT');
+        }
+        SplitWarmReferencePages[slot] = (SplitWarmReference[slot] != NULL) ? numPages : 0;
+        if (SplitWarmReference[slot] != NULL)
+        {
+            RtlCopyMemory(SplitWarmReference[slot], target->Sched.Reference,
+                          numPages * sizeof(uint32));
+            entry->Flags |= WARM_FLAG_REFERENCE;
+        }
+    }
+    ExReleaseFastMutex(&SplitWarmLock);
+}
+
+/**
+    Locks the pages of a target which are armed into memory, with LAZY_SPLIT
+    the executable sections with one MDL per section and the rest of the 
+    image is left pageable, without it the whole image
+    
+    @note Must be called at IRQL = 0, once the image is parsed. Frames which
+    are re-armed later are locked by splitRelockWorker. Nothing is locked 
+    once the process is exiting.
+    @param target Pointer to the target
+    @param imageSize Number of bytes in the image
+    @return Number of pages locked
+*/
+static uint32 splitLockPages(SplitTarget *target, uint32 imageSize)
+{
+    SectionData *section;
+    uint32 i, start, len, numRanges, locked = 0;
+    
+#ifdef LAZY_SPLIT
+    numRanges = target->ImageInfo.NumExecSections;
+#else
+    numRanges = 1;
+#endif
+    ExAcquireFastMutex(&target->LockMutex);
+    for (i = 0; !target->SetupCancel && i < numRanges; i++)
+    {
+#ifdef LAZY_SPLIT
+        // The same pages peIsExecPage counts as executable
+        section = &target->ImageInfo.ExecSections[i];
+        start = section->VirtualAddress & ~(PAGE_SIZE - 1);
+        len = (section->Size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+#else
+        // Every page of the image is armed
+        section = NULL;
+        start = 0;
+        len = imageSize;
+#endif
+        if (start >= imageSize)
+            continue;
+        if (len > imageSize - start)
+            len = imageSize - start;
+        
+        target->LockedMdls[i] = pagingLockProcessMemory((uint8 *) target->PeVirt + start, 
+                                                        len, target->Proc, 
+                                                        &target->ApcState);
+        if (target->LockedMdls[i] != NULL)
+            locked += len / PAGE_SIZE;
+        else if (VDEBUG)
+            DbgPrint("Unable to lock %x bytes at %x\r\n", len, start);
+    }
+    ExReleaseFastMutex(&target->LockMutex);
+    return locked;
+}
+
+/**
+    Unlocks every page locked for a target
+    
+    @note Must be called at IRQL = 0. The process cannot exit with pages 
+    still locked, so its exit calls this without waiting for the setup.
+    @param target Pointer to the target
+*/
+static void splitReleaseLocks(SplitTarget *target)
+{
+    KAPC_STATE apcState;
+    uint32 i;
+    
+    // The setup attaches with the target's APC state meanwhile
+    ExAcquireFastMutex(&target->LockMutex);
+    if (target->RelocMdl != NULL)
+    {
+        pagingUnlockProcessMemory(target->Proc, &apcState, target->RelocMdl);
+        target->RelocMdl = NULL;
+    }
+    for (i = 0; i < PE_MAX_EXEC_SECTIONS; i++)
+    {
+        if (target->LockedMdls[i] != NULL)
+        {
+            pagingUnlockProcessMemory(target->Proc, &apcState, target->LockedMdls[i]);
+            target->LockedMdls[i] = NULL;
+        }
+    }
+    for (i = 0; target->RelockMdls != NULL && i < target->Translations.Count; i++)
+    {
+        if (target->RelockMdls[i] != NULL)
+        {
+            pagingUnlockProcessMemory(target->Proc, &apcState, target->RelockMdls[i]);
+            target->RelockMdls[i] = NULL;
+        }
+    }
+    ExReleaseFastMutex(&target->LockMutex);
+}
+
+/**
+    Finds the other user mappings of the target's executable frames with one
+    walk of its page tables, the digest of the image says nothing about 
+    writes made through them
+    
+    @note Must be called at IRQL = 0, once the translations are filled in. 
+    Pages with a writable alias are marked active so the periodic measurement
+    looks at them first.
+    @param target Pointer to the target
+    @return Number of writable aliases outside the image, or 
+    SPLIT_ALIASES_UNKNOWN if not all of them could be found
+*/
+static uint32 splitFindAliases(SplitTarget *target)
+{
+    ReverseMap *map = NULL;
+    RmapEntry *storage = NULL;
+    uint32 *first = NULL, *count = NULL;
+    uint32 numPages = target->Size / PAGE_SIZE, maxEntries, minPfn = ~0, maxPfn = 0;
+    uint32 i, j, va, writable = 0;
+    
+    const uint32 tag = '5gaT';
+    
+    for (i = 0; i < numPages; i++)
+    {
+        if (target->Pfns[i] == 0 || !peIsExecPage(&target->ImageInfo, i * PAGE_SIZE))
+            continue;
+        if (target->Pfns[i] < minPfn)
+            minPfn = target->Pfns[i];
+        if (target->Pfns[i] > maxPfn)
+            maxPfn = target->Pfns[i];
+    }
+    if (minPfn > maxPfn)
+        return 0;
+    
+    maxEntries = numPages * SPLIT_ALIAS_ENTRIES_PER_PAGE + SPLIT_ALIAS_ENTRIES_EXTRA;
+    map = (ReverseMap *) ExAllocatePoolWithTag(NonPagedPool, sizeof(ReverseMap), tag);
+    storage = (RmapEntry *) ExAllocatePoolWithTag(NonPagedPool, 
+                                                  maxEntries * sizeof(RmapEntry), tag);
+    first = (uint32 *) ExAllocatePoolWithTag(NonPagedPool, numPages * sizeof(uint32), tag);
+    count = (uint32 *) ExAllocatePoolWithTag(NonPagedPool, numPages * sizeof(uint32), tag);
+    if (map == NULL || storage == NULL || first == NULL || count == NULL)
+    {
+        writable = SPLIT_ALIASES_UNKNOWN;
+        goto out;
+    }
+    
+    // Kernel mappings cannot be written from the process, only walk its half
+    rmapInit(map, storage, maxEntries, minPfn, maxPfn + 1, RMAP_FLAG_USER);
+    pagingBuildReverseMap(target->CR3, map, &memContext);
+    rmapLookupBatch(map, target->Pfns, numPages, first, count);
+    for (i = 0; i < numPages; i++)
+    {
+        if (target->Pfns[i] == 0 || !peIsExecPage(&target->ImageInfo, i * PAGE_SIZE))
+            continue;
+        for (j = first[i]; j < first[i] + count[i]; j++)
+        {
+            va = map->Entries[j].Va;
+            if ((va & 0xFFFFF000) - (uint32) target->PeVirt < target->Size ||
+                    (va & (RMAP_VA_WRITE | RMAP_VA_USER)) != (RMAP_VA_WRITE | RMAP_VA_USER))
+                continue;
+            writable++;
+            measureSchedNoteActivity(&target->Sched, i * PAGE_SIZE);
+        }
+    }
+    if (VDEBUG) DbgPrint("Aliases of %x: %d writable of %d mappings in range, %d tables, "
+                         "%d dropped\r\n", target->CR3, writable, map->NumEntries, 
+                         map->TablesScanned, map->Dropped);
+    if (map->Dropped != 0)
+        writable = SPLIT_ALIASES_UNKNOWN;
+    
+  out:
+    if (count != NULL) ExFreePoolWithTag(count, tag);
+    if (first != NULL) ExFreePoolWithTag(first, tag);
+    if (storage != NULL) ExFreePoolWithTag(storage, tag);
+    if (map != NULL) ExFreePoolWithTag(map, tag);
+    return writable;
+}
+
+/**
+    Ends the split of a target and releases everything set up for it, and 
+    frees its slot
+    
+    @note Must be called at IRQL = 0 by whichever of the process exit, the
+    setup and a relock finishes last, see SetupRefs
+*/
+static void splitTeardown(SplitTarget *target)
+{
+    uint32 i;
+    MeasureStats *stats;
+    PEPROCESS proc = target->Proc;
+    
+    const uint32 tag = '5gaT';
+    
+    // The translations are only in use once the split was started
+    if (target->Active)
+    {
+        // VMCALL to stop TLB splitting
+    	__asm
+    	{
+    		PUSHAD
+    		MOV		EAX, VMCALL_END_SPLIT
+            MOV     EBX, target
+    
+    		_emit 0x0F		// VMCALL
+    		_emit 0x01
+    		_emit 0xC1
+    
+    		POPAD
+    	}
+    }
+    // The exit has released the locks, and none are taken once it started
+    
+    if (target->Copy != NULL)
+    {
+        MmFreeContiguousMemory((PVOID) target->Copy);
+        target->Copy = NULL;
+    }
+    
+    if (target->Translations.EptPte != NULL)
+    {
+        freeTranslationArray(target);
+    }
+    
+    if (VDEBUG) DbgPrint("Target %x: pool needed %d pages at peak, %d translations "
+                         "failed for lack of pages\r\n",
+                         target->CR3, memContext.PeakDemand, target->AppendFailures);
+#ifdef LAZY_SPLIT
+    if (VDEBUG) DbgPrint("%d pages split on first use (%d sharing another instance's "
+                         "copy), %d left unsplit for lack of pages\r\n", 
+                         target->LazySplits, target->SharedCopies, target->LazyFailures);
+#endif
+
+    // The timer no longer measures the target, report and release
+    if (target->SchedStorage != NULL)
+    {
+        measureSchedEndInterval(&target->Sched, NULL);
+        for (i = (target->HistoryCount > MEASURE_HISTORY) ?
+                    target->HistoryCount - MEASURE_HISTORY : 0;
+                i < target->HistoryCount && VDEBUG; i++)
+        {
+            stats = &target->History[i % MEASURE_HISTORY];
+            DbgPrint("Interval %d: measured %d/%d pages (%d hot, %d skipped) in "
+                     "%d slices, %d modified, %d passes\r\n", i,
+                     stats->PagesCovered, stats->NumPages, stats->HotPages,
+                     stats->Skipped, stats->Slices, stats->Mismatches,
+                     stats->Passes);
+        }
+        if (VDEBUG) DbgPrint("Total: %d pages measured (%d hot, %d skipped) in %d "
+                             "slices, %d modified, %d passes\r\n",
+                             target->Sched.Total.PagesMeasured,
+                             target->Sched.Total.HotPages, target->Sched.Total.Skipped,
+                             target->Sched.Total.Slices, target->Sched.Total.Mismatches,
+                             target->Sched.Total.Passes);
+        ExFreePoolWithTag(target->SchedStorage, tag);
+        target->SchedStorage = NULL;
+    }
+    if (target->PePtr != NULL)
+    {
+        peUnmapExecPages(&target->ImageInfo, &target->ExecContext);
+        peMapOutImageHeader(target->PePtr);
+        target->PePtr = NULL;
+    }
+    if (target->Phys != NULL)
+    {
+        ExFreePoolWithTag(target->Phys, '3gaT');
+        target->Phys = NULL;
+    }
+    // Drop the reference held since the target was created, an unload waiting
+    // for the setup waits for this too
+    ObDereferenceObject(proc);
+    KeSetEvent(&target->SetupIdle, 0, FALSE);
+    InterlockedExchange(&SplitTargetUsed[target - SplitTargets], 0);
+}
+
+/**
+    Locks the current frame of every translation AppendTlbTranslation 
+    re-armed, in a system worker thread at IRQL = 0
+    
+    @note Holds one of the target's SetupRefs, taken by splitServiceRelocks
+*/
+static void splitRelockWorker(PVOID param)
+{
+    SplitTarget *target = (SplitTarget *) param;
+    KAPC_STATE apcState;
+    uint32 i;
+    
+    // The section MDLs keep holding the old frames, they are released with
+    // the others
+    ExAcquireFastMutex(&target->LockMutex);
+    InterlockedExchange(&target->RelockPending, 0);
+    for (i = 0; !target->SetupCancel && target->Relock != NULL && 
+                i < target->Translations.Count; i++)
+    {
+        if (!target->Relock[i])
+            continue;
+        target->Relock[i] = 0;
+        if (target->RelockMdls[i] != NULL)
+            pagingUnlockProcessMemory(target->Proc, &apcState, target->RelockMdls[i]);
+        target->RelockMdls[i] = pagingLockProcessMemory((uint8 *) target->PeVirt + 
+                                    (target->Translations.Page[i] * PAGE_SIZE),
+                                    PAGE_SIZE, target->Proc, &apcState);
+    }
+    ExReleaseFastMutex(&target->LockMutex);
+    InterlockedExchange(&target->RelockQueued, 0);
+    
+    if (InterlockedDecrement(&target->SetupRefs) == 0)
+        splitTeardown(target);
+    KeSetEvent(&target->RelockIdle, 0, FALSE);
+}
+
+/**
+    Takes one of a target's SetupRefs, unless it was already torn down
+    
+    @return 1 if the reference was taken, 0 otherwise
+*/
+static uint8 splitReferenceTarget(SplitTarget *target)
+{
+    LONG refs;
+    
+    do
+    {
+        refs = target->SetupRefs;
+        if (refs == 0)
+            return 0;
+    } while (InterlockedCompareExchange(&target->SetupRefs, refs + 1, refs) != refs);
+    return 1;
+}
+
+void splitServiceRelocks()
+{
+    SplitTarget *target;
+    uint32 i;
+    
+    for (i = 0; i < SPLIT_MAX_TARGETS; i++)
+    {
+        target = &SplitTargets[i];
+        if (!SplitTargetUsed[i] || !target->RelockPending || target->SetupCancel)
+            continue;
+        if (InterlockedExchange(&target->RelockQueued, 1))
+            continue;
+        if (!splitReferenceTarget(target))
+        {
+            InterlockedExchange(&target->RelockQueued, 0);
+            continue;
+        }
+        KeClearEvent(&target->RelockIdle);
+        ExQueueWorkItem(&target->RelockWork, DelayedWorkQueue);
+    }
+}
+
+/**
+    Sets up the split of a target recorded by processCreationMonitor, in a
+    system worker thread at IRQL = 0 so the process creation is not held up
+    
+    @note The target runs meanwhile on the unsplit identity map. Without
+    LAZY_SPLIT it is suspended from the copy until the split is started, so
+    the copy cannot miss its writes. The split is only started once the copy
+    and the translations are complete, and not at all once the target is 
+    exiting (SetupCancel).
+*/
+static void splitSetupWorker(PVOID param)
+{
+    SplitTarget *target = (SplitTarget *) param;
+    PEPROCESS proc = target->Proc;
+    void *PeHeaderVirt = target->PeVirt;
+    LARGE_INTEGER last = target->SetupQueuedAt;
+    uint32 imageSize, i, numLocked, cr3Value, checksum, relocRva, relocSize;
+    uint64 tscPer100ns;
+    uint8 relocsShort = 0, suspended = 0;
+    uint8 verified = 0, translated;
+    
+    const uint32 tag = '5gaT';
+    
+    splitStageDone(target, SPLIT_STAGE_QUEUE, &last);
+    
+    // Begin critical section
+    // Attach to the target process and grab its CR3 value to use later
+    KeStackAttachProcess(proc, &target->ApcState);
+    __asm
+    {
+        push eax
+        mov eax, cr3
+        mov cr3Value, eax
+        pop eax
+    }
+    KeUnstackDetachProcess(&target->ApcState);
+    // End critical section
+    target->CR3 = cr3Value;
+    
+    // The header is read through the target's page tables
+    target->PePtr = peMapInImageHeader(target->CR3, PeHeaderVirt, &target->PePhys,
+                                       &memContext);
+    if (target->PePtr == NULL)
+        goto done;
+    imageSize = peGetImageSize(target->PePtr);
+    if (VDEBUG) DbgPrint("Image Size: %x bytes Num Pages %d\r\n", imageSize, imageSize / PAGE_SIZE);
+    DbgPrint("Virt %x - %x %x\r\n", PeHeaderVirt, (uint32) PeHeaderVirt + imageSize, target->CR3);
+    
+    splitStageDone(target, SPLIT_STAGE_LOCK, &last);
+    if (target->SetupCancel)
+        goto done;
+    
+    // A relaunch of the same image at the same address has the same headers
+    if (splitWarmLookup(target, imageSize))
+    {
+        target->WarmReused |= SPLIT_WARM_HEADERS;
+    }
+    else
+    {
+        // The relocations are counted through the target's page tables, so 
+        // .reloc is held in memory while the headers are parsed
+        relocRva = peGetRelocSection(target->PePtr, &relocSize);
+        if (relocRva != 0 && relocRva < imageSize && relocSize != 0)
+        {
+            if (relocSize > imageSize - relocRva)
+                relocSize = imageSize - relocRva;
+            ExAcquireFastMutex(&target->LockMutex);
+            if (!target->SetupCancel)
+                target->RelocMdl = pagingLockProcessMemory((uint8 *) PeHeaderVirt + relocRva, 
+                                                           relocSize, proc, &target->ApcState);
+            relocsShort = (target->RelocMdl == NULL);
+            ExReleaseFastMutex(&target->LockMutex);
+        }
+        if (!peBuildImageInfo(target->PePtr, PeHeaderVirt, target->CR3, &target->ImageInfo,
+                              &memContext) && VDEBUG)
+            DbgPrint("Unable to parse the image headers\r\n");
+        // An exit meanwhile has already released it
+        ExAcquireFastMutex(&target->LockMutex);
+        if (target->RelocMdl != NULL)
+            pagingUnlockProcessMemory(proc, &target->ApcState, target->RelocMdl);
+        target->RelocMdl = NULL;
+        ExReleaseFastMutex(&target->LockMutex);
+        if (relocsShort && VDEBUG)
+            DbgPrint("Unable to lock the relocations, their count may be short\r\n");
+    }
+    
+    // Ensure Windows doesn't reuse the physical pages which are split
+    numLocked = splitLockPages(target, imageSize);
+    if (VDEBUG) DbgPrint("Locked %d of %d pages\r\n", numLocked, imageSize / PAGE_SIZE);
+    splitStageDone(target, SPLIT_STAGE_PARSE, &last);
+    if (target->SetupCancel)
+        goto done;
+    
+    target->Size = imageSize;
+#ifndef LAZY_SPLIT
+    // A write after its page was copied would be lost once the split starts
+    suspended = NT_SUCCESS(PsSuspendProcess(proc));
+    if (!suspended && VDEBUG)
+        DbgPrint("Unable to suspend %x for the copy\r\n", target->CR3);
+    
+    target->Copy = (uint8 *) MmAllocateContiguousMemory(imageSize, highestMemoryAddress);
+    if (target->Copy == NULL)
+        goto done;
+    RtlZeroMemory((void *) target->Copy, imageSize);
+    copyPe(proc, &target->ApcState, PeHeaderVirt, target->Copy, imageSize);
+#endif
+    splitStageDone(target, SPLIT_STAGE_COPY, &last);
+    if (target->SetupCancel)
+        goto done;
+    
+    translated = allocateAndFillTranslationArray(target,
+                                                 PeHeaderVirt,
+                                                 target->Copy,
+                                                 imageSize);
+    pagingResetDemand(&memContext);
+    splitStageDone(target, SPLIT_STAGE_TRANSLATE, &last);
+    if (!translated || target->SetupCancel)
+        goto done;
+    // What an earlier launch found out about the executable pages holds as 
+    // long as they are backed by the same frames, a modified page has a 
+    // private frame. Nothing is reused while a page is not present.
+    target->FrameDigest = WARM_DIGEST_INIT;
+    for (i = 0; i < imageSize / PAGE_SIZE && target->FrameDigest != 0; i++)
+    {
+        if (!peIsExecPage(&target->ImageInfo, i * PAGE_SIZE))
+            continue;
+        target->FrameDigest = (target->Pfns[i] != 0) ? 
+                              warmDigestAdd(target->FrameDigest, target->Pfns[i]) : 0;
+    }
+
+#ifdef PERIODIC_MEASURE
+    // Record the reference the periodic measurement compares slices against,
+    // the hypervisor measures through these mappings on preemption timer exits
+    target->ExecContext.ImageBase = (uint32) PeHeaderVirt;
+    target->ExecContext.PhysArr = target->Phys;
+    if (ProcessorSupportsPreemptionTimer && (target->Options & POLICY_OPT_MEASURE) &&
+            peMapExecPages(&target->ImageInfo, &target->ExecContext))
+    {
+        peInitMeasureJob(&target->ImageInfo, &target->ExecJob, &target->ExecContext);
+        target->SchedStorage = (uint32 *) ExAllocatePoolWithTag(NonPagedPool,
+                                    measureSchedStorageSize(target->ExecJob.NumPages), tag);
+    }
+    if (target->SchedStorage != NULL)
+    {
+        // The preemption timer counts in TSC ticks, so the scheduler does too
+        tscPer100ns = calibrateTsc();
+        measureIntervalTicks = MEASURE_REPORT_INTERVAL * tscPer100ns;
+        RtlZeroMemory(target->SchedStorage,
+                      measureSchedStorageSize(target->ExecJob.NumPages));
+        measureSchedInit(&target->Sched, &target->ExecJob, target->SchedStorage,
+                         MeasureBudgetPercent,
+                         MEASURE_MIN_DELAY * tscPer100ns,
+                         MEASURE_MAX_DELAY * tscPer100ns,
+                         KeQueryPerformanceCounter(NULL).LowPart ^
+                            (uint32) target->ProcessId);
+        if (target->WarmReference != NULL && target->FrameDigest != 0 &&
+                target->WarmCached.FrameDigest == target->FrameDigest &&
+                target->WarmReferencePages == target->ExecJob.NumPages)
+        {
+            RtlCopyMemory(target->Sched.Reference, target->WarmReference,
+                          target->WarmReferencePages * sizeof(uint32));
+            target->WarmReused |= SPLIT_WARM_REFERENCE;
+        }
+        else
+        {
+            measureSchedCapture(&target->Sched);
+        }
+    }
+    else if (VDEBUG && (target->Options & POLICY_OPT_MEASURE))
+    {
+        DbgPrint("Periodic measurement unavailable\r\n");
+    }
+#endif
+    target->WritableAliases = splitFindAliases(target);
+    
+    // An image which is not the one its policy describes is left unsplit. The
+    // frames can be written in place through another mapping, so the check is
+    // only skipped where the policy asks for it and no such mapping was found.
+    if (target->Options & POLICY_OPT_VERIFY)
+    {
+        if ((target->Options & POLICY_OPT_TRUST_WARM) && target->WritableAliases == 0 &&
+                (target->WarmCached.Flags & WARM_FLAG_VERIFIED) && target->FrameDigest != 0 &&
+                target->WarmCached.Digest == target->Digest &&
+                target->WarmCached.FrameDigest == target->FrameDigest)
+        {
+            target->WarmReused |= SPLIT_WARM_VERIFIED;
+        }
+        else
+        {
+            checksum = peChecksumExecSections(&target->ImageInfo, target->CR3, 
+                                              measureGetProcessorCount(), &memContext);
+            if (checksum != target->Digest)
+            {
+                DbgPrint("Checksum %x of %x does not match the policy (%x)\r\n", 
+                         checksum, target->CR3, target->Digest);
+                goto done;
+            }
+        }
+        verified = 1;
+    }
+    // Headers parsed without all of the relocations are not kept for later
+    if (!relocsShort)
+        splitWarmStore(target, verified);
+    splitStageDone(target, SPLIT_STAGE_MEASURE, &last);
+    if (target->SetupCancel)
+        goto done;
+    
+    // VMCALL to start the TLB splitting, the hypervisor adds the target to
+    // the CR3 hash table and sets Active
+	__asm
+	{
+		PUSHAD
+		MOV		EAX, VMCALL_INIT_SPLIT
+        MOV     EBX, target
+    
+		_emit 0x0F		// VMCALL
+		_emit 0x01
+		_emit 0xC1
+    
+		POPAD
+	}
+    pagingServiceRefill(&memContext);
+    splitServiceRelocks();
+    splitStageDone(target, SPLIT_STAGE_ACTIVATE, &last);
+    if (suspended)
+    {
+        PsResumeProcess(proc);
+        suspended = 0;
+    }
+    
+    // A verified image's checksum is the policy's
+    if (VDEBUG) DbgPrint("Checksum of proc: %x\r\n", verified ? target->Digest :
+                     peChecksumExecSections(&target->ImageInfo, target->CR3,
+                                            measureGetProcessorCount(), &memContext));
+    splitStageDone(target, SPLIT_STAGE_CHECKSUM, &last);
+    //pePrintSections(&target->ImageInfo);
+    
+  done:
+    if (suspended)
+        PsResumeProcess(proc);
+    if (target->WarmReference != NULL)
+    {
+        ExFreePoolWithTag(target->WarmReference, '8gaT');
+        target->WarmReference = NULL;
+    }
+    if (VDEBUG) DbgPrint("Split setup of %x (us): callback %d, queued %d, lock %d, parse %d, "
+                         "copy %d, translate %d, measure %d, activate %d, checksum %d, "
+                         "warm %x%s\r\n",
+                         target->CR3,
+                         target->SetupMicros[SPLIT_STAGE_CALLBACK],
+                         target->SetupMicros[SPLIT_STAGE_QUEUE],
+                         target->SetupMicros[SPLIT_STAGE_LOCK],
+                         target->SetupMicros[SPLIT_STAGE_PARSE],
+                         target->SetupMicros[SPLIT_STAGE_COPY],
+                         target->SetupMicros[SPLIT_STAGE_TRANSLATE],
+                         target->SetupMicros[SPLIT_STAGE_MEASURE],
+                         target->SetupMicros[SPLIT_STAGE_ACTIVATE],
+                         target->SetupMicros[SPLIT_STAGE_CHECKSUM],
+                         target->WarmReused,
+                         target->Active ? "" : ", not started");
+    
+    // An exit during the setup left the teardown to it
+    if (InterlockedDecrement(&target->SetupRefs) == 0)
+        splitTeardown(target);
+    else
+        KeSetEvent(&target->SetupIdle, 0, FALSE);
+}
+
+void initSplitSetup()
+{
+    uint32 i;
+    
+    for (i = 0; i < SPLIT_MAX_TARGETS; i++)
+    {
+        KeInitializeEvent(&SplitTargets[i].SetupIdle, NotificationEvent, TRUE);
+        KeInitializeEvent(&SplitTargets[i].RelockIdle, NotificationEvent, TRUE);
+    }
+    dedupInit(&SplitCopyStore, SplitCopyEntries, SPLIT_COPY_ENTRIES, 
+              SplitCopyBuckets, SPLIT_COPY_BUCKETS);
+    warmInit(&SplitWarm, SplitWarmEntries, SPLIT_WARM_ENTRIES);
+    ExInitializeFastMutex(&SplitWarmLock);
+}
+
+void freeSplitWarmCache()
+{
+    uint32 i;
+    
+    if (VDEBUG) DbgPrint("Warm cache: %d launches found their image, %d did not, "
+                         "%d images evicted\r\n", 
+                         SplitWarm.Hits, SplitWarm.Misses, SplitWarm.Evictions);
+    for (i = 0; i < SPLIT_WARM_ENTRIES; i++)
+    {
+        if (SplitWarmReference[i] != NULL)
+            ExFreePoolWithTag(SplitWarmReference[i], '8gaT');
+        SplitWarmReference[i] = NULL;
+        SplitWarmReferencePages[i] = 0;
+    }
+    warmInit(&SplitWarm, SplitWarmEntries, SPLIT_WARM_ENTRIES);
+}
+
+/**
+    Stops and waits for the split setup of a target, and for a relock of its
+    frames
+*/
+static void waitForTargetSetup(SplitTarget *target)
+{
+    target->SetupCancel = 1;
+    KeWaitForSingleObject(&target->SetupIdle, Executive, KernelMode, FALSE, NULL);
+    KeWaitForSingleObject(&target->RelockIdle, Executive, KernelMode, FALSE, NULL);
+}
+
+void waitForSplitSetup()
+{
+    uint32 i;
+    
+    for (i = 0; i < SPLIT_MAX_TARGETS; i++)
+    {
+        if (SplitTargetUsed[i])
+            waitForTargetSetup(&SplitTargets[i]);
+    }
+}
+
+/**
+    Returns the target of a process, or NULL if it is not split
+    
+    @note The target holds a reference to the process, so its ID is not reused
+*/
+static SplitTarget * findSplitTarget(HANDLE processId)
+{
+    uint32 i;
+    
+    for (i = 0; i < SPLIT_MAX_TARGETS; i++)
+    {
+        if (SplitTargetUsed[i] && SplitTargets[i].ProcessId == processId)
+            return &SplitTargets[i];
+    }
+    return NULL;
+}
+
+void loadSplitPolicy(PUNICODE_STRING registryPath)
+{
+    const uint32 tag = '7gaT';
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING valueName;
+    HANDLE key = NULL;
+    PKEY_VALUE_PARTIAL_INFORMATION value = NULL;
+    ULONG size = 0;
+    uint8 defaultBlob[sizeof(PolicyBlobHeader) + sizeof(PolicyBlobEntry)] = {0};
+    PolicyBlobHeader *header = (PolicyBlobHeader *) defaultBlob;
+    PolicyBlobEntry *entry = (PolicyBlobEntry *) (defaultBlob + sizeof(PolicyBlobHeader));
+    const uint8 *blob = defaultBlob;
+    uint32 len = sizeof(defaultBlob), count;
+    
+    // Without a blob in the registry the compiled in target is split and
+    // measured, like before policies existed
+    header->Magic = POLICY_MAGIC;
+    header->Version = POLICY_VERSION;
+    header->NumEntries = 1;
+    strncpy(entry->Name, TargetAppName, POLICY_NAME_LEN - 1);
+    entry->Options = POLICY_OPT_MEASURE;
+    
+    RtlInitUnicodeString(&valueName, POLICY_REG_VALUE);
+    InitializeObjectAttributes(&attr, registryPath, OBJ_KERNEL_HANDLE | OBJ_CASE_INSENSITIVE, 
+                               NULL, NULL);
+    if (registryPath != NULL && NT_SUCCESS(ZwOpenKey(&key, KEY_READ, &attr)))
+    {
+        ZwQueryValueKey(key, &valueName, KeyValuePartialInformation, NULL, 0, &size);
+        if (size > 0)
+            value = (PKEY_VALUE_PARTIAL_INFORMATION) ExAllocatePoolWithTag(PagedPool, size, tag);
+        if (value != NULL && 
+                NT_SUCCESS(ZwQueryValueKey(key, &valueName, KeyValuePartialInformation, 
+                                           value, size, &size)) &&
+                value->Type == REG_BINARY && 
+                policyBlobEntries(value->Data, value->DataLength) != 0)
+        {
+            blob = value->Data;
+            len = value->DataLength;
+        }
+        else if (VDEBUG)
+        {
+            DbgPrint("No valid policy blob, splitting %s\r\n", TargetAppName);
+        }
+        ZwClose(key);
+    }
+    
+    count = policyBlobEntries(blob, len);
+    SplitPolicyStorage = ExAllocatePoolWithTag(NonPagedPool, policyStorageSize(count), tag);
+    if (SplitPolicyStorage == NULL || 
+            !policyLoad(&SplitPolicy, blob, len, SplitPolicyStorage, policyStorageSize(count)))
+    {
+        DbgPrint("Unable to load the policy, no process will be split\r\n");
+    }
+    else if (VDEBUG)
+    {
+        DbgPrint("%d policies loaded, %d duplicates dropped\r\n", 
+                 SplitPolicy.NumEntries, SplitPolicy.Duplicates);
+    }
+    if (value != NULL)
+        ExFreePoolWithTag(value, tag);
+}
+
+void freeSplitPolicy()
+{
+    RtlZeroMemory(&SplitPolicy, sizeof(SplitPolicy));
+    if (SplitPolicyStorage != NULL)
+    {
+        ExFreePoolWithTag(SplitPolicyStorage, '7gaT');
+        SplitPolicyStorage = NULL;
+    }
+}
+
+/**
+    Claims a free target slot, released by clearing its SplitTargetUsed
+    
+    @return Pointer to the target, or NULL if SPLIT_MAX_TARGETS are in use
+*/
+static SplitTarget * claimSplitTarget()
+{
+    uint32 i;
+    
+    for (i = 0; i < SPLIT_MAX_TARGETS; i++)
+    {
+        if (InterlockedCompareExchange(&SplitTargetUsed[i], 1, 0) == 0)
+            return &SplitTargets[i];
+    }
+    return NULL;
+}
+
+// This runs at a lower IRQL, so it can use the kernel memory functions
+void processCreationMonitor(HANDLE ParentId, HANDLE ProcessId, BOOLEAN Create)
+{
+    PEPROCESS proc = NULL;
+    SplitTarget *target = NULL;
+    const PolicyEntry *policy;
+    LARGE_INTEGER last;
+    char *procName;
+    
+    // Set to anywhere inthe 4GB range
+    highestMemoryAddress.LowPart = ~0;
+    
+    // Exits allocate in VMX root where no work can be queued, process events
+    // are where the guest picks up the refills and relocks they requested
+    pagingServiceRefill(&memContext);
+    splitServiceRelocks();
+    
+    // An exiting process only matters if it is split, which its ID tells 
+    // without looking the process up
+    if (!Create)
+    {
+        if ((target = findSplitTarget(ProcessId)) != NULL)
+        {
+            if (VDEBUG) DbgPrint("Application quitting %s\r\n", 
+                                 PsGetProcessImageFileName(target->Proc));
+            // Only the locks have to go before the address space does, the
+            // rest is left to a setup which is still running
+            target->SetupCancel = 1;
+            splitReleaseLocks(target);
+            if (InterlockedDecrement(&target->SetupRefs) == 0)
+                splitTeardown(target);
+        }
+        return;
+    }
+    
+    // Get the 8.3 image name
+    if (!NT_SUCCESS(PsLookupProcessByProcessId(ProcessId, &proc)))
+        return;
+    procName = PsGetProcessImageFileName(proc);
+    
+    // Check if this is a target process, every instance gets its own split
+    policy = policyLookup(&SplitPolicy, procName);
+    if (policy == NULL)
+    {
+        ObDereferenceObject(proc);
+        return;
+    }
+    if (VDEBUG) DbgPrint("New Process Created! %s\r\n", procName);
+    
+    last = KeQueryPerformanceCounter(NULL);
+    if ((target = claimSplitTarget()) == NULL)
+    {
+        if (VDEBUG) DbgPrint("Already splitting %d processes\r\n", SPLIT_MAX_TARGETS);
+        ObDereferenceObject(proc);
+        return;
+    }
+    
+    // Only record the target here, the setup is done by a worker and keeps
+    // the reference to the process
+    RtlZeroMemory(target, sizeof(SplitTarget));
+    target->Proc = proc;
+    target->ProcessId = ProcessId;
+    target->PeVirt = PsGetProcessSectionBaseAddress(proc);
+    target->Options = policy->Options;
+    target->Digest = policy->Digest;
+    target->Warm.NameHash = policy->Hash;
+    target->SetupRefs = 2;
+    ExInitializeFastMutex(&target->LockMutex);
+    KeInitializeEvent(&target->SetupIdle, NotificationEvent, FALSE);
+    ExInitializeWorkItem(&target->SetupWork, splitSetupWorker, target);
+    KeInitializeEvent(&target->RelockIdle, NotificationEvent, TRUE);
+    ExInitializeWorkItem(&target->RelockWork, splitRelockWorker, target);
+    
+    // The worker owns the target once it is queued
+    splitStageDone(target, SPLIT_STAGE_CALLBACK, &last);
+    target->SetupQueuedAt = last;
+    ExQueueWorkItem(&target->SetupWork, CriticalWorkQueue);
+}
+
+void startPeriodicMeasure(SplitTarget *target)
+{
+#ifdef PERIODIC_MEASURE
+    if (target->Sched.Job == NULL)
+        return;
+    target->IntervalStart = readTsc();
+    if (measureNext == NULL)
+        measureNext = target;
+    SetPreemptionTimer((uint32) (target->Sched.MinDelay >> PreemptionTimerShift));
+#endif
+}
+
+void stopPeriodicMeasure()
+{
+    DisablePreemptionTimer();
+}
+
+/**
+    Returns the next target after prev which is measured periodically, in
+    turn, or NULL if there is none
+*/
+static SplitTarget * nextMeasuredTarget(SplitTarget *prev)
+{
+    SplitTarget *target = prev;
+    uint32 i;
+    
+    for (i = 0; i <= SplitActiveTargets; i++)
+    {
+        target = splitNextTarget(target);
+        if (target == NULL)
+            target = splitNextTarget(NULL);
+        if (target == NULL)
+            return NULL;
+        if (target->Sched.Job != NULL)
+            return target;
+    }
+    return NULL;
+}
+
+void exit_reason_dispatch_handler__exec_preempt(struct GUEST_STATE * GuestSTATE)
+{
+    uint64 start = readTsc(), delay;
+    SplitTarget *target = measureNext;
+    
+    if (target == NULL || target->Sched.Job == NULL)
+        target = nextMeasuredTarget(target);
+    if (target == NULL)
+    {
+        stopPeriodicMeasure();
+        return;
+    }
+    
+    // Measure one slice of this target and pace the next one to stay within
+    // the CPU budget, the targets share the budget by taking turns
+    if (measureSchedSlice(&target->Sched) != 0)
+    {
+        Log("Modified executable page at offset", target->Sched.LastMismatch);
+    }
+    delay = measureSchedNextDelay(&target->Sched, readTsc() - start) >> PreemptionTimerShift;
+    
+    if (start - target->IntervalStart >= measureIntervalTicks)
+    {
+        measureSchedEndInterval(&target->Sched,
+                                &target->History[target->HistoryCount % MEASURE_HISTORY]);
+        target->HistoryCount++;
+        target->IntervalStart = start;
+    }
+    measureNext = nextMeasuredTarget(target);
+    
+    SetPreemptionTimer((delay > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32) delay);
+}
+
+void measurePe(SplitTarget *target)
+{
+    if (target == NULL || target->PeVirt == NULL)
+        return;
+    // VMCALL to stop measure without the EPT TLB splitting
+	__asm
+	{
+		PUSHAD
+		MOV		EAX, VMCALL_MEASURE
+        MOV     EBX, target
+    
+		_emit 0x0F		// VMCALL
+		_emit 0x01
+		_emit 0xC1
+    
+		POPAD
+	}
+    
+}
+
+void copyPe(PEPROCESS proc, PKAPC_STATE apc, uint8 *srcPtr, uint8 *targetPtr, uint32 len)
+{
+    if (srcPtr == NULL || targetPtr == NULL)
+        return;
+        
+    // Attach to the process and copy the image to the passed buffer
+    KeStackAttachProcess(proc, apc); 
+    
+    memcpy(targetPtr, srcPtr, len);
+    
+    KeUnstackDetachProcess(apc);
+}
+
+uint8 allocateAndFillTranslationArray(SplitTarget *target,
+                                      uint8 *codePtr,
+                                      uint8 *dataPtr, 
+                                      uint32 len)
+{
+    const uint32 tag = '3gaT';
+    uint32 i = 0, n = 0, numPages = len / 0x1000, numArmed = 0, present;
+    TlbTranslations *tlb = &target->Translations;
+    uint8 *columns, failed;
+                                                 
+    PHYSICAL_ADDRESS tmpPhys = {0};
+                                                 
+    PHYSICAL_ADDRESS *targetPhys;
+    uint32 *targetPfns, *seenPfns;
+    
+    // The page column holds 16-bit page numbers
+    if (numPages > TLB_MAX_PAGES)
+        return 0;
+#ifdef LAZY_SPLIT
+    for (i = 0; i < numPages; i++)
+    {
+        numArmed += peIsExecPage(&target->ImageInfo, i * PAGE_SIZE);
+    }
+#else
+    numArmed = numPages;
+#endif
+    
+    // Every column in one block, the widest first so each stays aligned
+    columns = (uint8 *) ExAllocatePoolWithTag(NonPagedPool, 
+                                              (numArmed + 1) * TLB_BYTES_PER_PAGE, tag);
+    targetPhys = (PHYSICAL_ADDRESS *) ExAllocatePoolWithTag(NonPagedPool,
+                                                 (numPages + 1) * sizeof(PHYSICAL_ADDRESS),
+                                                 tag);
+    targetPfns = (uint32 *) ExAllocatePoolWithTag(NonPagedPool,
+                                                 (numPages + 1) * sizeof(uint32),
+                                                 tag);
+    seenPfns = (uint32 *) ExAllocatePoolWithTag(NonPagedPool,
+                                                (numPages + 1) * sizeof(uint32),
+                                                tag);
+    // A re-armed frame's MDL, and the flag which asks the guest to lock it
+    target->RelockMdls = (PMDLX *) ExAllocatePoolWithTag(NonPagedPool,
+                                                 (numArmed + 1) * (sizeof(PMDLX) + 1),
+                                                 tag);
+    failed = (columns == NULL || targetPfns == NULL || seenPfns == NULL || targetPhys == NULL ||
+              target->RelockMdls == NULL);
+#ifdef LAZY_SPLIT
+    target->Copies = (DedupEntry **) ExAllocatePoolWithTag(NonPagedPool,
+                                                 (numArmed + 1) * sizeof(DedupEntry *),
+                                                 tag);
+    if (target->Copies != NULL)
+        RtlZeroMemory(target->Copies, (numArmed + 1) * sizeof(DedupEntry *));
+    failed |= (target->Copies == NULL);
+#endif
+
+    if (failed)
+    {
+        // The target is left unsplit, the worker gives up on it
+        if (columns != NULL) ExFreePoolWithTag(columns, tag);
+        if (targetPhys != NULL) ExFreePoolWithTag(targetPhys, tag);
+        if (targetPfns != NULL) ExFreePoolWithTag(targetPfns, tag);
+        if (seenPfns != NULL) ExFreePoolWithTag(seenPfns, tag);
+        if (target->RelockMdls != NULL) ExFreePoolWithTag(target->RelockMdls, tag);
+        target->RelockMdls = NULL;
+#ifdef LAZY_SPLIT
+        if (target->Copies != NULL) ExFreePoolWithTag(target->Copies, tag);
+        target->Copies = NULL;
+#endif
+        return 0;
+    }
+    
+    RtlZeroMemory(columns, (numArmed + 1) * TLB_BYTES_PER_PAGE);
+    RtlZeroMemory(target->RelockMdls, (numArmed + 1) * (sizeof(PMDLX) + 1));
+    target->Relock = (uint8 *) (target->RelockMdls + numArmed + 1);
+    tlb->EptPte = (EptPteEntry **) columns;
+    tlb->CodePfn = (uint32 *) (tlb->EptPte + numArmed + 1);
+    tlb->DataPfn = tlb->CodePfn + numArmed + 1;
+    tlb->Page = (uint16 *) (tlb->DataPfn + numArmed + 1);
+    tlb->Flags = (uint8 *) (tlb->Page + numArmed + 1);
+    // Translate the whole image at once, one page table per 4 MiB
+    present = pagingTranslateRange(target->CR3, codePtr, numPages, targetPfns, NULL, 
+                                   &memContext);
+    
+    // Loop through the VA space of the PE image and fill in the physical addresses
+    for (i = 0; i < numPages; i++)
+    {
+        tmpPhys.QuadPart = (uint64) targetPfns[i] << 12;
+        targetPhys[i] = tmpPhys;
+#ifdef LAZY_SPLIT
+        // Only executable pages are armed, each one's copy is made on first use
+        if (!peIsExecPage(&target->ImageInfo, i * PAGE_SIZE))
+            continue;
+#endif
+        // Only frames below 4 GiB can be split, the copy is allocated there too
+        tlb->CodePfn[n] = (targetPfns[i] < SPLIT_PFN_LIMIT) ? targetPfns[i] : 0;
+#ifndef LAZY_SPLIT
+        tmpPhys = MmGetPhysicalAddress((PVOID) ((uint32) dataPtr + (i * PAGE_SIZE)));
+        tlb->DataPfn[n] = (uint32) (tmpPhys.QuadPart >> 12);
+#endif
+        tlb->Flags[n] = CODE_EPT;
+        tlb->Page[n] = (uint16) i;
+        n++;
+    }
+    tlb->Count = n;
+    
+    if (VDEBUG) DbgPrint("%d of %d image pages present, %d armed\r\n", present, numPages, n);
+    target->Phys = targetPhys;
+    target->Pfns = targetPfns;
+    // The translations match these frames, the CR3 hook only looks at pages
+    // whose frame changes from here on
+    RtlCopyMemory(seenPfns, targetPfns, numPages * sizeof(uint32));
+    target->SeenPfns = seenPfns;
+    return 1;
+}
+
+void freeTranslationArray(SplitTarget *target)
+{
+    const uint32 tag = '3gaT';
+#ifdef LAZY_SPLIT
+    // end_split released the copies in VMX root, where they are shared
+    ExFreePoolWithTag(target->Copies, tag);
+    target->Copies = NULL;
+#endif
+    ExFreePoolWithTag(target->Pfns, tag);
+    target->Pfns = NULL;
+    ExFreePoolWithTag(target->SeenPfns, tag);
+    target->SeenPfns = NULL;
+    // The exit unlocked every MDL in it
+    ExFreePoolWithTag(target->RelockMdls, tag);
+    target->RelockMdls = NULL;
+    target->Relock = NULL;
+    ExFreePoolWithTag(target->Translations.EptPte, tag);
+    RtlZeroMemory(&target->Translations, sizeof(TlbTranslations));
+}
+
+uint8 splitLazyPage(SplitTarget *target, uint32 index)
+{
+    PHYSICAL_ADDRESS phys = {0}, copyPhys = {0};
+    uint8 *copy = NULL, *code;
+    DedupEntry *entry = NULL;
+    uint32 digest, codePfn = target->Translations.CodePfn[index];
+    
+    if (target->Copies == NULL || codePfn == 0)
+        return 0;
+    phys.LowPart = codePfn << 12;
+    code = (uint8 *) MapInMemory(&memContext, phys, PAGE_SIZE);
+    if (code == NULL)
+    {
+        target->LazyFailures++;
+        return 0;
+    }
+    
+    // Instances of an image run the same frames, so a copy another target
+    // made of this frame serves as long as the frame has not changed since
+    digest = dedupDigest(code);
+    entry = dedupAcquire(&SplitCopyStore, codePfn, code, digest);
+    if (entry != NULL)
+    {
+        target->SharedCopies++;
+    }
+    else
+    {
+        copy = (uint8 *) pagingAllocPage(&memContext);
+        // The translations hold 32-bit addresses
+        if (copy != NULL)
+            copyPhys = MmGetPhysicalAddress((void *) copy);
+        if (copy != NULL && copyPhys.HighPart == 0)
+        {
+            memcpy(copy, code, PAGE_SIZE);
+            entry = dedupInsert(&SplitCopyStore, codePfn, digest, copy, copyPhys.LowPart);
+        }
+        if (entry == NULL && copy != NULL)
+            pagingFreePage(&memContext, copy);
+    }
+    MapOutMemory(&memContext, code, PAGE_SIZE);
+    if (entry == NULL)
+    {
+        target->LazyFailures++;
+        return 0;
+    }
+    
+    target->Copies[index] = entry;
+    target->Translations.DataPfn[index] = entry->CopyPhys >> 12;
+    target->LazySplits++;
+    return 1;
+}
+
+void splitReleaseCopies(SplitTarget *target)
+{
+    uint32 i;
+    uint8 *copy;
+    
+    if (target->Copies == NULL)
+        return;
+    for (i = 0; i < target->Translations.Count; i++)
+    {
+        if (target->Copies[i] == NULL)
+            continue;
+        copy = dedupRelease(&SplitCopyStore, target->Copies[i]);
+        if (copy != NULL)
+            pagingFreePage(&memContext, copy);
+        target->Copies[i] = NULL;
+    }
+}
+
+void * splitTranslationRef(SplitTarget *target, uint32 index)
+{
+    return (void *) (((uint32) (target - SplitTargets) << TLB_REF_INDEX_BITS) | (index + 1));
+}
+
+SplitTarget * splitRefTarget(void *ref, uint32 *index)
+{
+    uint32 slot = (uint32) ref >> TLB_REF_INDEX_BITS;
+    SplitTarget *target;
+    
+    if (ref == NULL || slot >= SPLIT_MAX_TARGETS)
+        return NULL;
+    // The slot may have been torn down or reused since the reference was made
+    target = &SplitTargets[slot];
+    *index = ((uint32) ref & ((1 << TLB_REF_INDEX_BITS) - 1)) - 1;
+    if (!target->Active || target->Translations.EptPte == NULL || 
+            *index >= target->Translations.Count)
+        return NULL;
+    return target;
+}
+
+uint32 splitTranslationVa(SplitTarget *target, uint32 index)
+{
+    return (uint32) target->PeVirt + ((uint32) target->Translations.Page[index] << 12);
+}
+
+uint32 getTlbTranslation(TlbTranslations *tlb, uint32 guestPhysical)
+{
+    uint32 i, pfn = guestPhysical >> 12;
+    
+    // Each scan reads a single column, the flag is only checked on a match
+    for (i = 0; i < tlb->Count; i++)
+    {
+        if (tlb->CodePfn[i] == pfn && tlb->Flags[i] == CODE_EPT)
+            return i;
+    }
+    for (i = 0; i < tlb->Count; i++)
+    {
+        if (tlb->DataPfn[i] == pfn && tlb->Flags[i] == DATA_EPT)
+            return i;
+    }
+    return TLB_NONE;
+}
+
+/**
+    Returns the index of the translation of an image page, the translations 
+    are sorted by page
+*/
+static uint32 findTlbPage(TlbTranslations *tlb, uint32 page)
+{
+    uint32 low = 0, high = tlb->Count, mid;
+    
+    while (low < high)
+    {
+        mid = (low + high) / 2;
+        if (tlb->Page[mid] < page)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return (low < tlb->Count && tlb->Page[low] == page) ? low : TLB_NONE;
+}
+
+// This function runs at DIRQL, and must NOT cause any page faults
+uint8 AppendTlbTranslation(SplitTarget *target, uint32 phys, uint8 * virt)
+{
+    TlbTranslations *tlb = &target->Translations;
+    uint32 i = findTlbPage(tlb, ((uint32) virt - (uint32) target->PeVirt) >> 12);
+    EptPteEntry *pte, *newPte;
+    
+    if (i != TLB_NONE)
+    {
+        // Get the EPT PTE of the new frame first, splitting a large page may need
+        // a page from the pool and nothing must change if there is none
+        newPte = EptMapAddressToPteDirql(phys, NULL, &memContext);
+        if (newPte == NULL)
+        {
+            // A refill has been requested, the next CR3 load will retry
+            target->AppendFailures++;
+            return 0;
+        }
+        pte = tlb->EptPte[i];
+        if (pte != NULL)
+        {
+            pte->Present = 1;
+            pte->Write = 1;
+            pte->Execute = 1;
+            pte->PhysAddr = (tlb->Flags[i] == CODE_EPT) ? tlb->CodePfn[i] : tlb->DataPfn[i];
+        }
+        if (tlb->CodePfn[i] == 0 && tlb->DataPfn[i] == 0)
+        {
+            // A lazily armed page which was not present yet, arm its frame and
+            // make the copy on first use like the others
+            tlb->CodePfn[i] = phys >> 12;
+        }
+        else
+        {
+            tlb->DataPfn[i] = phys >> 12;
+            tlb->Flags[i] = DATA_EPT;
+        }
+        newPte->Present = 0;
+        newPte->Write = 0;
+        newPte->Execute = 0;
+        tlb->EptPte[i] = newPte;
+        // No MDL holds the new frame, the guest locks it later
+        if (target->Relock != NULL)
+        {
+            target->Relock[i] = 1;
+            InterlockedExchange(&target->RelockPending, 1);
+        }
+    }
+    return 1;
+}
+
+uint8 *dataPage, *codePage;
+/** Columns of the demo's only translation */
+static EptPteEntry *smallPte[1];
+static uint32 smallCodePfn[1], smallDataPfn[1];
+static uint16 smallPage[1];
+static uint8 smallFlags[1];
+void splitPage()
+{
+    const uint32 tag = '3gaT';
+    PHYSICAL_ADDRESS phys = {0};
+    SplitTarget *tlbptr;
+    
+    // The demo is not running in any process, it only borrows a slot
+    if ((tlbptr = claimSplitTarget()) == NULL)
+        return;
+    RtlZeroMemory(tlbptr, sizeof(SplitTarget));
+    KeInitializeEvent(&tlbptr->SetupIdle, NotificationEvent, TRUE);
+    KeInitializeEvent(&tlbptr->RelockIdle, NotificationEvent, TRUE);
+    dataPage = (uint8 *) ExAllocatePoolWithTag(NonPagedPool, 2 * PAGE_SIZE, tag);
+    codePage = dataPage + PAGE_SIZE;
+    
+    dataPage[0] = 0xFF;
+    codePage[0] = 0xC3;
+    
+    phys = MmGetPhysicalAddress((void *) dataPage);
+    smallDataPfn[0] = phys.LowPart >> 12;
+    phys = MmGetPhysicalAddress((void *) codePage);
+    smallCodePfn[0] = phys.LowPart >> 12;
+    smallFlags[0] = CODE_EPT;
+    tlbptr->PeVirt = (void *) codePage;
+    tlbptr->Translations.Count = 1;
+    tlbptr->Translations.EptPte = smallPte;
+    tlbptr->Translations.CodePfn = smallCodePfn;
+    tlbptr->Translations.DataPfn = smallDataPfn;
+    tlbptr->Translations.Page = smallPage;
+    tlbptr->Translations.Flags = smallFlags;
+    tlbptr->Size = PAGE_SIZE;
+    
+    __asm
+	{
+		PUSHAD
+		MOV		EAX, VMCALL_INIT_SPLIT
+        MOV     EBX, tlbptr
+    
+		_emit 0x0F		// VMCALL
+		_emit 0x01
+		_emit 0xC1
+    
+		POPAD
+	}
+    
+    Log("Found", codePage[0]);
+    codePage[0] = 0xFE;
+    Log("Found", codePage[0]);
+    
+    __asm 
+    {
+        PUSH EAX
+        MOV EAX, codePage
+        CALL EAX
+        POP EAX
+    }
+    
+    __asm
+	{
+		PUSHAD
+		MOV		EAX, VMCALL_END_SPLIT
+        MOV     EBX, tlbptr
+    
+		_emit 0x0F		// VMCALL
+		_emit 0x01
+		_emit 0xC1
+    
+		POPAD
+	}
+    
+    ExFreePoolWithTag(dataPage, tag);
+    InterlockedExchange(&SplitTargetUsed[tlbptr - SplitTargets], 0);
+}
+
+uint32 checksumBuffer(uint8 * ptr, uint32 len)
+{
+    uint32 i, sum = 0;
+    for (i = 0; i < len; i++)
+    {
+        sum += ptr[i];
+    }
+    return sum;
+}
@@ -1,159 +1,460 @@
-/**
-	@file
-	Header which defines structures for monitoring processes
-		
-	@date 1/24/2012
-***************************************************************/
-
-#ifndef _MORE_PROCMON_H_
-#define _MORE_PROCMON_H_
-
-#include "..\stdint.h"
-#include "..\paging.h"
-#include "structs.h"
-
-/** Boolean to monitor processes or not */
-#define MONITOR_PROCS 1
-/** Boolean for whether or not to periodically measure the binary */
-#define PERIODIC_MEASURE 1
-/** VMCALL code to initialize the TLB split */
-#define VMCALL_INIT_SPLIT 0x100F
-/** VMCALL code to end the TLB split */
-#define VMCALL_END_SPLIT 0x200F
-/** VMCALL code to measure the PE */
-#define VMCALL_MEASURE 0x300F
-
-#define DATA_EPT 0x1
-#define CODE_EPT 0x2
-
-/**
-    Defines a structure to store the data and code page translations
-*/
-struct TlbTranslation_s
-{
-    uint32 VirtualAddress;
-    uint32 DataPhys;
-    uint32 CodePhys;
-    uint8 CodeOrData;
-    uint8 RW;
-    EptPteEntry *EptPte;
-};
-
-typedef struct TlbTranslation_s TlbTranslation;
-
-extern PVOID PsGetProcessSectionBaseAddress(PEPROCESS);
-extern char * PsGetProcessImageFileName(PEPROCESS);
-
-extern PHYSICAL_ADDRESS targetPePhys;
-extern void *targetPeVirt;
-extern uint8 *targetPePtr;
-extern PEPROCESS targetProc;
-extern KAPC_STATE apcstate;
-
-extern uint32 targetCR3;
-
-extern uint8 *appCopy;
-extern uint32 appsize;
-
-extern PageTableEntry **targetPtes;
-
-extern PHYSICAL_ADDRESS *targetPhys;
-
-/** Repeatedly calls measure */
-static KSTART_ROUTINE periodicMeasurePe;
-
-/**
-    @brief Callback for when a new process is created
-    
-    Detects if the new process is a target for TLB splitting
-    @param ParentID ID of parent process
-    @param ProcessId ID of newly created process
-    @param Create True if the process is being created, false if it's being destroyed
-*/
-void processCreationMonitor(HANDLE ParentId, HANDLE ProcessId, BOOLEAN Create);
-
-/**
-    Function to make a copy of a PE image
-    
-    @param proc PEPROCESS of the target PE
-    @param apc Pointer to an APC state structure
-    @param srcPtr Source VA
-    @param targetPtr Memory buffer to copy to
-    @param len Number of bytes to copy
-*/
-void copyPe(PEPROCESS proc, PKAPC_STATE apc, uint8 *srcPtr, uint8 *targetPtr, uint32 len);
-
-/**
-    Allocates and fills in an array (null terminated) of VA -> Physical mappings and PTEs
-    
-    @param srcPtr Pointer to image base
-    @param targetPtr Pointer to copy
-    @param len Number of bytes to copy
-    @param cr3Reg CR3 register of target application
-    @return Pointer to TlbTranslation array
-*/
-TlbTranslation * allocateAndFillTranslationArray(uint8 *codePtr,
-                                                 uint8 *dataPtr, 
-                                                 uint32 len, 
-                                                 PEPROCESS proc,
-                                                 PKAPC_STATE apc);
-
-/**
-    Frees and safely de-allocates a TLB translation array allocated with
-    allocateAndFillTranslationArry
-
-    @param arr Pointer to TlbTranslation array
-*/
-void freeTranslationArray(TlbTranslation *arr);
-
-/**
-    Returns the relevant TlbTranslation for the passed guest physial address
-    
-    @param transArr Pointer to array of all known translations
-    @param guestPhysical Physical address
-    
-    @return Pointer to TlbTranslation pointing to the guest physical
-*/
-TlbTranslation * getTlbTranslation(TlbTranslation * transArr, uint32 guestPhysical);
-
-#if 0
-/** 
-    Function to 'lock' a process' memory into physical memory and prevent paging
-    
-    @param startAddr Starting virtual address to lock
-    @param len Number of bytes to lock
-    @param proc PEPROCESS pointer to the process
-    @param apcstate Pointer to an APC state memory location
-    @return MDL to be used later to unlock the memory or NULL if lock failed
-*/
-PMDLX pagingLockProcessMemory(PVOID startAddr, uint32 len, PEPROCESS proc, PKAPC_STATE apcstate);
-
-/** 
-    Function to 'lock' a process' memory into physical memory and prevent paging
-    
-    @param proc PEPROCESS pointer to the process
-    @param apcstate Pointer to an APC state memory location
-    @param mdl Pointer to previously locked process MDL
-*/
-void pagingUnlockProcessMemory(PEPROCESS proc, PKAPC_STATE apcstate, PMDLX mdl);
-#endif
-
-/**
-    Tests the TLB splitting for a single page instance
-    This function emulates the functionality of MoRE drop 1
-*/
-void splitPage();
-
-/**
-    Measures the PE and displays the checksum
-    
-    @param phys Physical address of the image header
-    @param PeHeaderVirt Process's virtual address
-*/
-void measurePe(PHYSICAL_ADDRESS phys, void * peHeaderVirt);
-
-void AppendTlbTranslation(TlbTranslation * transArr, uint32 phys, uint8 * virt);
-
-uint32 checksumBuffer(uint8 * ptr, uint32 len);
-
-#endif
+/**
+	@file
+	Header which defines structures for monitoring processes
+		
+	@date 1/24/2012
+***************************************************************/
+
+#ifndef _MORE_PROCMON_H_
+#define _MORE_PROCMON_H_
+
+#include "..\stdint.h"
+#include "..\paging.h"
+#include "..\pe.h"
+#include "..\dedup.h"
+#include "..\warm.h"
+#include "structs.h"
+
+/** Boolean to monitor processes or not */
+#define MONITOR_PROCS 1
+/** Boolean for whether or not to periodically measure the binary on preemption timer exits */
+#define PERIODIC_MEASURE 1
+/** Boolean for whether to arm only the executable sections and make each page's copy
+    on its first execute or read, instead of copying the whole image up front. Each
+    copy is a single page of the paging pool taken from a frame splitLockPages 
+    faulted in, so no contiguous allocation or copy of the other sections is made */
+#define LAZY_SPLIT 1
+/** VMCALL code to initialize the TLB split */
+#define VMCALL_INIT_SPLIT 0x100F
+/** VMCALL code to end the TLB split */
+#define VMCALL_END_SPLIT 0x200F
+/** VMCALL code to measure the PE */
+#define VMCALL_MEASURE 0x300F
+
+/** Shortest delay between measurement slices (100ns units) */
+#define MEASURE_MIN_DELAY 100000
+/** Longest delay between measurement slices (100ns units) */
+#define MEASURE_MAX_DELAY 10000000
+/** Length of a measurement statistics interval (100ns units) */
+#define MEASURE_REPORT_INTERVAL 10000000
+/** Number of completed measurement intervals kept for reporting */
+#define MEASURE_HISTORY 16
+
+/** Frames at or above this (4 GiB) are left unsplit, translations are 32-bit */
+#define SPLIT_PFN_LIMIT 0x100000
+/** Most pages of a target whose frames one switch to its CR3 re-reads */
+#define SPLIT_REWALK_PAGES 64
+/** Most processes split at the same time */
+#define SPLIT_MAX_TARGETS 16
+/** Log2 of the number of buckets of the CR3 hash table of split targets */
+#define SPLIT_TARGET_HASH_BITS 6
+/** Number of buckets of the CR3 hash table of split targets */
+#define SPLIT_TARGET_BUCKETS (1 << SPLIT_TARGET_HASH_BITS)
+
+/** The parsed headers were taken from the warm cache */
+#define SPLIT_WARM_HEADERS 0x1
+/** The reference checksums were taken from the warm cache */
+#define SPLIT_WARM_REFERENCE 0x2
+/** The checksum of an earlier launch on the same frames verified the image,
+    only taken with POLICY_OPT_TRUST_WARM */
+#define SPLIT_WARM_VERIFIED 0x4
+
+/** Reverse map entries a target gets per page of its image */
+#define SPLIT_ALIAS_ENTRIES_PER_PAGE 4
+/** Reverse map entries every target gets on top, for the rest of its user mappings */
+#define SPLIT_ALIAS_ENTRIES_EXTRA 4096
+/** WritableAliases value of a target whose aliases could not all be found */
+#define SPLIT_ALIASES_UNKNOWN 0xFFFFFFFF
+
+/** Stages of setting up the split of a new target, each one's latency is reported */
+enum SPLIT_STAGE_E
+{
+    SPLIT_STAGE_CALLBACK = 0, /**< Recording the target in the creation callback */
+    SPLIT_STAGE_QUEUE, /**< Waiting for a worker thread */
+    SPLIT_STAGE_LOCK, /**< Reading CR3 and mapping the header */
+    SPLIT_STAGE_PARSE, /**< Parsing the image headers and locking the executable sections */
+    SPLIT_STAGE_COPY, /**< Allocating and filling the copy */
+    SPLIT_STAGE_TRANSLATE, /**< Building the translation array */
+    SPLIT_STAGE_MEASURE, /**< Preparing the periodic measurement */
+    SPLIT_STAGE_ACTIVATE, /**< Starting the split in the hypervisor */
+    SPLIT_STAGE_CHECKSUM, /**< Initial checksum of the executable sections */
+    SPLIT_NUM_STAGES
+};
+
+typedef enum SPLIT_STAGE_E SPLIT_STAGE;
+
+#define DATA_EPT 0x1
+#define CODE_EPT 0x2
+
+/** Index returned when no translation matches */
+#define TLB_NONE 0xFFFFFFFF
+/** Most pages in an image with translations, the page column is 16-bit */
+#define TLB_MAX_PAGES 0x10000
+/** Bytes the columns of TlbTranslations take per translation */
+#define TLB_BYTES_PER_PAGE (sizeof(EptPteEntry *) + 2 * sizeof(uint32) + sizeof(uint16) + sizeof(uint8))
+/** Bits of a translation reference holding the index + 1, the slot of the target is above */
+#define TLB_REF_INDEX_BITS 20
+
+/**
+    Defines a structure to store the data and code page translations of a 
+    target, one column per field so a search only reads the column it compares
+    
+    @note All columns are in one allocation starting at EptPte. Translations 
+    are sorted by Page, the virtual address of translation i is the image 
+    base + Page[i] * PAGE_SIZE.
+*/
+struct TlbTranslations_s
+{
+    uint32 Count; /**< Number of translations */
+    EptPteEntry **EptPte; /**< EPT PTE armed for each translation, NULL if none */
+    uint32 *CodePfn; /**< Frame of the original page, 0 if not present or not splittable */
+    uint32 *DataPfn; /**< Frame of the copy, 0 until it is made with LAZY_SPLIT */
+    uint16 *Page; /**< Page number within the image */
+    uint8 *Flags; /**< CODE_EPT or DATA_EPT, which frame the EPT PTE maps */
+};
+
+typedef struct TlbTranslations_s TlbTranslations;
+
+/**
+    Everything kept for one split process, found by its CR3 in VMX root
+*/
+struct SplitTarget_s
+{
+    struct SplitTarget_s *Next; /**< Next target in the same hash bucket */
+    uint32 CR3; /**< CR3 of the process, the key of the hash table */
+    PEPROCESS Proc;
+    HANDLE ProcessId;
+    KAPC_STATE ApcState; /**< APC state used while attached to the process */
+    void *PeVirt; /**< Virtual address the image is loaded at */
+    PHYSICAL_ADDRESS PePhys; /**< Physical address of the image header */
+    uint8 *PePtr; /**< Mapping of the image header */
+    uint32 Size; /**< Number of bytes in the image */
+    PeImageInfo ImageInfo; /**< Parsed descriptor of the image */
+    TlbTranslations Translations; /**< Armed pages, EptPte is NULL until they are built */
+    uint32 *Pfns; /**< Frame of each page, refreshed SPLIT_REWALK_PAGES at a time on switches to CR3 */
+    uint32 RewalkCursor; /**< First page the next switch to CR3 re-reads */
+    uint32 *SeenPfns; /**< Frame of each page as of the last switch that handled it */
+    PHYSICAL_ADDRESS *Phys; /**< Physical address of each page when the split was set up */
+    DedupEntry **Copies; /**< Shared copy each translation uses with LAZY_SPLIT */
+    uint8 *Copy; /**< Contiguous copy of the whole image, only made without LAZY_SPLIT */
+    PMDLX LockedMdls[PE_MAX_EXEC_SECTIONS]; /**< MDL locking each executable section into memory */
+    PMDLX RelocMdl; /**< MDL locking .reloc while the headers are parsed */
+    FAST_MUTEX LockMutex; /**< Serializes locking pages with the exit unlocking them */
+    PMDLX *RelockMdls; /**< MDL locking the frame each translation was last re-armed with, or NULL */
+    uint8 *Relock; /**< Set in VMX root for each translation re-armed with a frame no MDL holds */
+    volatile LONG RelockPending; /**< Set in VMX root when a translation was flagged in Relock */
+    volatile LONG RelockQueued; /**< Set while RelockWork is queued or running */
+    WORK_QUEUE_ITEM RelockWork; /**< Work item which locks the frames flagged in Relock */
+    KEVENT RelockIdle; /**< Signaled while RelockWork is not queued or running */
+    MeasureJob ExecJob; /**< Measurement job covering the executable pages */
+    PeMeasureContext ExecContext;
+    MeasureScheduler Sched; /**< Scheduler measuring ExecJob in slices */
+    uint32 *SchedStorage;
+    uint64 IntervalStart; /**< TSC value the current measurement interval started at */
+    MeasureStats History[MEASURE_HISTORY]; /**< Statistics of the last intervals */
+    uint32 HistoryCount; /**< Number of intervals completed, History is indexed modulo its size */
+    uint32 AppendFailures; /**< New translations which could not be added for lack of pages */
+    uint32 LazySplits; /**< Pages split on first use */
+    uint32 LazyFailures; /**< Pages left unsplit for lack of a page */
+    uint32 SharedCopies; /**< Pages split with the copy another instance made */
+    uint32 Options; /**< POLICY_OPT_* of the policy the image matched */
+    uint32 Digest; /**< Checksum of the executable sections the policy expects */
+    WarmKey Warm; /**< Identity of the image in the warm cache */
+    WarmEntry WarmCached; /**< The image's warm cache entry when the setup started, zero if there was none */
+    uint32 *WarmReference; /**< Copy of the cached reference checksums, until the measurement is prepared */
+    uint32 WarmReferencePages; /**< Number of checksums in WarmReference */
+    uint32 WarmReused; /**< SPLIT_WARM_* of what the setup took from the warm cache */
+    uint32 FrameDigest; /**< Digest of the frames of the executable pages, 0 if one was not present */
+    uint32 WritableAliases; /**< Writable user mappings of executable frames outside the image */
+    uint8 Active; /**< The split was started, the target is in the hash table */
+    volatile uint8 SetupCancel; /**< Set when the process exits, the setup stops at its next stage */
+    WORK_QUEUE_ITEM SetupWork; /**< Work item which sets up the split */
+    KEVENT SetupIdle; /**< Signaled while no setup is queued or running */
+    volatile LONG SetupRefs; /**< Held by the setup, the running process and a queued relock, the last to drop it tears down */
+    LARGE_INTEGER SetupQueuedAt; /**< Performance counter value the setup was queued at */
+    uint32 SetupMicros[SPLIT_NUM_STAGES]; /**< Latency of each setup stage (microseconds) */
+};
+
+typedef struct SplitTarget_s SplitTarget;
+
+extern PVOID PsGetProcessSectionBaseAddress(PEPROCESS);
+extern char * PsGetProcessImageFileName(PEPROCESS);
+extern NTSTATUS PsSuspendProcess(PEPROCESS);
+extern NTSTATUS PsResumeProcess(PEPROCESS);
+
+extern uint32 MeasureBudgetPercent;
+extern uint32 SplitActiveTargets;
+
+/**
+    Loads the policy table naming the images to split, before the creation 
+    callback is registered
+    
+    @note Must be called at IRQL = 0. The blob is read from the REG_BINARY 
+    value Policy of the driver's service key, without one only TargetAppName 
+    is split.
+    @param registryPath Service key of the driver, as passed to DriverEntry
+*/
+void loadSplitPolicy(PUNICODE_STRING registryPath);
+
+/**
+    Frees the policy table, once the creation callback was removed
+*/
+void freeSplitPolicy();
+
+/**
+    Frees the setup results kept across launches, once no setup is running
+*/
+void freeSplitWarmCache();
+
+/**
+    Prepares the workers which set up the splits, before the creation callback 
+    is registered
+*/
+void initSplitSetup();
+
+/**
+    Stops and waits for every split setup which is still queued or running
+    
+    @note Must be called at IRQL = 0
+*/
+void waitForSplitSetup();
+
+/**
+    Queues the locking of the frames re-armed in VMX root, which cannot lock 
+    them itself
+    
+    @note Must be called from the guest at IRQL <= DISPATCH_LEVEL
+*/
+void splitServiceRelocks();
+
+/**
+    Adds a target to the CR3 hash table
+    
+    @note Runs in VMX root, when the split of the target starts
+    @param target Pointer to the target, its CR3 must be set
+*/
+void splitTargetInsert(SplitTarget *target);
+
+/**
+    Removes a target from the CR3 hash table
+    
+    @note Runs in VMX root, when the split of the target ends
+    @param target Pointer to the target
+*/
+void splitTargetRemove(SplitTarget *target);
+
+/**
+    Returns the split target running in an address space
+    
+    @note Runs in VMX root at any guest IRQL, the cost does not depend on the
+    number of targets
+    @param cr3 CR3 value of the address space
+    @return Pointer to the target, or NULL if the address space is not split
+*/
+SplitTarget * splitTargetLookup(uint32 cr3);
+
+/**
+    Iterates over the targets in the CR3 hash table
+    
+    @param prev Target returned by the last call, or NULL to start
+    @return Next target, or NULL once all were returned
+*/
+SplitTarget * splitNextTarget(SplitTarget *prev);
+
+/**
+    Finds the translation of a guest physical address among all split targets
+    
+    @note The target running in cr3 is searched first, so a frame shared by
+    several instances of an image resolves to the instance which touched it
+    @param cr3 CR3 value of the address space the access was made in
+    @param guestPhysical Physical address
+    @param target Receives the target the translation belongs to
+    @return Index of the translation in the target's Translations, or 
+    TLB_NONE if no target has one
+*/
+uint32 splitFindTranslation(uint32 cr3, uint32 guestPhysical, SplitTarget **target);
+
+/**
+    Returns the reference to a translation kept on the EPT PTE stack
+    
+    @param target Target the translation belongs to, one of the split slots
+    @param index Index of the translation
+    @return Non-NULL reference, resolved with splitRefTarget
+*/
+void * splitTranslationRef(SplitTarget *target, uint32 index);
+
+/**
+    Resolves a reference made by splitTranslationRef
+    
+    @param ref Reference to the translation
+    @param index Receives the index of the translation
+    @return Pointer to the target, or NULL unless ref is a translation of a
+    target which is still split
+*/
+SplitTarget * splitRefTarget(void *ref, uint32 *index);
+
+/**
+    Returns the virtual address of the page of a translation
+    
+    @param target Target the translation belongs to
+    @param index Index of the translation
+    @return Virtual address of the page
+*/
+uint32 splitTranslationVa(SplitTarget *target, uint32 index);
+
+/**
+    @brief Callback for when a new process is created
+    
+    Detects if the new process is a target for TLB splitting by looking its
+    image name up in the policy table, the split itself is set up 
+    asynchronously by a worker so process creation is not held up
+    @param ParentID ID of parent process
+    @param ProcessId ID of newly created process
+    @param Create True if the process is being created, false if it's being destroyed
+*/
+void processCreationMonitor(HANDLE ParentId, HANDLE ProcessId, BOOLEAN Create);
+
+/**
+    Function to make a copy of a PE image
+    
+    @param proc PEPROCESS of the target PE
+    @param apc Pointer to an APC state structure
+    @param srcPtr Source VA
+    @param targetPtr Memory buffer to copy to
+    @param len Number of bytes to copy
+*/
+void copyPe(PEPROCESS proc, PKAPC_STATE apc, uint8 *srcPtr, uint8 *targetPtr, uint32 len);
+
+/**
+    Allocates and fills in the target's Translations, the page -> frame 
+    mappings and PTEs
+    
+    @note With LAZY_SPLIT only the pages of the executable sections of the 
+    target's image get a translation, their DataPfn is left 0 until 
+    splitLazyPage makes the copy. The target's Pfns, SeenPfns and Phys are 
+    filled in too.
+    @param target Pointer to the target, its CR3 and ImageInfo must be set
+    @param codePtr Pointer to image base
+    @param dataPtr Pointer to the copy made by copyPe, NULL with LAZY_SPLIT
+    @param len Number of bytes in the image
+    @return 1 on success, 0 if the image has more than TLB_MAX_PAGES pages or
+    the arrays could not be allocated
+*/
+uint8 allocateAndFillTranslationArray(SplitTarget *target,
+                                                 uint8 *codePtr,
+                                                 uint8 *dataPtr, 
+                                                 uint32 len);
+
+/**
+    Frees and safely de-allocates the TLB translation array of a target 
+    allocated with allocateAndFillTranslationArray
+
+    @param target Pointer to the target
+*/
+void freeTranslationArray(SplitTarget *target);
+
+/**
+    Makes the copy of an armed page on its first execute or read, when 
+    splitting lazily
+    
+    @note Runs in VMX root, the copy is taken from memContext's pool
+    @param target Target the translation belongs to
+    @param index Index of the translation of the page, its DataPfn is still 0
+    @return 1 if the copy was made, 0 if there was no page for it
+*/
+uint8 splitLazyPage(SplitTarget *target, uint32 index);
+
+/**
+    Drops the target's references to the copies splitLazyPage found or made, 
+    freeing the copies nothing else uses
+    
+    @note Runs in VMX root once the target's translations are no longer armed
+    @param target Pointer to the target
+*/
+void splitReleaseCopies(SplitTarget *target);
+
+/**
+    Returns the relevant translation for the passed guest physial address
+    
+    @param tlb Pointer to the translations of a target
+    @param guestPhysical Physical address
+    
+    @return Index of the translation whose armed frame holds guestPhysical, 
+    or TLB_NONE
+*/
+uint32 getTlbTranslation(TlbTranslations *tlb, uint32 guestPhysical);
+
+#if 0
+/** 
+    Function to 'lock' a process' memory into physical memory and prevent paging
+    
+    @param startAddr Starting virtual address to lock
+    @param len Number of bytes to lock
+    @param proc PEPROCESS pointer to the process
+    @param apcstate Pointer to an APC state memory location
+    @return MDL to be used later to unlock the memory or NULL if lock failed
+*/
+PMDLX pagingLockProcessMemory(PVOID startAddr, uint32 len, PEPROCESS proc, PKAPC_STATE apcstate);
+
+/** 
+    Function to 'lock' a process' memory into physical memory and prevent paging
+    
+    @param proc PEPROCESS pointer to the process
+    @param apcstate Pointer to an APC state memory location
+    @param mdl Pointer to previously locked process MDL
+*/
+void pagingUnlockProcessMemory(PEPROCESS proc, PKAPC_STATE apcstate, PMDLX mdl);
+#endif
+
+/**
+    Tests the TLB splitting for a single page instance
+    This function emulates the functionality of MoRE drop 1
+*/
+void splitPage();
+
+/**
+    Measures the PE of a target and displays the checksum
+    
+    @param target Pointer to the target
+*/
+void measurePe(SplitTarget *target);
+
+/**
+    Arms the preemption timer for the first measurement slice of a target
+    
+    @note Runs in VMX root, does nothing if the target is not being measured
+    @param target Pointer to the target
+*/
+void startPeriodicMeasure(SplitTarget *target);
+
+/**
+    Disarms the preemption timer used for periodic measurement
+    
+    @note Runs in VMX root
+*/
+void stopPeriodicMeasure();
+
+/**
+    Handles a preemption timer exit by measuring the next slice of the next
+    measured target, in turn, and re-arming the timer to stay within the 
+    measurement budget
+    
+    @param GuestSTATE State of the guest
+*/
+void exit_reason_dispatch_handler__exec_preempt(struct GUEST_STATE * GuestSTATE);
+
+/**
+    Points the translation of virt at a new data frame, e.g. after copy-on-write
+    
+    @note Runs in VMX root at any guest IRQL, nothing is changed if no page is
+    available to split a large EPT page
+    @param target Target the page belongs to
+    @param phys New physical address of the page
+    @param virt Virtual address of the page
+    @return 1 on success, 0 if the translation must be retried later
+*/
+uint8 AppendTlbTranslation(SplitTarget *target, uint32 phys, uint8 * virt);
+
+uint32 checksumBuffer(uint8 * ptr, uint32 len);
+
+#endif
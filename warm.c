@@ -0,0 +1,102 @@
+/**
+	@file
+	Cache of split setup results across launches of an image
+    
+    Builds in the driver or, with MORE_PTHREADS defined, as a user-space
+    library: gcc -DMORE_PTHREADS -c warm.c
+    
+	@date 10/19/2026
+***************************************************************/
+#ifdef MORE_PTHREADS
+#include <string.h>
+#else
+#include "ntddk.h"
+#endif
+#include "stdint.h"
+#include "warm.h"
+
+/**
+    Returns non-zero if two keys name the same image
+*/
+static uint8 warmSameKey(const WarmKey *a, const WarmKey *b)
+{
+    return a->NameHash == b->NameHash && a->TimeDateStamp == b->TimeDateStamp &&
+           a->HeaderDigest == b->HeaderDigest && a->ImageBase == b->ImageBase &&
+           a->SizeOfImage == b->SizeOfImage;
+}
+
+void warmInit(WarmCache *cache, WarmEntry *entries, uint32 maxEntries)
+{
+    memset(cache, 0, sizeof(WarmCache));
+    memset(entries, 0, maxEntries * sizeof(WarmEntry));
+    cache->Entries = entries;
+    cache->MaxEntries = maxEntries;
+}
+
+uint32 warmDigestAdd(uint32 digest, uint32 value)
+{
+    // FNV-1a, a byte at a time
+    digest = (digest ^ (value & 0xFF)) * 16777619u;
+    digest = (digest ^ ((value >> 8) & 0xFF)) * 16777619u;
+    digest = (digest ^ ((value >> 16) & 0xFF)) * 16777619u;
+    return (digest ^ (value >> 24)) * 16777619u;
+}
+
+uint32 warmDigestBuffer(const uint8 *buffer, uint32 len)
+{
+    const uint32 *words = (const uint32 *) buffer;
+    uint32 i, digest = WARM_DIGEST_INIT;
+    
+    for (i = 0; i < len / sizeof(uint32); i++)
+    {
+        digest = warmDigestAdd(digest, words[i]);
+    }
+    return digest;
+}
+
+WarmEntry * warmLookup(WarmCache *cache, const WarmKey *key)
+{
+    uint32 i;
+    
+    // A handful of images, a scan is as quick as anything
+    for (i = 0; i < cache->MaxEntries; i++)
+    {
+        if (cache->Entries[i].Used && warmSameKey(&cache->Entries[i].Key, key))
+        {
+            cache->Entries[i].LastUse = ++cache->Clock;
+            cache->Hits++;
+            return &cache->Entries[i];
+        }
+    }
+    cache->Misses++;
+    return NULL;
+}
+
+WarmEntry * warmStore(WarmCache *cache, const WarmKey *key)
+{
+    WarmEntry *entry = NULL;
+    uint32 i;
+    
+    for (i = 0; i < cache->MaxEntries; i++)
+    {
+        if (cache->Entries[i].Used && warmSameKey(&cache->Entries[i].Key, key))
+        {
+            cache->Entries[i].LastUse = ++cache->Clock;
+            return &cache->Entries[i];
+        }
+        // Prefer a free entry, then the least recently used one
+        if (entry == NULL || (entry->Used &&
+                (!cache->Entries[i].Used || cache->Entries[i].LastUse < entry->LastUse)))
+            entry = &cache->Entries[i];
+    }
+    if (entry == NULL)
+        return NULL;
+    
+    if (entry->Used)
+        cache->Evictions++;
+    memset(entry, 0, sizeof(WarmEntry));
+    entry->Key = *key;
+    entry->Used = 1;
+    entry->LastUse = ++cache->Clock;
+    return entry;
+}
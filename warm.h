@@ -0,0 +1,116 @@
+/**
+	@file
+	Cache of split setup results across launches of an image (header file)
+    
+    Remembers what the setup of an image found out, keyed by the identity of
+    the image, so a relaunch of the same image can skip the work whose
+    result cannot have changed
+    
+	@date 10/19/2026
+***************************************************************/
+
+#ifndef _MORE_WARM_H_
+#define _MORE_WARM_H_
+
+#include "stdint.h"
+
+/** Initial value of a digest built with warmDigestAdd */
+#define WARM_DIGEST_INIT 2166136261u
+
+/** Digest holds the checksum the policy's digest was verified against */
+#define WARM_FLAG_VERIFIED 0x1
+/** The reference checksums of the measurement were captured */
+#define WARM_FLAG_REFERENCE 0x2
+
+/**
+    Identity of a loaded image
+*/
+struct WarmKey_s
+{
+    uint32 NameHash; /**< Hash of the image name */
+    uint32 TimeDateStamp; /**< Link time stamp of the file header */
+    uint32 HeaderDigest; /**< Digest of the loaded header page */
+    uint32 ImageBase; /**< Virtual address the image is loaded at */
+    uint32 SizeOfImage; /**< Number of bytes in the loaded image */
+};
+
+typedef struct WarmKey_s WarmKey;
+
+/**
+    What is known about one image
+*/
+struct WarmEntry_s
+{
+    WarmKey Key;
+    uint32 FrameDigest; /**< Digest of the frames of the executable pages the results were taken from */
+    uint32 Digest; /**< Verified checksum of the executable sections, with WARM_FLAG_VERIFIED */
+    uint32 Flags; /**< WARM_FLAG_* */
+    uint32 LastUse; /**< Value of the cache's clock when last looked up or stored */
+    uint8 Used; /**< The entry holds an image */
+};
+
+typedef struct WarmEntry_s WarmEntry;
+
+/**
+    Cache of images, the least recently used one makes room for a new one
+*/
+struct WarmCache_s
+{
+    WarmEntry *Entries; /**< Caller supplied storage */
+    uint32 MaxEntries;
+    uint32 Clock; /**< Counts lookups and stores */
+    uint32 Hits; /**< Lookups which found their image */
+    uint32 Misses;
+    uint32 Evictions; /**< Images dropped to make room */
+};
+
+typedef struct WarmCache_s WarmCache;
+
+/**
+    Initializes an empty cache
+    
+    @param cache Pointer to the cache
+    @param entries Array of maxEntries entries
+    @param maxEntries Number of entries
+*/
+void warmInit(WarmCache *cache, WarmEntry *entries, uint32 maxEntries);
+
+/**
+    Adds a value to a digest
+    
+    @param digest Digest so far, WARM_DIGEST_INIT for the first value
+    @param value Value to add
+    @return New digest
+*/
+uint32 warmDigestAdd(uint32 digest, uint32 value);
+
+/**
+    Returns the digest of a buffer
+    
+    @param buffer Pointer to the buffer, 4-byte aligned
+    @param len Number of bytes, a multiple of 4
+    @return Digest of the buffer
+*/
+uint32 warmDigestBuffer(const uint8 *buffer, uint32 len);
+
+/**
+    Finds the entry of an image
+    
+    @param cache Pointer to the cache
+    @param key Identity of the image
+    @return Pointer to the entry, or NULL if the image is not cached
+*/
+WarmEntry * warmLookup(WarmCache *cache, const WarmKey *key);
+
+/**
+    Returns the entry to store the results of an image in
+    
+    @note An image which was not cached gets a cleared entry, replacing the
+    least recently used image if the cache is full
+    @param cache Pointer to the cache
+    @param key Identity of the image
+    @return Pointer to the entry, or NULL if the cache has no entries
+*/
+WarmEntry * warmStore(WarmCache *cache, const WarmKey *key);
+
+#endif // _MORE_WARM_H_